@@ -10,218 +10,211 @@
 #include <string.h>
 #include <math.h>
 
+#include "bench.h"
+#include "capture.h"
+#include "culling.h"
+#include "frame_ubo.h"
+#include "gl_extensions.h"
+#include "instancing.h"
+#include "math3d.h"
+#include "mesh_stream.h"
+#include "meshlet.h"
+#include "model.h"
+#include "offscreen.h"
+#include "parallel.h"
+#include "platform.h"
+#include "profiler.h"
+#include "shader.h"
+#include "timestep.h"
+#include "transform.h"
+
+// Largest on-screen error, in pixels, a simplified level may show
+#define LOD_ERROR_PIXELS 1.0f
+
+// The scene is simulated at a fixed rate whatever the frame rate
+#define SIMULATION_STEP (1.0 / 60.0)
+#define CAMERA_RADIANS_PER_SECOND 0.03f
+
 //-------------------------------------------------------------//
-//                      Shader check helper                     //
+//                      Window and context                      //
 //-------------------------------------------------------------//
-void check_compile_errors(unsigned int shader, const char* type) {
-    int success;
-    char infoLog[1024];
-    if (strcmp(type, "PROGRAM") != 0) {
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-            printf("ERROR::SHADER_COMPILATION_ERROR of type: %s\n%s\n", type, infoLog);
+static void set_context_hints(void) {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+}
+
+// Headless runs first try GLFW's null platform, which needs no display
+// server: an EGL context (surfaceless under Mesa, so llvmpipe works on
+// a GPU-less machine), else OSMesa. Failing both, a hidden window on the
+// native platform. Returns NULL if nothing worked.
+static GLFWwindow* create_headless_window(int width, int height) {
+    static const int apis[2] = { GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API };
+    static const char* const api_names[2] = { "EGL", "OSMesa" };
+
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (glfwInit()) {
+        for (int i = 0; i < 2; i++) {
+            glfwDefaultWindowHints();
+            set_context_hints();
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, apis[i]);
+            GLFWwindow* window = glfwCreateWindow(width, height, "headless", NULL, NULL);
+            if (window) {
+                printf("Headless: %s context without a display server\n", api_names[i]);
+                return window;
+            }
         }
+        glfwTerminate();
     }
-    else {
-        glGetProgramiv(shader, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-            printf("ERROR::PROGRAM_LINKING_ERROR of type: %s\n%s\n", type, infoLog);
-        }
+
+    glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+    if (!glfwInit()) {
+        printf("Failed to initialize GLFW\n");
+        return NULL;
     }
+    glfwDefaultWindowHints();
+    set_context_hints();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE); // only the context is used
+    GLFWwindow* window = glfwCreateWindow(width, height, "headless", NULL, NULL);
+    if (window) printf("Headless: no context without a display server, using a hidden window\n");
+    return window;
 }
 
 //-------------------------------------------------------------//
-//                         Math structs                         //
-//-------------------------------------------------------------//
-typedef struct { float x, y, z; } Vec3;
-
-typedef struct {
-    unsigned int v_idx[3]; // vertex indices per face tri
-    unsigned int n_idx[3]; // normal indices per face tri
-} Face;
-
-//-------------------------------------------------------------//
-//                    Globals for OBJ data                      //
-//-------------------------------------------------------------//
-#define MAX_VERTICES 100000
-#define MAX_NORMALS  100000
-#define MAX_FACES    100000
-
-Vec3 vertices[MAX_VERTICES];
-Vec3 normals[MAX_NORMALS];
-Face faces[MAX_FACES];
-
-int vertex_count = 0;
-int normal_count = 0;
-int face_count = 0;
-
-//-------------------------------------------------------------//
-//                      OBJ loader function                     //
+//                        Main program                         //
 //-------------------------------------------------------------//
-int load_obj(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        printf("FATAL ERROR: Cannot open OBJ file: %s\n", filename);
-        return 0;
-    }
+int main(int argc, char** argv) {
+    double program_start = platform_time_seconds(); // time to first frame and to model visible count from here
 
-    char line[128];
-    while (fgets(line, sizeof(line), file)) {
-        if (strncmp(line, "v ", 2) == 0) {
-            sscanf_s(line + 2, "%f %f %f", &vertices[vertex_count].x, &vertices[vertex_count].y, &vertices[vertex_count].z);
-            vertex_count++;
+    //-------------------------------------------------------------//
+    //                    Command line options                     //
+    //-------------------------------------------------------------//
+    // Usage: OpenGL_C [model.obj] [--optimize] [--quantize] [--no-cache]
+    //                 [--gpu-normal-matrix] [--math-scalar] [--bench-math]
+    //                 [--bench-transforms] [--instances N] [--draw-per-object]
+    //                 [--no-cull] [--bench-bvh] [--bench-obj] [--meshlets] [--lod]
+    //                 [--stream] [--stream-budget MB] [--no-buffer-storage]
+    //                 [--headless] [--frames N] [--output frame.ppm] [--size WxH]
+    //                 [--capture prefix] [--profile-csv frames.csv]
+    //                 [--no-vsync] [--fixed-time] [--no-shader-cache]
+
+    const char* obj_path = "cube.obj"; // Make sure cube.obj is in your executable folder
+    unsigned int model_options = 0;
+    int gpu_normal_matrix = 0; // old path: inverse() per vertex in the shader
+    int run_bench_math = 0;
+    int run_bench_transforms = 0;
+    int run_bench_bvh = 0;
+    int run_bench_obj = 0;
+    int instance_count = 1;
+    int draw_per_object = 0; // one glDrawElements per copy instead of one instanced draw
+    int cull = 1;            // frustum culling of the copies
+    int use_meshlets = 0;    // cluster culling inside each copy, one multi-draw per copy
+    int use_stream = 0;      // page chunks of the mesh in and out around the camera
+    unsigned long long stream_budget_mb = 256;
+    int buffer_storage = 1;  // persistently mapped rings when the driver has it
+    int headless = 0;        // hidden window, offscreen framebuffer, no presentation
+    unsigned long long frame_limit = 0; // 0 runs until the window is closed
+    const char* output_path = NULL;     // PPM of the last frame
+    const char* capture_prefix = NULL;  // every frame, read back asynchronously
+    const char* profile_csv = NULL;     // one row of scope timings per frame
+    int vsync = 1;           // --no-vsync renders uncapped for throughput runs
+    int fixed_time = 0;      // one simulation step per frame instead of the clock
+    int shader_cache = 1;    // linked program binaries on disk when the driver can export them
+    int width = 800;
+    int height = 600;
+
+    math_init(); // SIMD matrix code when the CPU has it
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--optimize") == 0) model_options |= MODEL_OPTIMIZE;
+        else if (strcmp(argv[i], "--no-cache") == 0) model_options |= MODEL_NO_CACHE;
+        else if (strcmp(argv[i], "--quantize") == 0) model_options |= MODEL_QUANTIZE;
+        else if (strcmp(argv[i], "--lod") == 0) model_options |= MODEL_LOD;
+        else if (strcmp(argv[i], "--gpu-normal-matrix") == 0) gpu_normal_matrix = 1;
+        else if (strcmp(argv[i], "--math-scalar") == 0) math_set_backend(MATH_BACKEND_SCALAR);
+        else if (strcmp(argv[i], "--bench-math") == 0) run_bench_math = 1;
+        else if (strcmp(argv[i], "--bench-transforms") == 0) run_bench_transforms = 1;
+        else if (strcmp(argv[i], "--bench-bvh") == 0) run_bench_bvh = 1;
+        else if (strcmp(argv[i], "--bench-obj") == 0) run_bench_obj = 1;
+        else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instance_count = (int)strtol(argv[++i], NULL, 10);
+            if (instance_count < 1) instance_count = 1;
         }
-        else if (strncmp(line, "vn ", 3) == 0) {
-            sscanf_s(line + 3, "%f %f %f", &normals[normal_count].x, &normals[normal_count].y, &normals[normal_count].z);
-            normal_count++;
+        else if (strcmp(argv[i], "--draw-per-object") == 0) draw_per_object = 1;
+        else if (strcmp(argv[i], "--no-cull") == 0) cull = 0;
+        else if (strcmp(argv[i], "--meshlets") == 0) use_meshlets = 1;
+        else if (strcmp(argv[i], "--stream") == 0) use_stream = 1;
+        else if (strcmp(argv[i], "--stream-budget") == 0 && i + 1 < argc) {
+            long long budget = strtoll(argv[++i], NULL, 10);
+            stream_budget_mb = budget > 0 ? (unsigned long long)budget : 1;
         }
-        else if (strncmp(line, "f ", 2) == 0) {
-            unsigned int v[3], n[3];
-            int matches = sscanf_s(line + 2, "%u//%u %u//%u %u//%u",
-                &v[0], &n[0], &v[1], &n[1], &v[2], &n[2]);
-            if (matches == 6) {
-                for (int i = 0; i < 3; i++) {
-                    faces[face_count].v_idx[i] = v[i] - 1; // OBJ is 1-indexed
-                    faces[face_count].n_idx[i] = n[i] - 1;
-                }
-                face_count++;
-            }
-            else {
-                matches = sscanf_s(line + 2, "%u %u %u", &v[0], &v[1], &v[2]);
-                if (matches == 3) {
-                    for (int i = 0; i < 3; i++) {
-                        faces[face_count].v_idx[i] = v[i] - 1;
-                        faces[face_count].n_idx[i] = 0;
-                    }
-                    face_count++;
-                }
-                else {
-                    printf("WARNING: Failed to parse face line: %s", line);
-                }
+        else if (strcmp(argv[i], "--no-buffer-storage") == 0) buffer_storage = 0;
+        else if (strcmp(argv[i], "--headless") == 0) headless = 1;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            long long frames = atoll(argv[++i]);
+            frame_limit = frames > 0 ? (unsigned long long)frames : 0;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) output_path = argv[++i];
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) capture_prefix = argv[++i];
+        else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc) profile_csv = argv[++i];
+        else if (strcmp(argv[i], "--no-vsync") == 0) vsync = 0;
+        else if (strcmp(argv[i], "--fixed-time") == 0) fixed_time = 1;
+        else if (strcmp(argv[i], "--no-shader-cache") == 0) shader_cache = 0;
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            int w = 0, h = 0;
+            const char* size = argv[++i];
+            w = atoi(size);
+            const char* x = strchr(size, 'x');
+            if (x) h = atoi(x + 1);
+            if (w > 0 && h > 0) {
+                width = w;
+                height = h;
             }
+            else printf("WARNING: --size expects WIDTHxHEIGHT, got %s\n", size);
         }
+        else if (argv[i][0] != '-') obj_path = argv[i];
+        else printf("WARNING: Unknown option %s\n", argv[i]);
     }
-    fclose(file);
 
-    if (normal_count == 0) {
-        normals[0].x = 0.0f;
-        normals[0].y = 0.0f;
-        normals[0].z = 1.0f;
-        normal_count = 1;
+    // A streamed mesh is drawn once, chunk by chunk, in its own space
+    if (use_stream && (instance_count > 1 || use_meshlets || (model_options & MODEL_LOD))) {
+        printf("WARNING: --stream draws a single copy without meshlets or LOD\n");
+        instance_count = 1;
+        use_meshlets = 0;
     }
 
-    printf("OBJ loaded: %d vertices, %d normals, %d faces\n", vertex_count, normal_count, face_count);
-    return 1;
-}
-
-//-------------------------------------------------------------//
-//               Matrix helpers (column-major)                 //
-//-------------------------------------------------------------//
-
-void mat4_identity(float* mat) {
-    for (int i = 0; i < 16; i++) mat[i] = 0.0f;
-    mat[0] = 1.0f;
-    mat[5] = 1.0f;
-    mat[10] = 1.0f;
-    mat[15] = 1.0f;
-}
-
-void mat4_perspective(float* mat, float fovy, float aspect, float near, float far) {
-    float f = 1.0f / tanf(fovy * 3.14159265f / 360.0f);
-    mat[0] = f / aspect;
-    mat[1] = 0;
-    mat[2] = 0;
-    mat[3] = 0;
-
-    mat[4] = 0;
-    mat[5] = f;
-    mat[6] = 0;
-    mat[7] = 0;
-
-    mat[8] = 0;
-    mat[9] = 0;
-    mat[10] = (far + near) / (near - far);
-    mat[11] = -1;
-
-    mat[12] = 0;
-    mat[13] = 0;
-    mat[14] = (2 * far * near) / (near - far);
-    mat[15] = 0;
-}
-
-void vec3_sub(Vec3* result, Vec3 a, Vec3 b) {
-    result->x = a.x - b.x;
-    result->y = a.y - b.y;
-    result->z = a.z - b.z;
-}
-
-void vec3_normalize(Vec3* v) {
-    float len = sqrtf(v->x * v->x + v->y * v->y + v->z * v->z);
-    if (len > 0.00001f) {
-        v->x /= len;
-        v->y /= len;
-        v->z /= len;
+    // A headless run has to end by itself
+    if (headless && frame_limit == 0) frame_limit = 60;
+    if (output_path && frame_limit == 0) {
+        printf("WARNING: --output needs --frames N to know which frame to save\n");
+        output_path = NULL;
     }
-}
-
-void vec3_cross(Vec3* result, Vec3 a, Vec3 b) {
-    result->x = a.y * b.z - a.z * b.y;
-    result->y = a.z * b.x - a.x * b.z;
-    result->z = a.x * b.y - a.y * b.x;
-}
-
-void mat4_lookat(float* mat, Vec3 eye, Vec3 center, Vec3 up) {
-    Vec3 f, s, u;
-    vec3_sub(&f, center, eye);
-    vec3_normalize(&f);
-
-    vec3_cross(&s, f, up);
-    vec3_normalize(&s);
-
-    vec3_cross(&u, s, f);
-
-    mat[0] = s.x;
-    mat[1] = u.x;
-    mat[2] = -f.x;
-    mat[3] = 0;
 
-    mat[4] = s.y;
-    mat[5] = u.y;
-    mat[6] = -f.y;
-    mat[7] = 0;
-
-    mat[8] = s.z;
-    mat[9] = u.z;
-    mat[10] = -f.z;
-    mat[11] = 0;
-
-    mat[12] = -(s.x * eye.x + s.y * eye.y + s.z * eye.z);
-    mat[13] = -(u.x * eye.x + u.y * eye.y + u.z * eye.z);
-    mat[14] = (f.x * eye.x + f.y * eye.y + f.z * eye.z);
-    mat[15] = 1;
-}
-
-//-------------------------------------------------------------//
-//                        Main program                         //
-//-------------------------------------------------------------//
-int main() {
+    if (run_bench_math || run_bench_transforms || run_bench_bvh || run_bench_obj) {
+        if (run_bench_math) bench_math();
+        if (run_bench_transforms) bench_transforms();
+        if (run_bench_bvh) bench_bvh(obj_path);
+        if (run_bench_obj) bench_obj(obj_path);
+        return 0;
+    }
 
-    if (!glfwInit()) {
+    if (!headless && !glfwInit()) {
         printf("Failed to initialize GLFW\n");
         return -1;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
     //-------------------------------------------------------------//
     //                  Window instance generation                 //
     //-------------------------------------------------------------//
 
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Hello Po bsit 1-1n", NULL, NULL);
+    GLFWwindow* window = NULL;
+    if (headless) {
+        window = create_headless_window(width, height);
+    }
+    else {
+        set_context_hints();
+        window = glfwCreateWindow(width, height, "Hello Po bsit 1-1n", NULL, NULL);
+    }
     if (window == NULL) {
         printf("FATAL ERROR BOBO KA NU GINAGAWA MO\n");
         glfwTerminate();
@@ -238,180 +231,570 @@ int main() {
         printf("Failed to initialize GLAD\n");
         return -1;
     }
+    gl_extensions_load(); // optional entry points glad does not cover
+    if (!shader_cache) gl_extensions_disable("GL_ARB_get_program_binary");
+
+    // Headless frames render into an FBO, the window's framebuffer may not even be usable
+    Offscreen offscreen = { 0 };
+    if (headless) {
+        if (!offscreen_create(&offscreen, width, height)) {
+            glfwTerminate();
+            return -1;
+        }
+        offscreen_bind(&offscreen);
+    }
+    glfwSwapInterval(vsync && !headless ? 1 : 0);
 
-    glViewport(0, 0, 800, 600);
+    glViewport(0, 0, width, height);
 
     //-------------------------------------------------------------//
     //                  Load OBJ and setup buffers                 //
     //-------------------------------------------------------------//
 
-    if (!load_obj("cube.obj")) {  // Make sure cube.obj is in your executable folder
-        glfwTerminate();
-        return -1;
-    }
-
-    float* vertex_data = malloc(sizeof(float) * face_count * 3 * 6); // 3 verts per face, 6 floats per vertex
-    if (!vertex_data) {
-        printf("Memory allocation failed\n");
-        glfwTerminate();
-        return -1;
-    }
-
-    int idx = 0;
-    for (int i = 0; i < face_count; i++) {
-        for (int j = 0; j < 3; j++) {
-            Vec3 v = vertices[faces[i].v_idx[j]];
-            Vec3 n = normals[faces[i].n_idx[j]];
-            vertex_data[idx++] = v.x;
-            vertex_data[idx++] = v.y;
-            vertex_data[idx++] = v.z;
-            vertex_data[idx++] = n.x;
-            vertex_data[idx++] = n.y;
-            vertex_data[idx++] = n.z;
+    parallel_init(0); // one worker per logical processor
+
+    // The model loads on its own thread while the render loop already
+    // presents frames; its buffers are uploaded in the loop once it is done
+    ModelLoader loader;
+    MeshStream stream = { 0 };
+    if (use_stream) {
+        if (!mesh_stream_open(&stream, obj_path, stream_budget_mb << 20)) {
+            parallel_shutdown();
+            glfwTerminate();
+            return -1;
         }
+        // Chunks hold float vertices in object space; the model itself stays empty
+        memset(&loader, 0, sizeof(loader));
+        for (int i = 0; i < 3; i++) loader.model.buffers.position_scale[i] = 1.0f;
+        loader.model.buffers.index_size = 2;
+        loader.model.buffers.lod_count = 1;
+        loader.model.buffers.bounds = stream.bounds;
+        loader.ok = 1;
+        loader.finished = 1;
+    }
+    else {
+        model_loader_start(&loader, obj_path, model_options);
     }
 
     //-------------------------------------------------------------//
     //                        Shaders                              //
     //-------------------------------------------------------------//
+    // INSTANCED reads the matrices from per-instance attributes instead
+    // of uniforms. Meshlets pick a different subset per copy, so they
+    // need the per-object path.
+    int instanced = instance_count > 1 && !draw_per_object && !use_meshlets;
 
     const char* vertex_shader_source =
         "#version 330 core\n"
+        FRAME_DATA_GLSL
         "layout(location = 0) in vec3 aPos;\n"
         "layout(location = 1) in vec3 aNormal;\n"
         "out vec3 Normal;\n"
         "out vec3 FragPos;\n"
+        "#ifdef INSTANCED\n"
+        INSTANCE_ATTRIBUTES_GLSL
+        "#define MODEL_MATRIX instanceModel\n"
+        "#define NORMAL_MATRIX instanceNormalMatrix\n"
+        "#else\n"
         "uniform mat4 model;\n"
-        "uniform mat4 view;\n"
-        "uniform mat4 projection;\n"
+        "uniform mat3 normalMatrix;\n"  // transpose(inverse(model)), from the CPU
+        "#define MODEL_MATRIX model\n"
+        "#define NORMAL_MATRIX normalMatrix\n"
+        "#endif\n"
+        "uniform vec3 positionScale;\n"  // decodes quantized positions, identity for floats
+        "uniform vec3 positionOffset;\n"
         "void main() {\n"
-        "   vec4 worldPos = model * vec4(aPos, 1.0);\n"
+        "   vec4 worldPos = MODEL_MATRIX * vec4(aPos * positionScale + positionOffset, 1.0);\n"
         "   FragPos = worldPos.xyz;\n"
-        "   Normal = mat3(transpose(inverse(model))) * aNormal;\n"
-        "   gl_Position = projection * view * worldPos;\n"
+        "#ifdef GPU_NORMAL_MATRIX\n"
+        "   Normal = mat3(transpose(inverse(MODEL_MATRIX))) * aNormal;\n"
+        "#else\n"
+        "   Normal = NORMAL_MATRIX * aNormal;\n"
+        "#endif\n"
+        "   gl_Position = viewProj * worldPos;\n"
         "}\0";
 
     const char* fragment_shader_source =
         "#version 330 core\n"
+        FRAME_DATA_GLSL
         "in vec3 Normal;\n"
         "in vec3 FragPos;\n"
         "out vec4 FragColor;\n"
-        "uniform vec3 viewPos;\n"
         "void main() {\n"
-        "   vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));\n"
+        "   vec3 toLight = lightDir.xyz;\n"
         "   vec3 norm = normalize(Normal);\n"
-        "   float diff = max(dot(norm, lightDir), 0.0);\n"
-        "   vec3 diffuse = diff * vec3(1.0, 0.5, 0.31);\n"
-        "   vec3 ambient = vec3(0.1, 0.1, 0.1);\n"
-        "   vec3 viewDir = normalize(viewPos - FragPos);\n"
-        "   vec3 reflectDir = reflect(-lightDir, norm);\n"
-        "   float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);\n"
-        "   vec3 specular = spec * vec3(1.0);\n"
+        "   float diff = max(dot(norm, toLight), 0.0);\n"
+        "   vec3 diffuse = diff * lightColor.rgb;\n"
+        "   vec3 ambient = ambientColor.rgb;\n"
+        "   vec3 viewDir = normalize(cameraPos.xyz - FragPos);\n"
+        "   vec3 reflectDir = reflect(-toLight, norm);\n"
+        "   float spec = pow(max(dot(viewDir, reflectDir), 0.0), specularColor.w);\n"
+        "   vec3 specular = spec * specularColor.rgb;\n"
         "   vec3 result = ambient + diffuse + specular;\n"
         "   FragColor = vec4(result, 1.0);\n"
         "}\0";
 
-    unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
-    glCompileShader(vertex_shader);
-    check_compile_errors(vertex_shader, "VERTEX");
-
-    unsigned int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
-    glCompileShader(fragment_shader);
-    check_compile_errors(fragment_shader, "FRAGMENT");
-
-    unsigned int shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    check_compile_errors(shader_program, "PROGRAM");
+    char shader_defines[128];
+    snprintf(shader_defines, sizeof(shader_defines), "%s%s",
+        gpu_normal_matrix ? "#define GPU_NORMAL_MATRIX\n" : "",
+        instanced ? "#define INSTANCED\n" : "");
+
+    ShaderProgram shader;
+    if (!shader_program_create(&shader, vertex_shader_source, fragment_shader_source, shader_defines)) {
+        model_loader_wait(&loader);
+        model_free(&loader.model);
+        mesh_stream_close(&stream);
+        parallel_shutdown();
+        glfwTerminate();
+        return -1;
+    }
 
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+    // Resolved once here instead of glGetUniformLocation every frame
+    int model_uniform = shader_uniform_index(&shader, "model");
+    int normal_matrix_uniform = shader_uniform_index(&shader, "normalMatrix"); // -1 in the GPU and instanced variants
+    int position_scale_uniform = shader_uniform_index(&shader, "positionScale");
+    int position_offset_uniform = shader_uniform_index(&shader, "positionOffset");
+
+    // Camera and light state comes from the shared per-frame block
+    shader_bind_uniform_block(&shader, "FrameData", FRAME_UBO_BINDING);
+    FrameUniformBuffer frame_ubo;
+    if (!frame_ubo_create(&frame_ubo, buffer_storage)) {
+        model_loader_wait(&loader);
+        model_free(&loader.model);
+        mesh_stream_close(&stream);
+        shader_program_destroy(&shader);
+        parallel_shutdown();
+        glfwTerminate();
+        return -1;
+    }
 
     //-------------------------------------------------------------//
     //                     Setup VAO/VBO                            //
     //-------------------------------------------------------------//
 
-    unsigned int VAO, VBO;
+    unsigned int VAO, VBO, EBO;
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
 
+    // The vertex layout and data follow at the model handoff
     glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * face_count * 3 * 6, vertex_data, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    InstanceBuffer instance_buffer = { 0 };
+    if (instanced) {
+        if (!instance_buffer_create(&instance_buffer, instance_count, buffer_storage)) {
+            glBindVertexArray(0);
+            model_loader_wait(&loader);
+            model_free(&loader.model);
+            shader_program_destroy(&shader);
+            parallel_shutdown();
+            glfwTerminate();
+            return -1;
+        }
+        instance_buffer_bind_attributes(&instance_buffer);
+    }
     glBindVertexArray(0);
 
-    free(vertex_data);
+    // Filled in from the model at the handoff
+    GLenum index_type = GL_UNSIGNED_SHORT;
+    unsigned int index_size = 2;
+    GLsizei index_count = 0;
+    MeshLod lods[MESH_MAX_LODS];
+    unsigned int lod_count = 1;
+    Bounds model_bounds;
+    memset(lods, 0, sizeof(lods));
+    memset(&model_bounds, 0, sizeof(model_bounds));
+    MeshletSet meshlets = { 0 };
+    MeshletCuller meshlet_culler = { 0 };
+    LodSelector lod_selector = { 0 };
+    int model_ready = 0;
+    int model_visible = 0;
+    int load_failed = 0;
+
+    //-------------------------------------------------------------//
+    //                          Objects                            //
+    //-------------------------------------------------------------//
+    // Copies of the model on a grid, spinning when there is more than
+    // one. A single copy sits at the origin untransformed.
+    Transforms transforms;
+    transforms_init(&transforms);
+    float scene_radius = instances_layout_grid(&transforms, instance_count, 3.0f);
+    int animate = instance_count > 1;
+
+    // Only the per-object path needs the matrices on the CPU side
+    float* object_models = NULL;
+    float* object_normals = NULL;
+    if (!instanced) {
+        object_models = malloc((size_t)instance_count * 16 * sizeof(float));
+        object_normals = malloc((size_t)instance_count * 9 * sizeof(float));
+    }
+    InstanceCuller culler = { 0 };
+    if (cull && !instance_culler_create(&culler, instance_count)) cull = 0;
+
+    if (transforms.count != instance_count || (!instanced && (!object_models || !object_normals))) {
+        printf("FATAL ERROR: Out of memory for %d objects\n", instance_count);
+        free(object_models);
+        free(object_normals);
+        instance_culler_destroy(&culler);
+        meshlet_culler_destroy(&meshlet_culler);
+        meshlets_free(&meshlets);
+        transforms_free(&transforms);
+        instance_buffer_destroy(&instance_buffer);
+        mesh_stream_close(&stream);
+        model_loader_wait(&loader);
+        model_free(&loader.model);
+        shader_program_destroy(&shader);
+        parallel_shutdown();
+        glfwTerminate();
+        return -1;
+    }
 
     //-------------------------------------------------------------//
     //                Camera control variables                     //
     //-------------------------------------------------------------//
     float camera_angle = 0.005f;
-    float camera_radius = 5.0f;
+    float camera_angle_previous = camera_angle;
+    double scene_time = 0.0;          // drives the object animation
+    double scene_time_previous = 0.0;
+    float camera_radius = 5.0f + scene_radius * 0.5f; // inside large grids, so culling has work
 
     //-------------------------------------------------------------//
     //                      Render loop start                       //
     //-------------------------------------------------------------//
     glEnable(GL_DEPTH_TEST);
 
-    float model_matrix[16];
-    mat4_identity(model_matrix);
+    // The aspect ratio and the light never change, so they are set up once
+    FrameData frame_data;
+    memset(&frame_data, 0, sizeof(frame_data));
+    mat4_perspective(frame_data.projection, 120.0f, (float)width / (float)height, 0.1f, camera_radius + scene_radius + 100.0f);
+
+    Vec3 light_dir = { 1.0f, 1.0f, 1.0f };
+    vec3_normalize(&light_dir);
+    frame_data.light_direction[0] = light_dir.x;
+    frame_data.light_direction[1] = light_dir.y;
+    frame_data.light_direction[2] = light_dir.z;
+    frame_data.light_color[0] = 1.0f;
+    frame_data.light_color[1] = 0.5f;
+    frame_data.light_color[2] = 0.31f;
+    frame_data.ambient_color[0] = 0.1f;
+    frame_data.ambient_color[1] = 0.1f;
+    frame_data.ambient_color[2] = 0.1f;
+    frame_data.specular_color[0] = 1.0f;
+    frame_data.specular_color[1] = 1.0f;
+    frame_data.specular_color[2] = 1.0f;
+    frame_data.specular_color[3] = 32.0f;
+
+    unsigned long long frame_count = 0;
+    unsigned long long draw_calls = 0;
+    double cpu_seconds = 0.0;     // per frame, from the top of the loop to the swap
+    double cpu_seconds_max = 0.0;
+
+    FrameCapture capture = { 0 };
+    if (capture_prefix && !capture_start(&capture, capture_prefix, width, height)) capture_prefix = NULL;
+
+    // Headless and captured runs must draw the same frames every time: the
+    // model is in place before the first one, every streamed chunk the
+    // camera wants is resident before it is drawn, and the simulation
+    // advances one step per frame
+    int reproducible = headless || capture_prefix != NULL;
+    if (reproducible) model_loader_wait(&loader);
+
+    // CPU and GPU time of the parts of a frame, percentiles at exit
+    Profiler profiler;
+    profiler_create(&profiler, profile_csv);
+    int scope_update = profiler_scope(&profiler, "update", 0);
+    int scope_draw = profiler_scope(&profiler, "draw", 1);
+    int scope_capture = profiler_scope(&profiler, "capture", 1);
+    int scope_swap = profiler_scope(&profiler, "swap", 0);
+
+    Timestep timestep;
+    timestep_init(&timestep, SIMULATION_STEP, fixed_time || reproducible, glfwGetTime());
+
+    double loop_start = platform_time_seconds();
+    while (!glfwWindowShouldClose(window) && (frame_limit == 0 || frame_count < frame_limit)) {
+        double frame_start = platform_time_seconds();
 
-    while (!glfwWindowShouldClose(window)) {
         glClearColor(0.1f, 0.15f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(shader_program);
+        profiler_begin(&profiler, scope_update);
+        shader_program_use(&shader);
 
-        camera_angle += 0.0005f;
+        // Whole simulation steps, then the view blends the last two states
+        int steps = timestep_advance(&timestep, glfwGetTime());
+        for (int step = 0; step < steps; step++) {
+            camera_angle_previous = camera_angle;
+            scene_time_previous = scene_time;
+            camera_angle += CAMERA_RADIANS_PER_SECOND * (float)SIMULATION_STEP;
+            scene_time += SIMULATION_STEP;
+        }
+        float alpha = timestep_alpha(&timestep);
+        float view_angle = camera_angle_previous + (camera_angle - camera_angle_previous) * alpha;
 
-        Vec3 eye = { camera_radius * sinf(camera_angle), 1.5f, camera_radius * cosf(camera_angle) };
+        Vec3 eye = { camera_radius * sinf(view_angle), 1.5f, camera_radius * cosf(view_angle) };
         Vec3 center = { 0.0f, 0.0f, 0.0f };
         Vec3 up = { 0.0f, 1.0f, 0.0f };
 
-        float projection[16];
-        mat4_perspective(projection, 120.0f, 800.0f / 600.0f, 0.1f, 100.0f);
+        mat4_lookat(frame_data.view, eye, center, up);
+        mat4_multiply(frame_data.view_projection, frame_data.projection, frame_data.view);
+        frame_data.camera_position[0] = eye.x;
+        frame_data.camera_position[1] = eye.y;
+        frame_data.camera_position[2] = eye.z;
+        frame_ubo_update(&frame_ubo, &frame_data);
+
+        // The rotations are a closed form of time, so blending the time blends them
+        if (animate) instances_animate(&transforms, scene_time_previous + (scene_time - scene_time_previous) * alpha);
+        profiler_end(&profiler, scope_update);
+
+        //-------------------------------------------------------------//
+        //                        Model handoff                        //
+        //-------------------------------------------------------------//
+        // Runs once, on the first frame after the loader finished: the
+        // upload belongs to the GL thread, then the CPU copy goes away
+        if (!model_ready && model_loader_poll(&loader)) {
+            if (!loader.ok) {
+                load_failed = 1;
+                break;
+            }
+            double upload_start = platform_time_seconds();
+            const MeshBuffers* buffers = &loader.model.buffers;
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)buffers->vertex_stride * buffers->vertex_count, buffers->vertices, GL_STATIC_DRAW);
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)buffers->index_size * buffers->index_count, buffers->indices, GL_STATIC_DRAW);
+            index_type = buffers->index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            index_size = buffers->index_size;
+
+            GLsizei stride = (GLsizei)buffers->vertex_stride;
+            if (buffers->vertex_format == VERTEX_FORMAT_PACKED) {
+                // snorm16 xyzw position, then one 2_10_10_10 normal word
+                glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, (void*)0);
+                glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(4 * sizeof(short)));
+            }
+            else {
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+            }
+            glEnableVertexAttribArray(0);
+            glEnableVertexAttribArray(1);
+
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindVertexArray(0); // the element buffer binding stays recorded in the VAO
+
+            // Level 0 is the full mesh; simplified levels follow it in the index buffer
+            index_count = (GLsizei)buffers->lods[0].index_count;
+            lod_count = buffers->lod_count;
+            memcpy(lods, buffers->lods, sizeof(lods));
+            shader_set_vec3(&shader, position_scale_uniform, buffers->position_scale);
+            shader_set_vec3(&shader, position_offset_uniform, buffers->position_offset);
+            model_bounds = buffers->bounds;
+
+            // Meshlets only keep index ranges, so they outlive the model buffers
+            if (use_meshlets && (!meshlets_build(buffers, &meshlets) || !meshlet_culler_create(&meshlet_culler, &meshlets))) {
+                printf("WARNING: Meshlets unavailable, drawing whole objects\n");
+                meshlets_free(&meshlets);
+                use_meshlets = 0;
+            }
+            if (use_meshlets) glEnable(GL_CULL_FACE); // the cone test drops what back-face culling would
+            if (lod_count > 1 && !lod_selector_create(&lod_selector, instance_count)) lod_count = 1;
+            model_free(&loader.model);
+            profiler_event(&profiler, "load", loader.seconds);
+            profiler_event(&profiler, "upload", platform_time_seconds() - upload_start);
+            model_ready = 1;
+        }
 
-        float view[16];
-        mat4_lookat(view, eye, center, up);
+        // Nothing to draw until the handoff, but frames keep coming
+        if (model_ready) {
+            profiler_begin(&profiler, scope_update);
+            // The single streamed copy sits at the origin, so world space is its own space
+            if (use_stream) {
+                mesh_stream_update(&stream, frame_data.view_projection, eye);
+                if (reproducible) mesh_stream_wait(&stream);
+            }
 
-        int model_loc = glGetUniformLocation(shader_program, "model");
-        int view_loc = glGetUniformLocation(shader_program, "view");
-        int proj_loc = glGetUniformLocation(shader_program, "projection");
-        int viewpos_loc = glGetUniformLocation(shader_program, "viewPos");
+            // Only copies that touch the frustum get matrices and draws
+            const Transforms* drawn = &transforms;
+            if (cull && instance_culler_run(&culler, &transforms, &model_bounds, frame_data.view_projection) >= 0) {
+                drawn = &culler.visible;
+            }
 
-        glUniformMatrix4fv(model_loc, 1, GL_FALSE, model_matrix);
-        glUniformMatrix4fv(view_loc, 1, GL_FALSE, view);
-        glUniformMatrix4fv(proj_loc, 1, GL_FALSE, projection);
-        glUniform3f(viewpos_loc, eye.x, eye.y, eye.z);
+            // Grouped by level of detail, each level a contiguous run of objects
+            unsigned int levels = 1;
+            int level_start[MESH_MAX_LODS + 1] = { 0, drawn->count };
+            if (lod_count > 1 && lod_selector_run(&lod_selector, drawn, &model_bounds, lods, lod_count,
+                    frame_data.projection, eye, (float)height, LOD_ERROR_PIXELS) >= 0) {
+                drawn = &lod_selector.sorted;
+                levels = lod_count;
+                memcpy(level_start, lod_selector.level_start, sizeof(level_start));
+            }
+            profiler_end(&profiler, scope_update);
+
+            profiler_begin(&profiler, scope_draw);
+            glBindVertexArray(VAO);
+            if (instanced) {
+                // Matrices go straight into the instance buffer, one draw per level for all its copies
+                if (drawn->count > 0) {
+                    instance_buffer_update(&instance_buffer, drawn, drawn->count);
+                    for (unsigned int level = 0; level < levels; level++) {
+                        int first = level_start[level];
+                        int count = level_start[level + 1] - first;
+                        if (count == 0) continue;
+                        if (lod_count > 1) instance_buffer_bind_attributes_from(&instance_buffer, first);
+                        glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)lods[level].index_count, index_type,
+                            (void*)((size_t)lods[level].first_index * index_size), count);
+                        draw_calls++;
+                    }
+                }
+            }
+            else {
+                // Normal matrices once per object instead of once per vertex
+                transforms_compute(drawn, object_models, object_normals);
+                unsigned int level = 0;
+                for (int i = 0; i < drawn->count; i++) {
+                    while (i >= level_start[level + 1]) level++;
+                    const float* object_model = object_models + (size_t)i * 16;
+                    shader_set_mat4(&shader, model_uniform, object_model);
+                    shader_set_mat3(&shader, normal_matrix_uniform, object_normals + (size_t)i * 9);
+                    if (use_stream) {
+                        mesh_stream_draw(&stream);
+                    }
+                    else if (level > 0) {
+                        // Meshlets only cover the full mesh
+                        glDrawElements(GL_TRIANGLES, (GLsizei)lods[level].index_count, index_type,
+                            (void*)((size_t)lods[level].first_index * index_size));
+                    }
+                    else if (use_meshlets) {
+                        int ranges = meshlet_culler_run(&meshlet_culler, &meshlets, object_model,
+                            frame_data.view_projection, eye, (unsigned int)index_size);
+                        if (ranges == 0) continue;
+                        glMultiDrawElements(GL_TRIANGLES, meshlet_culler.counts, index_type, meshlet_culler.offsets, ranges);
+                    }
+                    else {
+                        glDrawElements(GL_TRIANGLES, index_count, index_type, (void*)0);
+                    }
+                    draw_calls++;
+                }
+                if (use_meshlets) meshlet_culler_end_frame(&meshlet_culler);
+            }
+            glBindVertexArray(0);
+            profiler_end(&profiler, scope_draw);
+        }
 
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, face_count * 3);
-        glBindVertexArray(0);
+        frame_ubo_end_frame(&frame_ubo);
+        if (instanced) instance_buffer_end_frame(&instance_buffer);
+        shader_stats_end_frame();
+        frame_count++;
+
+        double frame_cpu = platform_time_seconds() - frame_start;
+        cpu_seconds += frame_cpu;
+        if (frame_cpu > cpu_seconds_max) cpu_seconds_max = frame_cpu;
+
+        profiler_begin(&profiler, scope_capture);
+        if (capture_prefix) capture_frame(&capture);
+        if (output_path && frame_count == frame_limit) {
+            unsigned char* rgb = malloc((size_t)width * (size_t)height * 3);
+            if (rgb) {
+                framebuffer_read_rgb(width, height, rgb);
+                if (image_write_ppm(output_path, rgb, width, height, 3)) printf("Saved frame %llu to %s\n", frame_count, output_path);
+                free(rgb);
+            }
+            else {
+                printf("WARNING: Out of memory saving %s\n", output_path);
+            }
+        }
+        profiler_end(&profiler, scope_capture);
 
-        glfwSwapBuffers(window);
+        profiler_begin(&profiler, scope_swap);
+        if (!headless) glfwSwapBuffers(window);
         glfwPollEvents();
+        profiler_end(&profiler, scope_swap);
+        profiler_end_frame(&profiler);
+
+        // Time to interactive is the first frame; the model shows up whenever its load is done
+        if (frame_count == 1) {
+            printf("Time to first frame: %.3f ms\n", (platform_time_seconds() - program_start) * 1000.0);
+        }
+        if (model_ready && !model_visible) {
+            model_visible = 1;
+            printf("Time to model visible: %.3f ms (frame %llu, %.3f ms loading on the loader thread)\n",
+                (platform_time_seconds() - program_start) * 1000.0, frame_count, loader.seconds * 1000.0);
+        }
+    }
+
+    capture_finish(&capture); // the last frames are still in flight
+    profiler_finish(&profiler);
+    if (headless && frame_count > 0) {
+        glFinish(); // count the GPU work too
+        double seconds = platform_time_seconds() - loop_start;
+        printf("Headless: %llu frames at %dx%d in %.3f s, %.1f frames per second\n",
+            frame_count, width, height, seconds, (double)frame_count / seconds);
+    }
+
+    if (frame_count > 0) {
+        ShaderStats stats = shader_stats_total();
+        printf("GL state calls per frame: %.2f issued, %.2f avoided as redundant\n",
+            (double)stats.calls_issued / (double)frame_count, (double)stats.calls_avoided / (double)frame_count);
+        ring_buffer_print_stats(&frame_ubo.ring, "Frame UBO");
+        if (instanced) ring_buffer_print_stats(&instance_buffer.ring, "Instance");
+        capture_print_stats(&capture);
+        profiler_print(&profiler);
+        timestep_print_stats(&timestep);
+        printf("%d objects (%s): %.1f draw calls per frame, CPU %.3f ms avg, %.3f ms max per frame\n",
+            instance_count, instanced ? "instanced" : "one draw per object",
+            (double)draw_calls / (double)frame_count, cpu_seconds * 1000.0 / (double)frame_count, cpu_seconds_max * 1000.0);
+        if (culler.frames > 0) {
+            printf("Frustum culling: %.1f visible, %.1f culled per frame, %.3f ms per frame\n",
+                (double)culler.visible_total / (double)culler.frames, (double)culler.culled_total / (double)culler.frames,
+                culler.seconds * 1000.0 / (double)culler.frames);
+        }
+        if (meshlet_culler.frames > 0) {
+            double frames = (double)meshlet_culler.frames;
+            unsigned long long culled = meshlet_culler.triangles_frustum_culled + meshlet_culler.triangles_cone_culled;
+            printf("Meshlet culling: %.0f of %.0f triangles culled per frame (%.0f frustum, %.0f back-facing), "
+                "%.1f draw ranges per frame, %.3f ms per frame\n",
+                (double)culled / frames, (double)meshlet_culler.triangles_total / frames,
+                (double)meshlet_culler.triangles_frustum_culled / frames, (double)meshlet_culler.triangles_cone_culled / frames,
+                (double)meshlet_culler.ranges_total / frames, meshlet_culler.seconds * 1000.0 / frames);
+        }
+        mesh_stream_print_stats(&stream);
+        if (lod_selector.frames > 0) {
+            double frames = (double)lod_selector.frames;
+            printf("LOD: %.0f of %.0f triangles drawn per frame (%.1f%%), objects per level:",
+                (double)lod_selector.triangles_drawn / frames, (double)lod_selector.triangles_full / frames,
+                lod_selector.triangles_full ? 100.0 * (double)lod_selector.triangles_drawn / (double)lod_selector.triangles_full : 0.0);
+            for (unsigned int level = 0; level < lod_count; level++) {
+                printf(" %.1f", (double)lod_selector.objects_per_level[level] / frames);
+            }
+            printf(", %.3f ms per frame\n", lod_selector.seconds * 1000.0 / frames);
+        }
     }
 
     //-------------------------------------------------------------//
     //                         Cleanup                             //
     //-------------------------------------------------------------//
+    model_loader_wait(&loader); // closed before the load finished
+    if (!model_ready) model_free(&loader.model);
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
-    glDeleteProgram(shader_program);
-
+    glDeleteBuffers(1, &EBO);
+    instance_buffer_destroy(&instance_buffer);
+    mesh_stream_close(&stream);
+    instance_culler_destroy(&culler);
+    lod_selector_destroy(&lod_selector);
+    meshlet_culler_destroy(&meshlet_culler);
+    meshlets_free(&meshlets);
+    transforms_free(&transforms);
+    free(object_models);
+    free(object_normals);
+    frame_ubo_destroy(&frame_ubo);
+    shader_program_destroy(&shader);
+    offscreen_destroy(&offscreen);
+    profiler_destroy(&profiler);
+
+    parallel_shutdown();
     glfwDestroyWindow(window);
     glfwTerminate();
 
-    return 0;
+    return load_failed ? -1 : 0;
 }
@@ -0,0 +1,498 @@
+#include "bench.h"
+#include "bvh.h"
+#include "math3d.h"
+#include "obj_loader.h"
+#include "parallel.h"
+#include "platform.h"
+#include "transform.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------//
+//                         Test inputs                          //
+//-------------------------------------------------------------//
+#define BENCH_MATRICES 1024
+#define BENCH_POINTS 4096
+#define BENCH_OPS 4000000 // per case, so every row does the same work
+
+static float matrices[BENCH_MATRICES * 16];
+static float results[BENCH_MATRICES * 16];
+static float reference[BENCH_MATRICES * 16];
+static Vec3 points[BENCH_POINTS];
+static Vec3 point_results[BENCH_POINTS];
+static Vec3 point_reference[BENCH_POINTS];
+static float normal_reference[BENCH_MATRICES * 9];
+static float sphere_center[3][BENCH_POINTS];
+static float sphere_radius[BENCH_POINTS];
+static int visible_indices[BENCH_POINTS];
+static Frustum frustum;
+
+static unsigned int rng_state = 12345u;
+
+static float random_float(float lo, float hi) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return lo + (hi - lo) * (float)(rng_state >> 8) / 16777216.0f;
+}
+
+// Random translate/rotate/scale matrices, the shape model matrices have
+static void make_inputs(void) {
+    for (int i = 0; i < BENCH_MATRICES; i++) {
+        Vec3 t = { random_float(-50, 50), random_float(-50, 50), random_float(-50, 50) };
+        Vec3 axis = { random_float(-1, 1), random_float(-1, 1), random_float(-1, 1) };
+        vec3_normalize(&axis);
+        Vec3 s = { random_float(0.5f, 2), random_float(0.5f, 2), random_float(0.5f, 2) };
+        mat4_from_trs(matrices + i * 16, t, quat_from_axis_angle(axis, random_float(0, 6.28f)), s);
+    }
+    for (int i = 0; i < BENCH_POINTS; i++) {
+        points[i].x = random_float(-10, 10);
+        points[i].y = random_float(-10, 10);
+        points[i].z = random_float(-10, 10);
+        sphere_center[0][i] = points[i].x;
+        sphere_center[1][i] = points[i].y;
+        sphere_center[2][i] = points[i].z;
+        sphere_radius[i] = random_float(0.1f, 1.0f);
+    }
+
+    // Looking across the point cloud from its edge, so roughly half of it is culled
+    float projection[16], view[16], view_projection[16];
+    Vec3 eye = { 0.0f, 0.0f, 10.0f }, center = { 0.0f, 0.0f, 0.0f }, up = { 0.0f, 1.0f, 0.0f };
+    mat4_perspective(projection, 60.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+    mat4_lookat(view, eye, center, up);
+    mat4_multiply(view_projection, projection, view);
+    frustum_from_matrix(&frustum, view_projection);
+}
+
+//-------------------------------------------------------------//
+//                            Cases                             //
+//-------------------------------------------------------------//
+// Each case runs `ops` operations through the dispatched functions and
+// leaves the output of the last pass over the inputs in results.
+typedef void (*BenchCaseFunc)(int ops);
+
+static void case_multiply(int ops) {
+    for (int n = 0; n < ops; n++) {
+        int i = n & (BENCH_MATRICES - 1);
+        mat4_multiply(results + i * 16, matrices + i * 16, matrices + ((i + 1) & (BENCH_MATRICES - 1)) * 16);
+    }
+}
+
+static void case_transpose(int ops) {
+    for (int n = 0; n < ops; n++) {
+        int i = n & (BENCH_MATRICES - 1);
+        mat4_transpose(results + i * 16, matrices + i * 16);
+    }
+}
+
+static void case_inverse(int ops) {
+    for (int n = 0; n < ops; n++) {
+        int i = n & (BENCH_MATRICES - 1);
+        mat4_inverse(results + i * 16, matrices + i * 16);
+    }
+}
+
+static void case_multiply_batch(int ops) {
+    for (int n = 0; n < ops; n += BENCH_MATRICES) {
+        mat4_multiply_batch(results, matrices, matrices, BENCH_MATRICES);
+    }
+}
+
+static void case_transform_points(int ops) {
+    for (int n = 0; n < ops; n += BENCH_POINTS) {
+        mat4_transform_points(point_results, matrices, points, BENCH_POINTS);
+    }
+}
+
+// Marks visible spheres with 1 in results so backends can be compared
+static void case_cull_spheres(int ops) {
+    const float* center[3] = { sphere_center[0], sphere_center[1], sphere_center[2] };
+    int visible = 0;
+    for (int n = 0; n < ops; n += BENCH_POINTS) {
+        visible = frustum_cull_spheres(&frustum, center, sphere_radius, BENCH_POINTS, visible_indices);
+    }
+    memset(results, 0, sizeof(results));
+    for (int i = 0; i < visible; i++) results[visible_indices[i]] = 1.0f;
+}
+
+// The two ways to get a normal matrix; the outputs are compared as 3x3
+static void case_normal_matrix(int ops) {
+    for (int n = 0; n < ops; n++) {
+        int i = n & (BENCH_MATRICES - 1);
+        mat3_normal_matrix(results + i * 16, matrices + i * 16);
+    }
+}
+
+static void case_inverse_transpose(int ops) {
+    for (int n = 0; n < ops; n++) {
+        int i = n & (BENCH_MATRICES - 1);
+        float inverse[16];
+        mat4_inverse(inverse, matrices + i * 16);
+        mat4_transpose(results + i * 16, inverse);
+    }
+}
+
+typedef struct {
+    const char* name;
+    BenchCaseFunc func;
+    int outputs_points;
+} BenchCase;
+
+static const BenchCase cases[] = {
+    { "mat4_multiply", case_multiply, 0 },
+    { "mat4_transpose", case_transpose, 0 },
+    { "mat4_inverse", case_inverse, 0 },
+    { "mat4_multiply_batch", case_multiply_batch, 0 },
+    { "mat4_transform_points", case_transform_points, 1 },
+    { "frustum_cull_spheres", case_cull_spheres, 0 },
+};
+
+//-------------------------------------------------------------//
+//                           Runner                             //
+//-------------------------------------------------------------//
+static double time_case(BenchCaseFunc func) {
+    func(BENCH_OPS / 16); // warm up caches and branch predictors
+    double start = platform_time_seconds();
+    func(BENCH_OPS);
+    return (platform_time_seconds() - start) * 1e9 / BENCH_OPS;
+}
+
+static float max_difference(const float* a, const float* b, int count) {
+    float max_error = 0.0f;
+    for (int i = 0; i < count; i++) {
+        float error = fabsf(a[i] - b[i]);
+        if (error > max_error) max_error = error;
+    }
+    return max_error;
+}
+
+void bench_math(void) {
+    MathBackend backends[] = { MATH_BACKEND_SCALAR, MATH_BACKEND_SSE, MATH_BACKEND_NEON };
+    MathBackend previous = math_get_backend();
+    int case_count = (int)(sizeof(cases) / sizeof(cases[0]));
+
+    make_inputs();
+    printf("Math benchmark, %d ops per case (ns/op, speedup over scalar, max difference from scalar):\n", BENCH_OPS);
+
+    for (int c = 0; c < case_count; c++) {
+        const BenchCase* bench = &cases[c];
+        double scalar_ns = 0.0;
+        printf("  %-24s", bench->name);
+
+        for (int b = 0; b < (int)(sizeof(backends) / sizeof(backends[0])); b++) {
+            if (!math_set_backend(backends[b])) continue;
+            double ns = time_case(bench->func);
+
+            if (backends[b] == MATH_BACKEND_SCALAR) {
+                scalar_ns = ns;
+                memcpy(reference, results, sizeof(results));
+                memcpy(point_reference, point_results, sizeof(point_results));
+                printf(" %s %7.2f", math_backend_name(backends[b]), ns);
+            }
+            else {
+                float error = bench->outputs_points
+                    ? max_difference(&point_results[0].x, &point_reference[0].x, BENCH_POINTS * 3)
+                    : max_difference(results, reference, BENCH_MATRICES * 16);
+                printf(" | %s %7.2f (%.2fx, %.1e)", math_backend_name(backends[b]), ns, scalar_ns / ns, error);
+            }
+        }
+        printf("\n");
+    }
+
+    // The normal matrix path from the render loop against the generic
+    // route, with whatever backend math_init picked
+    math_set_backend(previous);
+    double full_ns = time_case(case_inverse_transpose);
+    for (int i = 0; i < BENCH_MATRICES; i++) {
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) normal_reference[i * 9 + col * 3 + row] = results[i * 16 + col * 4 + row];
+        }
+    }
+    double normal_ns = time_case(case_normal_matrix);
+    float error = 0.0f;
+    for (int i = 0; i < BENCH_MATRICES; i++) {
+        float e = max_difference(results + i * 16, normal_reference + i * 9, 9);
+        if (e > error) error = e;
+    }
+    printf("  %-24s        %7.2f | %s inverse + transpose %7.2f (%.2fx, %.1e)\n",
+        "mat3_normal_matrix", normal_ns, math_backend_name(previous), full_ns, full_ns / normal_ns, error);
+}
+
+//-------------------------------------------------------------//
+//                      Transform kernel                        //
+//-------------------------------------------------------------//
+#define BENCH_TRANSFORM_OBJECTS 4000000 // per row, spread over repetitions
+
+typedef enum { RUN_SCALAR, RUN_SIMD, RUN_PARALLEL } TransformRun;
+
+static double time_transforms(const Transforms* transforms, float* models, float* normals, TransformRun run) {
+    int reps = BENCH_TRANSFORM_OBJECTS / transforms->count;
+    if (reps < 1) reps = 1;
+
+    // One untimed pass so first-touch page faults on the outputs are not counted
+    transforms_compute_range(transforms, models, normals, 0, transforms->count);
+    double start = platform_time_seconds();
+    for (int r = 0; r < reps; r++) {
+        if (run == RUN_PARALLEL) transforms_compute(transforms, models, normals);
+        else transforms_compute_range(transforms, models, normals, 0, transforms->count);
+    }
+    return (platform_time_seconds() - start) * 1e9 / ((double)reps * transforms->count);
+}
+
+void bench_transforms(void) {
+    static const int counts[] = { 1000, 10000, 100000, 1000000 };
+    MathBackend simd = math_get_backend();
+
+    parallel_init(0);
+    printf("Transform kernel, model + normal matrices (ns/object, %d threads, max difference from scalar):\n",
+        parallel_thread_count());
+
+    for (int c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++) {
+        int count = counts[c];
+        Transforms transforms;
+        transforms_init(&transforms);
+        float* models = malloc((size_t)count * 16 * sizeof(float));
+        float* normals = malloc((size_t)count * 9 * sizeof(float));
+        float* scalar_models = malloc((size_t)count * 16 * sizeof(float));
+        float* scalar_normals = malloc((size_t)count * 9 * sizeof(float));
+        if (!models || !normals || !scalar_models || !scalar_normals || !transforms_reserve(&transforms, count)) {
+            printf("WARNING: Out of memory for %d transforms\n", count);
+            free(models);
+            free(normals);
+            free(scalar_models);
+            free(scalar_normals);
+            transforms_free(&transforms);
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            Vec3 t = { random_float(-50, 50), random_float(-50, 50), random_float(-50, 50) };
+            Vec3 axis = { random_float(-1, 1), random_float(-1, 1), random_float(-1, 1) };
+            vec3_normalize(&axis);
+            Vec3 s = { random_float(0.5f, 2), random_float(0.5f, 2), random_float(0.5f, 2) };
+            transforms_push(&transforms, t, quat_from_axis_angle(axis, random_float(0, 6.28f)), s);
+        }
+
+        math_set_backend(MATH_BACKEND_SCALAR);
+        double scalar_ns = time_transforms(&transforms, scalar_models, scalar_normals, RUN_SCALAR);
+        math_set_backend(simd);
+        double simd_ns = time_transforms(&transforms, models, normals, RUN_SIMD);
+        double parallel_ns = time_transforms(&transforms, models, normals, RUN_PARALLEL);
+
+        float error = max_difference(models, scalar_models, count * 16);
+        float normal_error = max_difference(normals, scalar_normals, count * 9);
+        if (normal_error > error) error = normal_error;
+
+        printf("  %8d objects: scalar %6.2f | %s %6.2f (%.2fx) | %s threaded %6.2f (%.2fx, %.1e)\n",
+            count, scalar_ns, math_backend_name(simd), simd_ns, scalar_ns / simd_ns,
+            math_backend_name(simd), parallel_ns, scalar_ns / parallel_ns, error);
+
+        free(models);
+        free(normals);
+        free(scalar_models);
+        free(scalar_normals);
+        transforms_free(&transforms);
+    }
+    parallel_shutdown();
+}
+
+//-------------------------------------------------------------//
+//                             BVH                              //
+//-------------------------------------------------------------//
+#define BENCH_BVH_RAYS 100000
+#define BENCH_BVH_CHECKED_RAYS 200 // also traced by brute force
+#define BENCH_BVH_FRUSTUMS 1000
+#define BENCH_BVH_RAY_TASKS 64
+
+typedef struct {
+    const Bvh* bvh;
+    const Vec3* origins;
+    const Vec3* directions;
+    BvhHit* hits;
+    int* found;
+} RayJob;
+
+static void trace_rays(const RayJob* job, int first, int count) {
+    for (int i = first; i < first + count; i++) {
+        job->found[i] = bvh_intersect_ray(job->bvh, job->origins[i], job->directions[i], FLT_MAX, &job->hits[i]);
+    }
+}
+
+static void ray_task(void* user, int index) {
+    int per_task = (BENCH_BVH_RAYS + BENCH_BVH_RAY_TASKS - 1) / BENCH_BVH_RAY_TASKS;
+    int first = index * per_task;
+    int count = first + per_task > BENCH_BVH_RAYS ? BENCH_BVH_RAYS - first : per_task;
+    if (count > 0) trace_rays(user, first, count);
+}
+
+// Closest hit over every triangle of a one-leaf tree, as the reference
+static int brute_force_ray(const Bvh* bvh, Vec3 origin, Vec3 direction, BvhHit* hit) {
+    BvhNode leaf = bvh->nodes[0];
+    leaf.first = 0;
+    leaf.count = bvh->mesh.triangle_count;
+    Bvh flat = *bvh;
+    flat.nodes = &leaf;
+    flat.node_count = 1;
+    flat.depth = 1;
+    unsigned int* identity = malloc(sizeof(unsigned int) * leaf.count);
+    if (!identity) return -1;
+    for (unsigned int t = 0; t < leaf.count; t++) identity[t] = t;
+    flat.triangles = identity;
+    int found = bvh_intersect_ray(&flat, origin, direction, FLT_MAX, hit);
+    free(identity);
+    return found;
+}
+
+// A ray from a random point on a sphere around the mesh toward a random
+// point inside its bounds, so most rays hit something
+static void random_ray(const Bounds* bounds, Vec3* origin, Vec3* direction) {
+    Vec3 out = { random_float(-1, 1), random_float(-1, 1), random_float(-1, 1) };
+    vec3_normalize(&out);
+    float distance = bounds->radius * 2.0f + 1.0f;
+    origin->x = bounds->center.x + out.x * distance;
+    origin->y = bounds->center.y + out.y * distance;
+    origin->z = bounds->center.z + out.z * distance;
+    Vec3 target = {
+        random_float(bounds->min.x, bounds->max.x),
+        random_float(bounds->min.y, bounds->max.y),
+        random_float(bounds->min.z, bounds->max.z)
+    };
+    vec3_sub(direction, target, *origin);
+    vec3_normalize(direction);
+}
+
+void bench_bvh(const char* obj_path) {
+    parallel_init(0);
+    Mesh mesh;
+    mesh_init(&mesh);
+    if (!load_obj_parallel(obj_path, &mesh)) {
+        parallel_shutdown();
+        return;
+    }
+    BvhMesh view = bvh_mesh_from_mesh(&mesh);
+    printf("BVH over %s: %u triangles, %d threads\n", obj_path, view.triangle_count, parallel_thread_count());
+
+    Bvh bvh;
+    double start = platform_time_seconds();
+    int built = bvh_build(&bvh, &view, 0);
+    double serial_ms = (platform_time_seconds() - start) * 1000.0;
+    if (built) {
+        bvh_free(&bvh);
+        start = platform_time_seconds();
+        built = bvh_build(&bvh, &view, 1);
+    }
+    double threaded_ms = (platform_time_seconds() - start) * 1000.0;
+    if (!built) {
+        mesh_free(&mesh);
+        parallel_shutdown();
+        return;
+    }
+    size_t bytes = sizeof(BvhNode) * bvh.node_count + sizeof(unsigned int) * view.triangle_count;
+    printf("  build: serial %.1f ms | threaded %.1f ms (%.2fx)\n", serial_ms, threaded_ms, serial_ms / threaded_ms);
+    printf("  tree: %u nodes, %u leaves, depth %u, %.2f triangles/leaf, SAH cost %.1f, %.2f MB\n",
+        bvh.node_count, bvh.leaf_count, bvh.depth, (double)view.triangle_count / bvh.leaf_count,
+        bvh_sah_cost(&bvh), bytes / (1024.0 * 1024.0));
+
+    // Rays
+    Vec3* origins = malloc(sizeof(Vec3) * BENCH_BVH_RAYS);
+    Vec3* directions = malloc(sizeof(Vec3) * BENCH_BVH_RAYS);
+    BvhHit* hits = malloc(sizeof(BvhHit) * BENCH_BVH_RAYS);
+    int* found = malloc(sizeof(int) * BENCH_BVH_RAYS);
+    if (origins && directions && hits && found) {
+        for (int i = 0; i < BENCH_BVH_RAYS; i++) random_ray(&mesh.bounds, &origins[i], &directions[i]);
+        RayJob job = { &bvh, origins, directions, hits, found };
+
+        start = platform_time_seconds();
+        trace_rays(&job, 0, BENCH_BVH_RAYS);
+        double single_s = platform_time_seconds() - start;
+        start = platform_time_seconds();
+        parallel_for(BENCH_BVH_RAY_TASKS, ray_task, &job);
+        double threaded_s = platform_time_seconds() - start;
+
+        int hit_count = 0;
+        for (int i = 0; i < BENCH_BVH_RAYS; i++) hit_count += found[i];
+
+        int mismatches = 0;
+        for (int i = 0; i < BENCH_BVH_CHECKED_RAYS; i++) {
+            BvhHit reference_hit;
+            int reference_found = brute_force_ray(&bvh, origins[i], directions[i], &reference_hit);
+            if (reference_found != found[i] ||
+                (found[i] && fabsf(reference_hit.t - hits[i].t) > 1e-4f * (1.0f + reference_hit.t))) {
+                mismatches++;
+            }
+        }
+        printf("  rays: %.2f Mrays/s | threaded %.2f Mrays/s | %.1f%% hit | %d/%d differ from brute force\n",
+            BENCH_BVH_RAYS / single_s * 1e-6, BENCH_BVH_RAYS / threaded_s * 1e-6,
+            100.0 * hit_count / BENCH_BVH_RAYS, mismatches, BENCH_BVH_CHECKED_RAYS);
+    }
+    else {
+        printf("WARNING: Out of memory for the BVH ray test\n");
+    }
+    free(origins);
+    free(directions);
+    free(hits);
+    free(found);
+
+    // Frustums: cameras on a sphere around the mesh looking at random points in it
+    unsigned long long visible = 0;
+    double frustum_s = 0.0;
+    for (int i = 0; i < BENCH_BVH_FRUSTUMS; i++) {
+        Vec3 eye, direction;
+        random_ray(&mesh.bounds, &eye, &direction);
+        Vec3 target = { eye.x + direction.x, eye.y + direction.y, eye.z + direction.z };
+        Vec3 up = { 0.0f, 1.0f, 0.0f };
+        if (fabsf(direction.y) > 0.99f) up = (Vec3){ 1.0f, 0.0f, 0.0f };
+        float projection[16], view_matrix[16], view_projection[16];
+        mat4_perspective(projection, random_float(20.0f, 60.0f), 16.0f / 9.0f, 0.1f, mesh.bounds.radius * 4.0f + 2.0f);
+        mat4_lookat(view_matrix, eye, target, up);
+        mat4_multiply(view_projection, projection, view_matrix);
+        Frustum query;
+        frustum_from_matrix(&query, view_projection);
+
+        start = platform_time_seconds();
+        visible += bvh_query_frustum(&bvh, &query, NULL, NULL);
+        frustum_s += platform_time_seconds() - start;
+    }
+    printf("  frustum: %.2f us/query | %.1f%% of triangles in visited leaves\n",
+        frustum_s * 1e6 / BENCH_BVH_FRUSTUMS, 100.0 * visible / ((double)BENCH_BVH_FRUSTUMS * view.triangle_count));
+
+    bvh_free(&bvh);
+    mesh_free(&mesh);
+    parallel_shutdown();
+}
+
+//-------------------------------------------------------------//
+//                          OBJ parsing                         //
+//-------------------------------------------------------------//
+static int same_array(const void* a, const void* b, size_t bytes) {
+    return bytes == 0 || memcmp(a, b, bytes) == 0;
+}
+
+void bench_obj(const char* obj_path) {
+    parallel_init(0);
+    Mesh serial, threaded;
+    mesh_init(&serial);
+    mesh_init(&threaded);
+
+    double start = platform_time_seconds();
+    int ok = load_obj(obj_path, &serial);
+    double serial_ms = (platform_time_seconds() - start) * 1000.0;
+    start = platform_time_seconds();
+    ok = ok && load_obj_parallel(obj_path, &threaded);
+    double threaded_ms = (platform_time_seconds() - start) * 1000.0;
+
+    if (ok) {
+        int same = serial.vertex_count == threaded.vertex_count && serial.normal_count == threaded.normal_count &&
+            serial.face_count == threaded.face_count &&
+            same_array(serial.vertices, threaded.vertices, sizeof(Vec3) * (size_t)serial.vertex_count) &&
+            same_array(serial.normals, threaded.normals, sizeof(Vec3) * (size_t)serial.normal_count) &&
+            same_array(serial.faces, threaded.faces, sizeof(Face) * (size_t)serial.face_count);
+        printf("OBJ parse of %s: serial %.1f ms | %d threads %.1f ms (%.2fx), meshes %s\n", obj_path,
+            serial_ms, parallel_thread_count(), threaded_ms, serial_ms / threaded_ms, same ? "identical" : "DIFFERENT");
+    }
+    mesh_free(&serial);
+    mesh_free(&threaded);
+    parallel_shutdown();
+}
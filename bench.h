@@ -0,0 +1,27 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+//-------------------------------------------------------------//
+//                     Headless benchmarks                      //
+//-------------------------------------------------------------//
+// CPU-only timing runs selected from the command line. None of them
+// need a window or a GL context; results are printed as a table.
+
+// Every math3d backend the CPU supports against the scalar one, plus
+// the normal matrix helper against a full inverse and transpose
+void bench_math(void);
+
+// The SoA transform kernel at several object counts: scalar, SIMD on
+// one thread and SIMD across the thread pool
+void bench_transforms(void);
+
+// BVH over the triangles of an OBJ file: serial and threaded build
+// times, tree statistics, ray throughput checked against brute force,
+// and frustum queries from random cameras
+void bench_bvh(const char* obj_path);
+
+// The serial and the chunked parallel OBJ parser on the same file:
+// load times, and a check that both produce the same mesh
+void bench_obj(const char* obj_path);
+
+#endif
@@ -0,0 +1,786 @@
+#include "bvh.h"
+#include "parallel.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BVH_BINS 16
+#define BVH_MAX_LEAF 8            // larger leaves are always split
+#define BVH_TRAVERSAL_COST 1.0f   // relative to one triangle test
+#define BVH_TASK_TRIANGLES 65536  // per binning task at the top levels
+#define BVH_QUERY_STACK 64        // deeper trees fall back to a heap stack
+
+//-------------------------------------------------------------//
+//                        Mesh views                            //
+//-------------------------------------------------------------//
+BvhMesh bvh_mesh_from_mesh(const Mesh* mesh) {
+    BvhMesh view;
+    view.positions = mesh->vertex_count > 0 ? &mesh->vertices[0].x : NULL;
+    view.position_stride = sizeof(Vec3) / sizeof(float);
+    view.indices = mesh->face_count > 0 ? mesh->faces[0].v_idx : NULL;
+    view.index_stride = sizeof(Face) / sizeof(unsigned int);
+    view.triangle_count = (unsigned int)mesh->face_count;
+    return view;
+}
+
+BvhMesh bvh_mesh_from_indexed(const IndexedMesh* mesh) {
+    BvhMesh view;
+    view.positions = mesh->vertices;
+    view.position_stride = INDEXED_VERTEX_FLOATS;
+    view.indices = mesh->indices;
+    view.index_stride = 3;
+    view.triangle_count = mesh->index_count / 3;
+    return view;
+}
+
+static void triangle_corners(const BvhMesh* mesh, unsigned int triangle, const float* corners[3]) {
+    const unsigned int* index = mesh->indices + (size_t)triangle * mesh->index_stride;
+    for (int k = 0; k < 3; k++) corners[k] = mesh->positions + (size_t)index[k] * mesh->position_stride;
+}
+
+//-------------------------------------------------------------//
+//                           Boxes                              //
+//-------------------------------------------------------------//
+typedef struct {
+    float min[3], max[3];
+} Box;
+
+static void box_empty(Box* box) {
+    for (int k = 0; k < 3; k++) {
+        box->min[k] = FLT_MAX;
+        box->max[k] = -FLT_MAX;
+    }
+}
+
+static void box_grow_point(Box* box, const float* p) {
+    for (int k = 0; k < 3; k++) {
+        if (p[k] < box->min[k]) box->min[k] = p[k];
+        if (p[k] > box->max[k]) box->max[k] = p[k];
+    }
+}
+
+static void box_grow_box(Box* box, const Box* other) {
+    for (int k = 0; k < 3; k++) {
+        if (other->min[k] < box->min[k]) box->min[k] = other->min[k];
+        if (other->max[k] > box->max[k]) box->max[k] = other->max[k];
+    }
+}
+
+static float box_area(const Box* box) {
+    float dx = box->max[0] - box->min[0];
+    float dy = box->max[1] - box->min[1];
+    float dz = box->max[2] - box->min[2];
+    if (dx < 0.0f || dy < 0.0f || dz < 0.0f) return 0.0f;
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+//-------------------------------------------------------------//
+//                          Builder                             //
+//-------------------------------------------------------------//
+typedef struct {
+    Box bounds;
+    unsigned int count;
+} Bin;
+
+typedef struct {
+    const BvhMesh* mesh;
+    Box* triangle_bounds;   // per source triangle
+    float* centroids;       // 3 per source triangle
+    unsigned int* order;    // partitioned in place, becomes Bvh.triangles
+} Builder;
+
+typedef struct {
+    BvhNode* nodes;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int leaves;
+    unsigned int depth;
+} NodeList;
+
+static unsigned int push_node(NodeList* list) {
+    if (list->count == list->capacity) {
+        unsigned int capacity = list->capacity ? list->capacity * 2 : 256;
+        BvhNode* grown = realloc(list->nodes, (size_t)capacity * sizeof(BvhNode));
+        if (!grown) return UINT_MAX;
+        list->nodes = grown;
+        list->capacity = capacity;
+    }
+    memset(&list->nodes[list->count], 0, sizeof(BvhNode));
+    return list->count++;
+}
+
+//---------------------- Range passes -------------------------//
+// Bounds of the triangles and of their centroids over order[first, first + count)
+static void range_bounds(const Builder* builder, unsigned int first, unsigned int count, Box* bounds, Box* centroid_bounds) {
+    box_empty(bounds);
+    box_empty(centroid_bounds);
+    for (unsigned int i = first; i < first + count; i++) {
+        unsigned int triangle = builder->order[i];
+        box_grow_box(bounds, &builder->triangle_bounds[triangle]);
+        box_grow_point(centroid_bounds, &builder->centroids[(size_t)triangle * 3]);
+    }
+}
+
+static int bin_index(const float* centroid, int axis, const Box* centroid_bounds, float scale) {
+    int bin = (int)((centroid[axis] - centroid_bounds->min[axis]) * scale);
+    if (bin < 0) bin = 0;
+    if (bin > BVH_BINS - 1) bin = BVH_BINS - 1;
+    return bin;
+}
+
+static void bin_scales(const Box* centroid_bounds, float scale[3]) {
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centroid_bounds->max[axis] - centroid_bounds->min[axis];
+        scale[axis] = extent > 0.0f ? (float)BVH_BINS / extent : 0.0f;
+    }
+}
+
+static void range_bins(const Builder* builder, unsigned int first, unsigned int count, const Box* centroid_bounds, Bin bins[3][BVH_BINS]) {
+    float scale[3];
+    bin_scales(centroid_bounds, scale);
+    for (int axis = 0; axis < 3; axis++) {
+        for (int b = 0; b < BVH_BINS; b++) {
+            box_empty(&bins[axis][b].bounds);
+            bins[axis][b].count = 0;
+        }
+    }
+    for (unsigned int i = first; i < first + count; i++) {
+        unsigned int triangle = builder->order[i];
+        const float* centroid = &builder->centroids[(size_t)triangle * 3];
+        for (int axis = 0; axis < 3; axis++) {
+            if (scale[axis] == 0.0f) continue;
+            Bin* bin = &bins[axis][bin_index(centroid, axis, centroid_bounds, scale[axis])];
+            box_grow_box(&bin->bounds, &builder->triangle_bounds[triangle]);
+            bin->count++;
+        }
+    }
+}
+
+//-------------------- Threaded range passes ------------------//
+// The same two passes split over the pool, each task filling its own
+// partial result that is merged afterwards
+typedef struct {
+    const Builder* builder;
+    unsigned int first;
+    unsigned int count;
+    Box centroid_bounds;            // input of the binning pass
+    Box* task_bounds;               // 2 per task: bounds, centroid bounds
+    Bin (*task_bins)[3][BVH_BINS];
+} RangeJob;
+
+static void task_range(const RangeJob* job, int index, unsigned int* first, unsigned int* count) {
+    *first = job->first + (unsigned int)index * BVH_TASK_TRIANGLES;
+    unsigned int end = job->first + job->count;
+    *count = end - *first < BVH_TASK_TRIANGLES ? end - *first : BVH_TASK_TRIANGLES;
+}
+
+static void bounds_task(void* user, int index) {
+    RangeJob* job = user;
+    unsigned int first, count;
+    task_range(job, index, &first, &count);
+    range_bounds(job->builder, first, count, &job->task_bounds[index * 2], &job->task_bounds[index * 2 + 1]);
+}
+
+static void bins_task(void* user, int index) {
+    RangeJob* job = user;
+    unsigned int first, count;
+    task_range(job, index, &first, &count);
+    range_bins(job->builder, first, count, &job->centroid_bounds, job->task_bins[index]);
+}
+
+// Falls back to the serial passes when the scratch cannot be allocated
+static void range_bounds_threaded(const Builder* builder, unsigned int first, unsigned int count, Box* bounds, Box* centroid_bounds) {
+    int tasks = (int)((count + BVH_TASK_TRIANGLES - 1) / BVH_TASK_TRIANGLES);
+    RangeJob job;
+    memset(&job, 0, sizeof(job));
+    job.builder = builder;
+    job.first = first;
+    job.count = count;
+    job.task_bounds = malloc(sizeof(Box) * 2 * (size_t)tasks);
+    if (!job.task_bounds) {
+        range_bounds(builder, first, count, bounds, centroid_bounds);
+        return;
+    }
+    parallel_for(tasks, bounds_task, &job);
+    box_empty(bounds);
+    box_empty(centroid_bounds);
+    for (int t = 0; t < tasks; t++) {
+        box_grow_box(bounds, &job.task_bounds[t * 2]);
+        box_grow_box(centroid_bounds, &job.task_bounds[t * 2 + 1]);
+    }
+    free(job.task_bounds);
+}
+
+static void range_bins_threaded(const Builder* builder, unsigned int first, unsigned int count, const Box* centroid_bounds, Bin bins[3][BVH_BINS]) {
+    int tasks = (int)((count + BVH_TASK_TRIANGLES - 1) / BVH_TASK_TRIANGLES);
+    RangeJob job;
+    memset(&job, 0, sizeof(job));
+    job.builder = builder;
+    job.first = first;
+    job.count = count;
+    job.centroid_bounds = *centroid_bounds;
+    job.task_bins = malloc(sizeof(*job.task_bins) * (size_t)tasks);
+    if (!job.task_bins) {
+        range_bins(builder, first, count, centroid_bounds, bins);
+        return;
+    }
+    parallel_for(tasks, bins_task, &job);
+    memcpy(bins, job.task_bins[0], sizeof(*job.task_bins));
+    for (int t = 1; t < tasks; t++) {
+        for (int axis = 0; axis < 3; axis++) {
+            for (int b = 0; b < BVH_BINS; b++) {
+                box_grow_box(&bins[axis][b].bounds, &job.task_bins[t][axis][b].bounds);
+                bins[axis][b].count += job.task_bins[t][axis][b].count;
+            }
+        }
+    }
+    free(job.task_bins);
+}
+
+//------------------------ Splitting --------------------------//
+// Picks the cheapest of the BVH_BINS - 1 planes per axis and partitions
+// the range around it. Returns the size of the left half, or 0 when the
+// node should stay a leaf.
+static unsigned int split_range(Builder* builder, unsigned int first, unsigned int count,
+    const Box* bounds, const Box* centroid_bounds, int threaded) {
+    if (count <= 1) return 0;
+
+    Bin bins[3][BVH_BINS];
+    if (threaded) range_bins_threaded(builder, first, count, centroid_bounds, bins);
+    else range_bins(builder, first, count, centroid_bounds, bins);
+
+    float scale[3];
+    bin_scales(centroid_bounds, scale);
+
+    int best_axis = -1;
+    int best_bin = 0;
+    float best_cost = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++) {
+        if (scale[axis] == 0.0f) continue;
+
+        // Sweep from the right to get every right-hand area and count
+        float right_area[BVH_BINS];
+        unsigned int right_count[BVH_BINS];
+        Box right;
+        box_empty(&right);
+        unsigned int running = 0;
+        for (int b = BVH_BINS - 1; b > 0; b--) {
+            box_grow_box(&right, &bins[axis][b].bounds);
+            running += bins[axis][b].count;
+            right_area[b] = box_area(&right);
+            right_count[b] = running;
+        }
+
+        Box left;
+        box_empty(&left);
+        running = 0;
+        for (int b = 0; b < BVH_BINS - 1; b++) {
+            box_grow_box(&left, &bins[axis][b].bounds);
+            running += bins[axis][b].count;
+            if (running == 0 || right_count[b + 1] == 0) continue;
+            float cost = box_area(&left) * running + right_area[b + 1] * right_count[b + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = b;
+            }
+        }
+    }
+
+    float area = box_area(bounds);
+    if (best_axis < 0) {
+        // Every centroid in one spot: no plane separates them
+        if (count <= BVH_MAX_LEAF) return 0;
+        return count / 2;
+    }
+    float split_cost = BVH_TRAVERSAL_COST + (area > 0.0f ? best_cost / area : (float)count);
+    if (split_cost >= (float)count && count <= BVH_MAX_LEAF) return 0;
+
+    // In-place partition of the triangle order
+    unsigned int* order = builder->order;
+    unsigned int i = first;
+    unsigned int j = first + count;
+    while (i < j) {
+        const float* centroid = &builder->centroids[(size_t)order[i] * 3];
+        if (bin_index(centroid, best_axis, centroid_bounds, scale[best_axis]) <= best_bin) {
+            i++;
+        }
+        else {
+            j--;
+            unsigned int swap = order[i];
+            order[i] = order[j];
+            order[j] = swap;
+        }
+    }
+    unsigned int left_count = i - first;
+    if (left_count == 0 || left_count == count) return count / 2; // float edge cases at bin borders
+    return left_count;
+}
+
+//------------------------- Subtrees --------------------------//
+typedef struct {
+    unsigned int node;
+    unsigned int first;
+    unsigned int count;
+    unsigned int depth;
+} BuildItem;
+
+// Builds the tree over order[first, first + count) into `list`, root
+// first. Returns 0 when out of memory.
+static int build_subtree(Builder* builder, NodeList* list, unsigned int first, unsigned int count) {
+    unsigned int stack_capacity = 64;
+    unsigned int stack_size = 0;
+    BuildItem* stack = malloc(sizeof(BuildItem) * stack_capacity);
+    unsigned int root = push_node(list);
+    if (!stack || root == UINT_MAX) {
+        free(stack);
+        return 0;
+    }
+    BuildItem start = { root, first, count, 1 };
+    stack[stack_size++] = start;
+
+    while (stack_size > 0) {
+        BuildItem item = stack[--stack_size];
+        if (item.depth > list->depth) list->depth = item.depth;
+
+        Box bounds, centroid_bounds;
+        range_bounds(builder, item.first, item.count, &bounds, &centroid_bounds);
+        memcpy(list->nodes[item.node].bounds_min, bounds.min, sizeof(bounds.min));
+        memcpy(list->nodes[item.node].bounds_max, bounds.max, sizeof(bounds.max));
+
+        unsigned int left_count = split_range(builder, item.first, item.count, &bounds, &centroid_bounds, 0);
+        if (left_count == 0) {
+            list->nodes[item.node].first = item.first;
+            list->nodes[item.node].count = item.count;
+            list->leaves++;
+            continue;
+        }
+
+        unsigned int left = push_node(list);
+        unsigned int right = push_node(list);
+        if (left == UINT_MAX || right == UINT_MAX) {
+            free(stack);
+            return 0;
+        }
+        list->nodes[item.node].first = left;
+        list->nodes[item.node].count = 0;
+
+        if (stack_size + 2 > stack_capacity) {
+            stack_capacity *= 2;
+            BuildItem* grown = realloc(stack, sizeof(BuildItem) * stack_capacity);
+            if (!grown) {
+                free(stack);
+                return 0;
+            }
+            stack = grown;
+        }
+        BuildItem right_item = { right, item.first + left_count, item.count - left_count, item.depth + 1 };
+        BuildItem left_item = { left, item.first, left_count, item.depth + 1 };
+        stack[stack_size++] = right_item;
+        stack[stack_size++] = left_item;
+    }
+    free(stack);
+    return 1;
+}
+
+typedef struct {
+    Builder* builder;
+    BuildItem* items;
+    NodeList* lists;
+    int* ok;
+} SubtreeJob;
+
+static void subtree_task(void* user, int index) {
+    SubtreeJob* job = user;
+    job->ok[index] = build_subtree(job->builder, &job->lists[index], job->items[index].first, job->items[index].count);
+}
+
+// Splits the top of the tree serially, with threaded binning, until
+// every open node is small enough to be one subtree task, then builds
+// the subtrees in parallel and appends them to `list`
+static int build_threaded(Builder* builder, NodeList* list, unsigned int triangle_count) {
+    unsigned int threshold = triangle_count / (unsigned int)(parallel_thread_count() * 4);
+    if (threshold < BVH_TASK_TRIANGLES) threshold = BVH_TASK_TRIANGLES;
+
+    unsigned int capacity = 64;
+    unsigned int open_count = 0, task_count = 0;
+    BuildItem* open = malloc(sizeof(BuildItem) * capacity);
+    BuildItem* tasks = malloc(sizeof(BuildItem) * capacity);
+    unsigned int root = push_node(list);
+    int ok = open && tasks && root != UINT_MAX;
+    if (ok) {
+        BuildItem start = { root, 0, triangle_count, 1 };
+        open[open_count++] = start;
+    }
+
+    while (ok && open_count > 0) {
+        BuildItem item = open[--open_count];
+        if (item.count <= threshold) {
+            tasks[task_count++] = item;
+            continue;
+        }
+        if (item.depth > list->depth) list->depth = item.depth;
+
+        Box bounds, centroid_bounds;
+        range_bounds_threaded(builder, item.first, item.count, &bounds, &centroid_bounds);
+        memcpy(list->nodes[item.node].bounds_min, bounds.min, sizeof(bounds.min));
+        memcpy(list->nodes[item.node].bounds_max, bounds.max, sizeof(bounds.max));
+
+        unsigned int left_count = split_range(builder, item.first, item.count, &bounds, &centroid_bounds, 1);
+        if (left_count == 0) {
+            list->nodes[item.node].first = item.first;
+            list->nodes[item.node].count = item.count;
+            list->leaves++;
+            continue;
+        }
+
+        unsigned int left = push_node(list);
+        unsigned int right = push_node(list);
+        if (left == UINT_MAX || right == UINT_MAX) {
+            ok = 0;
+            break;
+        }
+        list->nodes[item.node].first = left;
+
+        // Every open node ends up as at most one task, so both lists
+        // need the same room
+        if (open_count + 2 > capacity || task_count + open_count + 2 > capacity) {
+            capacity *= 2;
+            BuildItem* grown_open = realloc(open, sizeof(BuildItem) * capacity);
+            if (grown_open) open = grown_open;
+            BuildItem* grown_tasks = realloc(tasks, sizeof(BuildItem) * capacity);
+            if (grown_tasks) tasks = grown_tasks;
+            if (!grown_open || !grown_tasks) {
+                ok = 0;
+                break;
+            }
+        }
+        BuildItem right_item = { right, item.first + left_count, item.count - left_count, item.depth + 1 };
+        BuildItem left_item = { left, item.first, left_count, item.depth + 1 };
+        open[open_count++] = right_item;
+        open[open_count++] = left_item;
+    }
+
+    NodeList* lists = ok ? calloc(task_count ? task_count : 1, sizeof(NodeList)) : NULL;
+    int* task_ok = ok ? calloc(task_count ? task_count : 1, sizeof(int)) : NULL;
+    ok = ok && lists && task_ok;
+    if (ok) {
+        SubtreeJob job = { builder, tasks, lists, task_ok };
+        parallel_for((int)task_count, subtree_task, &job);
+
+        // Stitch: each local root replaces its placeholder, the rest is
+        // appended with child indices shifted past the nodes already there
+        for (unsigned int t = 0; t < task_count && ok; t++) {
+            NodeList* local = &lists[t];
+            ok = task_ok[t];
+            if (!ok) break;
+
+            unsigned int base = list->count;
+            for (unsigned int n = 1; n < local->count && ok; n++) ok = push_node(list) != UINT_MAX;
+            if (!ok) break;
+            for (unsigned int n = 0; n < local->count; n++) {
+                BvhNode node = local->nodes[n];
+                if (node.count == 0) node.first = base + node.first - 1;
+                if (n == 0) list->nodes[tasks[t].node] = node;
+                else list->nodes[base + n - 1] = node;
+            }
+            list->leaves += local->leaves;
+            if (tasks[t].depth - 1 + local->depth > list->depth) list->depth = tasks[t].depth - 1 + local->depth;
+        }
+    }
+
+    if (lists) {
+        for (unsigned int t = 0; t < task_count; t++) free(lists[t].nodes);
+    }
+    free(lists);
+    free(task_ok);
+    free(open);
+    free(tasks);
+    return ok;
+}
+
+//-------------------------------------------------------------//
+//                          Lifetime                            //
+//-------------------------------------------------------------//
+typedef struct {
+    Builder* builder;
+    unsigned int triangle_count;
+} PrepareJob;
+
+static void prepare_task(void* user, int index) {
+    PrepareJob* job = user;
+    Builder* builder = job->builder;
+    unsigned int first = (unsigned int)index * BVH_TASK_TRIANGLES;
+    unsigned int end = first + BVH_TASK_TRIANGLES < job->triangle_count ? first + BVH_TASK_TRIANGLES : job->triangle_count;
+    for (unsigned int t = first; t < end; t++) {
+        const float* corners[3];
+        triangle_corners(builder->mesh, t, corners);
+        Box* box = &builder->triangle_bounds[t];
+        box_empty(box);
+        for (int k = 0; k < 3; k++) box_grow_point(box, corners[k]);
+        for (int k = 0; k < 3; k++) builder->centroids[(size_t)t * 3 + k] = (box->min[k] + box->max[k]) * 0.5f;
+        builder->order[t] = t;
+    }
+}
+
+int bvh_build(Bvh* bvh, const BvhMesh* mesh, int threaded) {
+    memset(bvh, 0, sizeof(*bvh));
+    bvh->mesh = *mesh;
+    unsigned int triangle_count = mesh->triangle_count;
+    if (triangle_count == 0) {
+        printf("WARNING: BVH over an empty mesh\n");
+        return 0;
+    }
+
+    Builder builder;
+    builder.mesh = mesh;
+    builder.triangle_bounds = malloc(sizeof(Box) * triangle_count);
+    builder.centroids = malloc(sizeof(float) * 3 * triangle_count);
+    builder.order = malloc(sizeof(unsigned int) * triangle_count);
+    NodeList list;
+    memset(&list, 0, sizeof(list));
+
+    int ok = builder.triangle_bounds && builder.centroids && builder.order;
+    if (ok) {
+        int tasks = (int)((triangle_count + BVH_TASK_TRIANGLES - 1) / BVH_TASK_TRIANGLES);
+        PrepareJob job = { &builder, triangle_count };
+        if (threaded) {
+            parallel_for(tasks, prepare_task, &job);
+        }
+        else {
+            for (int t = 0; t < tasks; t++) prepare_task(&job, t);
+        }
+
+        if (threaded && parallel_thread_count() > 1 && triangle_count > 2 * BVH_TASK_TRIANGLES) {
+            ok = build_threaded(&builder, &list, triangle_count);
+        }
+        else {
+            ok = build_subtree(&builder, &list, 0, triangle_count);
+        }
+    }
+
+    free(builder.triangle_bounds);
+    free(builder.centroids);
+    if (!ok) {
+        printf("FATAL ERROR: Out of memory while building a BVH over %u triangles\n", triangle_count);
+        free(builder.order);
+        free(list.nodes);
+        memset(bvh, 0, sizeof(*bvh));
+        return 0;
+    }
+
+    // Drop the growth slack; a failed shrink keeps the larger block
+    BvhNode* shrunk = realloc(list.nodes, sizeof(BvhNode) * list.count);
+    bvh->nodes = shrunk ? shrunk : list.nodes;
+    bvh->node_count = list.count;
+    bvh->leaf_count = list.leaves;
+    bvh->depth = list.depth;
+    bvh->triangles = builder.order;
+    return 1;
+}
+
+void bvh_free(Bvh* bvh) {
+    free(bvh->nodes);
+    free(bvh->triangles);
+    memset(bvh, 0, sizeof(*bvh));
+}
+
+float bvh_sah_cost(const Bvh* bvh) {
+    if (bvh->node_count == 0) return 0.0f;
+    double cost = 0.0;
+    for (unsigned int n = 0; n < bvh->node_count; n++) {
+        const BvhNode* node = &bvh->nodes[n];
+        Box box;
+        memcpy(box.min, node->bounds_min, sizeof(box.min));
+        memcpy(box.max, node->bounds_max, sizeof(box.max));
+        cost += box_area(&box) * (node->count ? (double)node->count : BVH_TRAVERSAL_COST);
+    }
+    Box root;
+    memcpy(root.min, bvh->nodes[0].bounds_min, sizeof(root.min));
+    memcpy(root.max, bvh->nodes[0].bounds_max, sizeof(root.max));
+    float root_area = box_area(&root);
+    return root_area > 0.0f ? (float)(cost / root_area) : 0.0f;
+}
+
+//-------------------------------------------------------------//
+//                          Ray query                           //
+//-------------------------------------------------------------//
+// Slab test; returns the entry distance or FLT_MAX on a miss
+static float ray_box(const BvhNode* node, const float* origin, const float* inv_direction, float max_t) {
+    float t_near = 0.0f;
+    float t_far = max_t;
+    for (int k = 0; k < 3; k++) {
+        float t0 = (node->bounds_min[k] - origin[k]) * inv_direction[k];
+        float t1 = (node->bounds_max[k] - origin[k]) * inv_direction[k];
+        if (t0 > t1) {
+            float swap = t0;
+            t0 = t1;
+            t1 = swap;
+        }
+        if (t0 > t_near) t_near = t0;
+        if (t1 < t_far) t_far = t1;
+        if (t_near > t_far) return FLT_MAX;
+    }
+    return t_near;
+}
+
+// Moller-Trumbore
+static int ray_triangle(const float* origin, const float* direction, const float* const corners[3], float max_t, BvhHit* hit) {
+    float e1[3], e2[3], s[3], p[3], q[3];
+    for (int k = 0; k < 3; k++) {
+        e1[k] = corners[1][k] - corners[0][k];
+        e2[k] = corners[2][k] - corners[0][k];
+        s[k] = origin[k] - corners[0][k];
+    }
+    p[0] = direction[1] * e2[2] - direction[2] * e2[1];
+    p[1] = direction[2] * e2[0] - direction[0] * e2[2];
+    p[2] = direction[0] * e2[1] - direction[1] * e2[0];
+    float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (fabsf(det) < 1e-12f) return 0;
+    float inv_det = 1.0f / det;
+
+    float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+    if (u < 0.0f || u > 1.0f) return 0;
+    q[0] = s[1] * e1[2] - s[2] * e1[1];
+    q[1] = s[2] * e1[0] - s[0] * e1[2];
+    q[2] = s[0] * e1[1] - s[1] * e1[0];
+    float v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inv_det;
+    if (v < 0.0f || u + v > 1.0f) return 0;
+    float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+    if (t < 0.0f || t > max_t) return 0;
+
+    hit->t = t;
+    hit->u = u;
+    hit->v = v;
+    return 1;
+}
+
+typedef struct {
+    unsigned int node;
+    float t_near;
+} RayItem;
+
+int bvh_intersect_ray(const Bvh* bvh, Vec3 origin, Vec3 direction, float max_t, BvhHit* hit) {
+    if (bvh->node_count == 0) return 0;
+
+    float o[3] = { origin.x, origin.y, origin.z };
+    float d[3] = { direction.x, direction.y, direction.z };
+    float inv[3];
+    for (int k = 0; k < 3; k++) {
+        // Zero components give infinities, which the slab test handles
+        inv[k] = d[k] != 0.0f ? 1.0f / d[k] : (signbit(d[k]) ? -FLT_MAX : FLT_MAX);
+    }
+
+    RayItem small_stack[BVH_QUERY_STACK];
+    RayItem* stack = small_stack;
+    if (bvh->depth + 1 > BVH_QUERY_STACK) {
+        stack = malloc(sizeof(RayItem) * (bvh->depth + 1));
+        if (!stack) return 0;
+    }
+
+    int found = 0;
+    float best_t = max_t;
+    unsigned int stack_size = 0;
+    float t_root = ray_box(&bvh->nodes[0], o, inv, best_t);
+    if (t_root != FLT_MAX) {
+        RayItem root = { 0, t_root };
+        stack[stack_size++] = root;
+    }
+
+    while (stack_size > 0) {
+        RayItem item = stack[--stack_size];
+        if (item.t_near > best_t) continue; // a closer hit was found since it was pushed
+
+        const BvhNode* node = &bvh->nodes[item.node];
+        if (node->count > 0) {
+            for (unsigned int i = node->first; i < node->first + node->count; i++) {
+                const float* corners[3];
+                triangle_corners(&bvh->mesh, bvh->triangles[i], corners);
+                if (ray_triangle(o, d, corners, best_t, hit)) {
+                    best_t = hit->t;
+                    hit->triangle = bvh->triangles[i];
+                    found = 1;
+                }
+            }
+            continue;
+        }
+
+        // Nearer child on top of the stack so its hits shrink best_t first
+        RayItem near_item = { node->first, ray_box(&bvh->nodes[node->first], o, inv, best_t) };
+        RayItem far_item = { node->first + 1, ray_box(&bvh->nodes[node->first + 1], o, inv, best_t) };
+        if (far_item.t_near < near_item.t_near) {
+            RayItem swap = near_item;
+            near_item = far_item;
+            far_item = swap;
+        }
+        if (far_item.t_near != FLT_MAX) stack[stack_size++] = far_item;
+        if (near_item.t_near != FLT_MAX) stack[stack_size++] = near_item;
+    }
+
+    if (stack != small_stack) free(stack);
+    return found;
+}
+
+//-------------------------------------------------------------//
+//                        Frustum query                         //
+//-------------------------------------------------------------//
+typedef struct {
+    unsigned int node;
+    unsigned int plane_mask; // planes the node may still cross
+} FrustumItem;
+
+unsigned int bvh_query_frustum(const Bvh* bvh, const Frustum* frustum, BvhLeafFunc func, void* user) {
+    if (bvh->node_count == 0) return 0;
+
+    FrustumItem small_stack[BVH_QUERY_STACK];
+    FrustumItem* stack = small_stack;
+    if (bvh->depth + 1 > BVH_QUERY_STACK) {
+        stack = malloc(sizeof(FrustumItem) * (bvh->depth + 1));
+        if (!stack) return 0;
+    }
+
+    unsigned int triangles = 0;
+    unsigned int stack_size = 0;
+    FrustumItem root = { 0, 0x3f };
+    stack[stack_size++] = root;
+
+    while (stack_size > 0) {
+        FrustumItem item = stack[--stack_size];
+        const BvhNode* node = &bvh->nodes[item.node];
+
+        int outside = 0;
+        for (int p = 0; p < 6 && !outside; p++) {
+            if (!(item.plane_mask & (1u << p))) continue;
+            const float* plane = frustum->planes[p];
+
+            // Box corners farthest along and against the plane normal
+            float far_distance = plane[3], near_distance = plane[3];
+            for (int k = 0; k < 3; k++) {
+                float hi = plane[k] * node->bounds_max[k];
+                float lo = plane[k] * node->bounds_min[k];
+                far_distance += hi > lo ? hi : lo;
+                near_distance += hi > lo ? lo : hi;
+            }
+            if (far_distance < 0.0f) outside = 1;
+            else if (near_distance >= 0.0f) item.plane_mask &= ~(1u << p);
+        }
+        if (outside) continue;
+
+        if (node->count > 0) {
+            triangles += node->count;
+            if (func) func(user, &bvh->triangles[node->first], node->count, item.plane_mask == 0);
+            continue;
+        }
+        FrustumItem right = { node->first + 1, item.plane_mask };
+        FrustumItem left = { node->first, item.plane_mask };
+        stack[stack_size++] = right;
+        stack[stack_size++] = left;
+    }
+
+    if (stack != small_stack) free(stack);
+    return triangles;
+}
@@ -0,0 +1,75 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "math3d.h"
+#include "mesh.h"
+#include "mesh_index.h"
+
+//-------------------------------------------------------------//
+//                 Bounding volume hierarchy                    //
+//-------------------------------------------------------------//
+// Binary AABB tree over the triangles of a mesh, built top-down with a
+// binned surface area heuristic. The top levels are split with binning
+// spread over the thread pool, then the remaining subtrees are built
+// as independent tasks. Queries only read the tree and are thread safe.
+
+// Where the triangles come from. The BVH keeps this view, so the
+// positions and indices must outlive it.
+typedef struct {
+    const float* positions;
+    size_t position_stride;    // floats from one vertex position to the next
+    const unsigned int* indices;
+    size_t index_stride;       // unsigned ints from one triangle to the next
+    unsigned int triangle_count;
+} BvhMesh;
+
+// Views of the two mesh types that exist before upload
+BvhMesh bvh_mesh_from_mesh(const Mesh* mesh);
+BvhMesh bvh_mesh_from_indexed(const IndexedMesh* mesh);
+
+typedef struct {
+    float bounds_min[3];
+    float bounds_max[3];
+    unsigned int first;  // leaf: first entry in triangles, interior: left child (right is first + 1)
+    unsigned int count;  // leaf: triangle count, interior: 0
+} BvhNode;
+
+typedef struct {
+    BvhMesh mesh;
+    BvhNode* nodes;            // nodes[0] is the root
+    unsigned int node_count;
+    unsigned int leaf_count;
+    unsigned int depth;
+    unsigned int* triangles;   // triangle indices in leaf order
+} Bvh;
+
+// Returns 1 on success. threaded = 0 builds on the calling thread only.
+int bvh_build(Bvh* bvh, const BvhMesh* mesh, int threaded);
+void bvh_free(Bvh* bvh);
+
+// Expected cost of a random ray under the SAH model, relative to
+// testing one triangle. Lower is better.
+float bvh_sah_cost(const Bvh* bvh);
+
+//-------------------------------------------------------------//
+//                           Queries                            //
+//-------------------------------------------------------------//
+typedef struct {
+    float t;               // distance along the ray, in units of direction
+    unsigned int triangle; // index into the source mesh
+    float u, v;            // barycentrics of corners 1 and 2
+} BvhHit;
+
+// Closest hit with 0 <= t <= max_t. Returns 0 on a miss.
+int bvh_intersect_ray(const Bvh* bvh, Vec3 origin, Vec3 direction, float max_t, BvhHit* hit);
+
+// Called for every leaf that touches the frustum. fully_inside is set
+// when no triangle of the leaf can be outside it.
+typedef void (*BvhLeafFunc)(void* user, const unsigned int* triangles, unsigned int count, int fully_inside);
+
+// Walks the tree against the frustum, skipping the plane tests below
+// nodes that are entirely inside. func may be NULL. Returns the number
+// of triangles in the visited leaves.
+unsigned int bvh_query_frustum(const Bvh* bvh, const Frustum* frustum, BvhLeafFunc func, void* user);
+
+#endif
@@ -0,0 +1,201 @@
+#include "capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "offscreen.h"
+
+static size_t capture_frame_bytes(const FrameCapture* capture) {
+    return (size_t)capture->width * (size_t)capture->height * 4;
+}
+
+//-------------------------------------------------------------//
+//                         Writer thread                        //
+//-------------------------------------------------------------//
+static void writer_main(void* user) {
+    FrameCapture* capture = user;
+    char path[1100];
+
+    platform_mutex_lock(capture->mutex);
+    for (;;) {
+        while (!capture->stopping && capture->queue_count == 0) platform_cond_wait(capture->queued, capture->mutex);
+        if (capture->queue_count == 0) break; // stopping and drained
+        int slot = capture->queue_head;
+        unsigned long long frame = capture->slot_frame[slot];
+        platform_mutex_unlock(capture->mutex);
+
+        // The slot stays counted until the file is written, so the render
+        // thread never refills it underneath the writer
+        double start = platform_time_seconds();
+        snprintf(path, sizeof(path), "%s_%06llu.ppm", capture->prefix, frame);
+        int ok = image_write_ppm(path, capture->slots[slot], capture->width, capture->height, 4);
+        double seconds = platform_time_seconds() - start;
+
+        platform_mutex_lock(capture->mutex);
+        capture->write_seconds += seconds;
+        if (ok) capture->frames_written++;
+        else capture->write_failures++;
+        capture->queue_head = (capture->queue_head + 1) % CAPTURE_QUEUE_FRAMES;
+        capture->queue_count--;
+        platform_cond_signal(capture->space);
+    }
+    platform_mutex_unlock(capture->mutex);
+}
+
+//-------------------------------------------------------------//
+//                          Lifetime                            //
+//-------------------------------------------------------------//
+int capture_start(FrameCapture* capture, const char* prefix, int width, int height) {
+    memset(capture, 0, sizeof(*capture));
+    snprintf(capture->prefix, sizeof(capture->prefix), "%s", prefix);
+    capture->width = width;
+    capture->height = height;
+
+    size_t bytes = capture_frame_bytes(capture);
+    for (int i = 0; i < CAPTURE_QUEUE_FRAMES; i++) {
+        capture->slots[i] = malloc(bytes);
+        if (!capture->slots[i]) {
+            printf("FATAL ERROR: Out of memory for the capture queue (%d x %zu bytes)\n", CAPTURE_QUEUE_FRAMES, bytes);
+            capture_finish(capture);
+            return 0;
+        }
+    }
+
+    while (glGetError() != GL_NO_ERROR) {} // only report errors from the allocation
+    glGenBuffers(CAPTURE_PBO_COUNT, capture->pbos);
+    for (int i = 0; i < CAPTURE_PBO_COUNT; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)bytes, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (glGetError() != GL_NO_ERROR) {
+        printf("FATAL ERROR: Could not allocate %d capture PBOs of %zu bytes\n", CAPTURE_PBO_COUNT, bytes);
+        capture_finish(capture);
+        return 0;
+    }
+
+    capture->mutex = platform_mutex_create();
+    capture->queued = platform_cond_create();
+    capture->space = platform_cond_create();
+    if (capture->mutex && capture->queued && capture->space) {
+        capture->writer = platform_thread_create(writer_main, capture);
+    }
+    if (!capture->writer) {
+        printf("FATAL ERROR: Could not start the capture writer thread\n");
+        capture_finish(capture);
+        return 0;
+    }
+
+    printf("Capturing %dx%d frames to %s_*.ppm\n", width, height, capture->prefix);
+    return 1;
+}
+
+// Maps one PBO whose read was issued frames ago and queues its pixels
+static void capture_retire(FrameCapture* capture, int pbo) {
+    GLsync fence = capture->fences[pbo];
+    capture->fences[pbo] = NULL;
+    if (fence) {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            double start = platform_time_seconds();
+            capture->fence_waits++;
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL);
+            capture->wait_seconds += platform_time_seconds() - start;
+        }
+        glDeleteSync(fence);
+    }
+
+    // A free slot; only waits when the disk falls behind
+    platform_mutex_lock(capture->mutex);
+    if (capture->queue_count == CAPTURE_QUEUE_FRAMES) {
+        double start = platform_time_seconds();
+        capture->queue_waits++;
+        while (capture->queue_count == CAPTURE_QUEUE_FRAMES) platform_cond_wait(capture->space, capture->mutex);
+        capture->wait_seconds += platform_time_seconds() - start;
+    }
+    int slot = (capture->queue_head + capture->queue_count) % CAPTURE_QUEUE_FRAMES;
+    platform_mutex_unlock(capture->mutex);
+
+    size_t bytes = capture_frame_bytes(capture);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[pbo]);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)bytes, GL_MAP_READ_BIT);
+    int ok = pixels != NULL;
+    if (ok) {
+        memcpy(capture->slots[slot], pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (ok) {
+        platform_mutex_lock(capture->mutex);
+        capture->slot_frame[slot] = capture->pbo_frame[pbo];
+        capture->queue_count++;
+        platform_cond_signal(capture->queued);
+        platform_mutex_unlock(capture->mutex);
+    }
+    else {
+        printf("WARNING: Could not map the capture of frame %llu\n", capture->pbo_frame[pbo]);
+    }
+    capture->pbo_frame[pbo] = 0;
+}
+
+void capture_frame(FrameCapture* capture) {
+    double start = platform_time_seconds();
+    int pbo = capture->next_pbo;
+    // The PBO was last used CAPTURE_PBO_COUNT frames ago and is ready by now
+    if (capture->pbo_frame[pbo]) capture_retire(capture, pbo);
+
+    // RGBA rows need no pack alignment and are the format drivers copy fastest
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[pbo]);
+    glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    capture->fences[pbo] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    capture->pbo_frame[pbo] = ++capture->frame;
+    capture->next_pbo = (pbo + 1) % CAPTURE_PBO_COUNT;
+    capture->readback_seconds += platform_time_seconds() - start;
+}
+
+void capture_finish(FrameCapture* capture) {
+    // Oldest first, so the frames reach the writer in order
+    if (capture->writer) {
+        for (int i = 0; i < CAPTURE_PBO_COUNT; i++) {
+            int pbo = (capture->next_pbo + i) % CAPTURE_PBO_COUNT;
+            if (capture->pbo_frame[pbo]) capture_retire(capture, pbo);
+        }
+        platform_mutex_lock(capture->mutex);
+        capture->stopping = 1;
+        platform_cond_signal(capture->queued);
+        platform_mutex_unlock(capture->mutex);
+        platform_thread_join(capture->writer);
+        capture->writer = NULL;
+    }
+
+    for (int i = 0; i < CAPTURE_PBO_COUNT; i++) {
+        if (capture->fences[i]) glDeleteSync(capture->fences[i]);
+        capture->fences[i] = NULL;
+        capture->pbo_frame[i] = 0;
+    }
+    if (capture->pbos[0]) glDeleteBuffers(CAPTURE_PBO_COUNT, capture->pbos);
+    memset(capture->pbos, 0, sizeof(capture->pbos));
+    for (int i = 0; i < CAPTURE_QUEUE_FRAMES; i++) {
+        free(capture->slots[i]);
+        capture->slots[i] = NULL;
+    }
+    if (capture->mutex) platform_mutex_destroy(capture->mutex);
+    if (capture->queued) platform_cond_destroy(capture->queued);
+    if (capture->space) platform_cond_destroy(capture->space);
+    capture->mutex = NULL;
+    capture->queued = NULL;
+    capture->space = NULL;
+    // The totals stay for capture_print_stats
+}
+
+void capture_print_stats(const FrameCapture* capture) {
+    if (capture->frame == 0) return;
+    double frames = (double)capture->frame;
+    printf("Capture: %llu of %llu frames written (%llu failed), readback %.3f ms per frame on the render thread (waits included), "
+        "writer %.3f ms per frame; %llu fence waits, %llu writer waits (%.3f ms)\n",
+        capture->frames_written, capture->frame, capture->write_failures,
+        capture->readback_seconds * 1000.0 / frames, capture->write_seconds * 1000.0 / frames,
+        capture->fence_waits, capture->queue_waits, capture->wait_seconds * 1000.0);
+}
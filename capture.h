@@ -0,0 +1,69 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <glad/glad.h>
+
+#include "platform.h"
+
+//-------------------------------------------------------------//
+//                     Asynchronous capture                     //
+//-------------------------------------------------------------//
+// Records every frame to "<prefix>_000001.ppm", ... without stalling the
+// render loop. glReadPixels goes into a pixel buffer object, so it only
+// queues a copy on the GPU, and each PBO is fenced. A PBO is mapped
+// again CAPTURE_PBO_COUNT frames later, when its copy has long finished,
+// so frame N is read back while frame N + 2 renders. The pixels are then
+// copied into a queue slot and a writer thread turns them into files.
+
+#define CAPTURE_PBO_COUNT 3
+#define CAPTURE_QUEUE_FRAMES 8 // frames waiting for the disk before the render loop has to wait
+
+typedef struct {
+    int width;
+    int height;
+    char prefix[1024];
+
+    // GPU side, render thread only
+    GLuint pbos[CAPTURE_PBO_COUNT];
+    GLsync fences[CAPTURE_PBO_COUNT];
+    unsigned long long pbo_frame[CAPTURE_PBO_COUNT]; // 0 when the PBO is free
+    int next_pbo;
+    unsigned long long frame;
+
+    // Frames for the writer, under the mutex
+    unsigned char* slots[CAPTURE_QUEUE_FRAMES]; // width * height * 4 bytes each
+    unsigned long long slot_frame[CAPTURE_QUEUE_FRAMES];
+    int queue_head;
+    int queue_count;
+    int stopping;
+    PlatformMutex* mutex;
+    PlatformCond* queued;
+    PlatformCond* space;
+    PlatformThread* writer;
+
+    // Totals
+    unsigned long long frames_written;  // writer thread
+    unsigned long long write_failures;  // writer thread
+    double write_seconds;               // writer thread
+    unsigned long long fence_waits;     // PBO copy not finished when it was due
+    unsigned long long queue_waits;     // writer too slow, the render thread waited
+    double wait_seconds;
+    double readback_seconds;            // render thread: issuing reads, mapping and copying
+} FrameCapture;
+
+// Allocates the PBOs and queue and starts the writer. Needs a current
+// GL context. Returns 1 on success; on failure the capture owns nothing.
+int capture_start(FrameCapture* capture, const char* prefix, int width, int height);
+
+// After the frame's draws, before the swap: reads the bound framebuffer
+// into the next PBO and hands the oldest finished one to the writer
+void capture_frame(FrameCapture* capture);
+
+// Reads back the frames still in flight, waits for the writer to store
+// everything and frees the capture. Safe on a zeroed capture.
+void capture_finish(FrameCapture* capture);
+
+// Call after capture_finish
+void capture_print_stats(const FrameCapture* capture);
+
+#endif
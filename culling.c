@@ -0,0 +1,126 @@
+#include "culling.h"
+#include "mesh_simplify.h"
+#include "platform.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+int instance_culler_create(InstanceCuller* culler, int capacity) {
+    memset(culler, 0, sizeof(*culler));
+    transforms_init(&culler->visible);
+    if (capacity < 1) capacity = 1;
+
+    for (int i = 0; i < 3; i++) culler->center[i] = malloc((size_t)capacity * sizeof(float));
+    culler->radius = malloc((size_t)capacity * sizeof(float));
+    culler->visible_indices = malloc((size_t)capacity * sizeof(int));
+    if (!culler->center[0] || !culler->center[1] || !culler->center[2] || !culler->radius ||
+        !culler->visible_indices || !transforms_reserve(&culler->visible, capacity)) {
+        instance_culler_destroy(culler);
+        return 0;
+    }
+    culler->capacity = capacity;
+    return 1;
+}
+
+void instance_culler_destroy(InstanceCuller* culler) {
+    for (int i = 0; i < 3; i++) free(culler->center[i]);
+    free(culler->radius);
+    free(culler->visible_indices);
+    transforms_free(&culler->visible);
+    memset(culler, 0, sizeof(*culler));
+}
+
+int instance_culler_run(InstanceCuller* culler, const Transforms* transforms, const Bounds* local, const float* view_projection) {
+    if (transforms->count > culler->capacity) return -1;
+    double start = platform_time_seconds();
+
+    Frustum frustum;
+    frustum_from_matrix(&frustum, view_projection);
+    transforms_bounding_spheres(transforms, local, culler->center, culler->radius);
+
+    const float* center[3] = { culler->center[0], culler->center[1], culler->center[2] };
+    int visible = frustum_cull_spheres(&frustum, center, culler->radius, transforms->count, culler->visible_indices);
+    if (!transforms_gather(&culler->visible, transforms, culler->visible_indices, visible)) return -1;
+
+    culler->seconds += platform_time_seconds() - start;
+    culler->frames++;
+    culler->visible_total += (unsigned long long)visible;
+    culler->culled_total += (unsigned long long)(transforms->count - visible);
+    return visible;
+}
+
+//-------------------------------------------------------------//
+//                   Level of detail selection                  //
+//-------------------------------------------------------------//
+int lod_selector_create(LodSelector* selector, int capacity) {
+    memset(selector, 0, sizeof(*selector));
+    transforms_init(&selector->sorted);
+    if (capacity < 1) capacity = 1;
+
+    for (int i = 0; i < 3; i++) selector->center[i] = malloc((size_t)capacity * sizeof(float));
+    selector->radius = malloc((size_t)capacity * sizeof(float));
+    selector->level = malloc((size_t)capacity);
+    selector->order = malloc((size_t)capacity * sizeof(int));
+    if (!selector->center[0] || !selector->center[1] || !selector->center[2] || !selector->radius ||
+        !selector->level || !selector->order || !transforms_reserve(&selector->sorted, capacity)) {
+        lod_selector_destroy(selector);
+        return 0;
+    }
+    selector->capacity = capacity;
+    return 1;
+}
+
+void lod_selector_destroy(LodSelector* selector) {
+    for (int i = 0; i < 3; i++) free(selector->center[i]);
+    free(selector->radius);
+    free(selector->level);
+    free(selector->order);
+    transforms_free(&selector->sorted);
+    memset(selector, 0, sizeof(*selector));
+}
+
+int lod_selector_run(LodSelector* selector, const Transforms* transforms, const Bounds* local,
+    const MeshLod* lods, unsigned int lod_count, const float* projection, Vec3 eye,
+    float viewport_height, float max_pixels) {
+    if (transforms->count > selector->capacity) return -1;
+    if (lod_count < 1) lod_count = 1;
+    if (lod_count > MESH_MAX_LODS) lod_count = MESH_MAX_LODS;
+    double start = platform_time_seconds();
+
+    transforms_bounding_spheres(transforms, local, selector->center, selector->radius);
+
+    // The nearest point of the sphere decides, and the error grows with
+    // the object's scale, taken from how much its sphere grew
+    int counts[MESH_MAX_LODS] = { 0 };
+    for (int i = 0; i < transforms->count; i++) {
+        float dx = selector->center[0][i] - eye.x;
+        float dy = selector->center[1][i] - eye.y;
+        float dz = selector->center[2][i] - eye.z;
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz) - selector->radius[i];
+        float scale = local->radius > 0.0f ? selector->radius[i] / local->radius : 1.0f;
+        if (scale <= 0.0f) scale = 1.0f;
+        unsigned int level = mesh_lod_select(lods, lod_count, distance / scale, projection, viewport_height, max_pixels);
+        selector->level[i] = (unsigned char)level;
+        counts[level]++;
+    }
+
+    // Counting sort by level, keeping the object order within a level
+    int next[MESH_MAX_LODS];
+    selector->level_start[0] = 0;
+    for (unsigned int level = 0; level < MESH_MAX_LODS; level++) {
+        next[level] = selector->level_start[level];
+        selector->level_start[level + 1] = selector->level_start[level] + (level < lod_count ? counts[level] : 0);
+    }
+    for (int i = 0; i < transforms->count; i++) selector->order[next[selector->level[i]]++] = i;
+    if (!transforms_gather(&selector->sorted, transforms, selector->order, transforms->count)) return -1;
+
+    selector->seconds += platform_time_seconds() - start;
+    selector->frames++;
+    for (unsigned int level = 0; level < lod_count; level++) {
+        selector->objects_per_level[level] += (unsigned long long)counts[level];
+        selector->triangles_drawn += (unsigned long long)counts[level] * (lods[level].index_count / 3);
+    }
+    selector->triangles_full += (unsigned long long)transforms->count * (lods[0].index_count / 3);
+    return transforms->count;
+}
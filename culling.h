@@ -0,0 +1,73 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "mesh_index.h"
+#include "transform.h"
+
+//-------------------------------------------------------------//
+//                   Instance frustum culling                   //
+//-------------------------------------------------------------//
+// Per frame: bounding spheres for every object, one SIMD pass over
+// them against the camera frustum, then the surviving transforms are
+// gathered into `visible` so only those get matrices and draws.
+
+typedef struct {
+    float* center[3];      // world-space spheres, one per object
+    float* radius;
+    int* visible_indices;
+    int capacity;
+
+    Transforms visible;    // the objects that passed, in order
+
+    // Totals over every cull call
+    unsigned long long frames;
+    unsigned long long visible_total;
+    unsigned long long culled_total;
+    double seconds;
+} InstanceCuller;
+
+int instance_culler_create(InstanceCuller* culler, int capacity);
+void instance_culler_destroy(InstanceCuller* culler);
+
+// Culls all of `transforms` (objects sharing the object-space bounds
+// `local`) against the frustum of `view_projection`. Returns the number
+// of visible objects, now in culler->visible, or -1 when out of memory.
+int instance_culler_run(InstanceCuller* culler, const Transforms* transforms, const Bounds* local, const float* view_projection);
+
+//-------------------------------------------------------------//
+//                   Level of detail selection                  //
+//-------------------------------------------------------------//
+// Per frame: each object's level from its bounding sphere's distance to
+// the camera (see mesh_lod_select), then the transforms are regrouped
+// by level so every level is one contiguous run of objects.
+
+typedef struct {
+    float* center[3];      // world-space spheres, one per object
+    float* radius;
+    unsigned char* level;
+    int* order;
+    int capacity;
+
+    Transforms sorted;                     // the objects grouped by level
+    int level_start[MESH_MAX_LODS + 1];    // level L is sorted[level_start[L], level_start[L + 1])
+
+    // Totals over every selection call
+    unsigned long long frames;
+    unsigned long long objects_per_level[MESH_MAX_LODS];
+    unsigned long long triangles_drawn;
+    unsigned long long triangles_full;     // what level 0 everywhere would have drawn
+    double seconds;
+} LodSelector;
+
+int lod_selector_create(LodSelector* selector, int capacity);
+void lod_selector_destroy(LodSelector* selector);
+
+// Picks the level of every object in `transforms` (sharing the
+// object-space bounds `local`) so its error stays under max_pixels on a
+// viewport_height pixel tall view through `projection`. Returns the
+// number of objects, now in selector->sorted, or -1 when out of memory.
+int lod_selector_run(LodSelector* selector, const Transforms* transforms, const Bounds* local,
+    const MeshLod* lods, unsigned int lod_count, const float* projection, Vec3 eye,
+    float viewport_height, float max_pixels);
+
+#endif
@@ -0,0 +1,37 @@
+#include "frame_ubo.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int frame_ubo_create(FrameUniformBuffer* ubo, int allow_persistent) {
+    memset(ubo, 0, sizeof(*ubo));
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment <= 0) alignment = 256;
+    ubo->alignment = alignment;
+
+    // One block per frame; a region that is a multiple of the alignment
+    // keeps every region start aligned too
+    GLsizeiptr region_size = ((GLsizeiptr)sizeof(FrameData) + alignment - 1) / alignment * alignment;
+    return ring_buffer_create(&ubo->ring, GL_UNIFORM_BUFFER, region_size, allow_persistent);
+}
+
+void frame_ubo_destroy(FrameUniformBuffer* ubo) {
+    ring_buffer_destroy(&ubo->ring);
+    memset(ubo, 0, sizeof(*ubo));
+}
+
+void frame_ubo_update(FrameUniformBuffer* ubo, const FrameData* data) {
+    GLintptr offset;
+    void* dst = ring_buffer_map(&ubo->ring, sizeof(FrameData), ubo->alignment, &offset);
+    if (!dst) return; // the previous frame's block stays bound
+    memcpy(dst, data, sizeof(FrameData));
+    ring_buffer_unmap(&ubo->ring);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, ubo->ring.buffer, offset, sizeof(FrameData));
+}
+
+void frame_ubo_end_frame(FrameUniformBuffer* ubo) {
+    ring_buffer_end_frame(&ubo->ring);
+}
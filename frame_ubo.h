@@ -0,0 +1,62 @@
+#ifndef FRAME_UBO_H
+#define FRAME_UBO_H
+
+#include <glad/glad.h>
+
+#include "ring_buffer.h"
+
+//-------------------------------------------------------------//
+//                  Per-frame uniform buffer                    //
+//-------------------------------------------------------------//
+// Camera and lighting state shared by every program through one
+// std140 block at binding FRAME_UBO_BINDING. It is written once per
+// frame into this frame's region of a RingBuffer, which fences the
+// regions and decides between waiting and orphaning, so the CPU never
+// overwrites data the GPU may still be reading.
+
+#define FRAME_UBO_BINDING 0
+
+// Matches FRAME_DATA_GLSL under std140: only mat4 and vec4 members,
+// so there is no hidden padding
+typedef struct {
+    float view[16];
+    float projection[16];
+    float view_projection[16];
+    float camera_position[4];  // xyz, w unused
+    float light_direction[4];  // xyz towards the light, normalized
+    float light_color[4];      // diffuse rgb
+    float ambient_color[4];    // rgb
+    float specular_color[4];   // rgb, w = shininess
+} FrameData;
+
+// Paste into shader sources after the #version line
+#define FRAME_DATA_GLSL \
+    "layout(std140) uniform FrameData {\n" \
+    "   mat4 view;\n" \
+    "   mat4 projection;\n" \
+    "   mat4 viewProj;\n" \
+    "   vec4 cameraPos;\n" \
+    "   vec4 lightDir;\n" \
+    "   vec4 lightColor;\n" \
+    "   vec4 ambientColor;\n" \
+    "   vec4 specularColor;\n" \
+    "};\n"
+
+typedef struct {
+    RingBuffer ring;
+    GLsizeiptr alignment;      // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+} FrameUniformBuffer;
+
+// Persistently mapped when allow_persistent is set and the driver has
+// GL_ARB_buffer_storage. Returns 1 on success.
+int frame_ubo_create(FrameUniformBuffer* ubo, int allow_persistent);
+void frame_ubo_destroy(FrameUniformBuffer* ubo);
+
+// Writes `data` into this frame's region and binds it to
+// FRAME_UBO_BINDING. Call once per frame before drawing.
+void frame_ubo_update(FrameUniformBuffer* ubo, const FrameData* data);
+
+// Call after the frame's draws: fences the region they read
+void frame_ubo_end_frame(FrameUniformBuffer* ubo);
+
+#endif
@@ -0,0 +1,44 @@
+#include "gl_extensions.h"
+
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
+
+GlExtensions gl_extensions;
+
+int gl_extension_supported(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (extension && strcmp(extension, name) == 0) return 1;
+    }
+    return 0;
+}
+
+void gl_extensions_load(void) {
+    memset(&gl_extensions, 0, sizeof(gl_extensions));
+
+    if (gl_extension_supported("GL_ARB_buffer_storage")) {
+        gl_extensions.BufferStorage = (GlBufferStorageProc)glfwGetProcAddress("glBufferStorage");
+        gl_extensions.buffer_storage = gl_extensions.BufferStorage != NULL;
+    }
+
+    if (gl_extension_supported("GL_ARB_get_program_binary")) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        gl_extensions.GetProgramBinary = (GlGetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+        gl_extensions.ProgramBinary = (GlProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+        gl_extensions.ProgramParameteri = (GlProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+        gl_extensions.program_binary = formats > 0 && gl_extensions.GetProgramBinary &&
+            gl_extensions.ProgramBinary && gl_extensions.ProgramParameteri;
+    }
+
+    printf("GL extensions: buffer storage %s, program binary %s\n",
+        gl_extensions.buffer_storage ? "yes" : "no", gl_extensions.program_binary ? "yes" : "no");
+}
+
+void gl_extensions_disable(const char* name) {
+    if (strcmp(name, "GL_ARB_buffer_storage") == 0) gl_extensions.buffer_storage = 0;
+    else if (strcmp(name, "GL_ARB_get_program_binary") == 0) gl_extensions.program_binary = 0;
+}
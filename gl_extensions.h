@@ -0,0 +1,55 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+//-------------------------------------------------------------//
+//                       GL extensions                          //
+//-------------------------------------------------------------//
+// glad is generated for plain GL 3.3 core, so the few newer entry
+// points used as optional fast paths are looked up here by hand. Every
+// user checks its flag and keeps a 3.3 fallback.
+
+// GL_ARB_buffer_storage (core in 4.4)
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+typedef void (APIENTRYP GlBufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// GL_ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+typedef void (APIENTRYP GlGetProgramBinaryProc)(GLuint program, GLsizei buffer_size, GLsizei* length, GLenum* format, void* binary);
+typedef void (APIENTRYP GlProgramBinaryProc)(GLuint program, GLenum format, const void* binary, GLsizei length);
+typedef void (APIENTRYP GlProgramParameteriProc)(GLuint program, GLenum name, GLint value);
+
+typedef struct {
+    int buffer_storage;
+    GlBufferStorageProc BufferStorage;
+
+    int program_binary; // also needs at least one binary format
+    GlGetProgramBinaryProc GetProgramBinary;
+    GlProgramBinaryProc ProgramBinary;
+    GlProgramParameteriProc ProgramParameteri;
+} GlExtensions;
+
+extern GlExtensions gl_extensions;
+
+// Call once after gladLoadGL with the context current. Prints which
+// optional paths are available.
+void gl_extensions_load(void);
+
+// Whether the current context lists `name` (GL_NUM_EXTENSIONS/glGetStringi)
+int gl_extension_supported(const char* name);
+
+// Forgets an extension, to force its fallback ("GL_ARB_buffer_storage",
+// "GL_ARB_get_program_binary")
+void gl_extensions_disable(const char* name);
+
+#endif
@@ -0,0 +1,121 @@
+#include "instancing.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define INSTANCE_MODEL_FLOATS 16
+#define INSTANCE_NORMAL_FLOATS 9
+
+static GLsizeiptr instance_bytes(int capacity) {
+    return (GLsizeiptr)capacity * (INSTANCE_MODEL_FLOATS + INSTANCE_NORMAL_FLOATS) * sizeof(float);
+}
+
+int instance_buffer_create(InstanceBuffer* instances, int capacity, int allow_persistent) {
+    memset(instances, 0, sizeof(*instances));
+    if (capacity < 1) capacity = 1;
+
+    if (!ring_buffer_create(&instances->ring, GL_ARRAY_BUFFER, instance_bytes(capacity), allow_persistent)) {
+        printf("FATAL ERROR: Could not allocate an instance buffer for %d instances\n", capacity);
+        return 0;
+    }
+    instances->capacity = capacity;
+    return 1;
+}
+
+void instance_buffer_destroy(InstanceBuffer* instances) {
+    ring_buffer_destroy(&instances->ring);
+    memset(instances, 0, sizeof(*instances));
+}
+
+void instance_buffer_bind_attributes(const InstanceBuffer* instances) {
+    instance_buffer_bind_attributes_from(instances, 0);
+}
+
+void instance_buffer_bind_attributes_from(const InstanceBuffer* instances, int first) {
+    GLsizei model_stride = INSTANCE_MODEL_FLOATS * sizeof(float);
+    GLsizei normal_stride = INSTANCE_NORMAL_FLOATS * sizeof(float);
+    size_t model_base = (size_t)instances->offset + (size_t)first * model_stride;
+    size_t normal_base = (size_t)instances->offset + (size_t)instances->count * model_stride + (size_t)first * normal_stride;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instances->ring.buffer);
+    // A matrix attribute takes one location per column
+    for (int col = 0; col < 4; col++) {
+        GLuint location = INSTANCE_MODEL_LOCATION + col;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, model_stride, (void*)(model_base + col * 4 * sizeof(float)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+    for (int col = 0; col < 3; col++) {
+        GLuint location = INSTANCE_NORMAL_LOCATION + col;
+        glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, normal_stride, (void*)(normal_base + col * 3 * sizeof(float)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+int instance_buffer_update(InstanceBuffer* instances, const Transforms* transforms, int count) {
+    if (count > instances->capacity) count = instances->capacity;
+    if (count > transforms->count) count = transforms->count;
+
+    if (count < 1) return 0;
+    GLintptr offset;
+    float* mapped = ring_buffer_map(&instances->ring, instance_bytes(count), 16, &offset);
+    if (!mapped) return 0;
+
+    // transforms_compute indexes from object 0, so a partial update
+    // computes a prefix of the transforms
+    Transforms prefix = *transforms;
+    prefix.count = count;
+    transforms_compute(&prefix, mapped, mapped + (size_t)count * INSTANCE_MODEL_FLOATS);
+
+    ring_buffer_unmap(&instances->ring);
+    instances->offset = offset;
+    instances->count = count;
+    instance_buffer_bind_attributes(instances);
+    return 1;
+}
+
+void instance_buffer_end_frame(InstanceBuffer* instances) {
+    ring_buffer_end_frame(&instances->ring);
+}
+
+//-------------------------------------------------------------//
+//                         Test scenes                          //
+//-------------------------------------------------------------//
+float instances_layout_grid(Transforms* transforms, int count, float spacing) {
+    int side = 1;
+    while ((long long)side * side * side < count) side++;
+
+    float half = (side - 1) * spacing * 0.5f;
+    Vec3 scale = { 1.0f, 1.0f, 1.0f };
+    for (int i = 0; i < count; i++) {
+        Vec3 position = {
+            (i % side) * spacing - half,
+            ((i / side) % side) * spacing - half,
+            (i / (side * side)) * spacing - half
+        };
+        if (transforms_push(transforms, position, quat_identity(), scale) < 0) break;
+    }
+    return half * sqrtf(3.0f);
+}
+
+void instances_animate(Transforms* transforms, double time) {
+    for (int i = 0; i < transforms->count; i++) {
+        // A fixed pseudo-random axis and speed per object
+        unsigned int h = (unsigned int)i * 2654435761u;
+        Vec3 axis = {
+            (float)(h & 0xff) - 127.5f,
+            (float)((h >> 8) & 0xff) - 127.5f,
+            (float)((h >> 16) & 0xff) - 127.5f
+        };
+        vec3_normalize(&axis);
+        float speed = 0.5f + (float)(h >> 24) / 255.0f;
+        Quat rotation = quat_from_axis_angle(axis, (float)fmod(time * speed, 6.283185307179586));
+        transforms->rotation[0][i] = rotation.x;
+        transforms->rotation[1][i] = rotation.y;
+        transforms->rotation[2][i] = rotation.z;
+        transforms->rotation[3][i] = rotation.w;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+
+#include "ring_buffer.h"
+#include "transform.h"
+
+//-------------------------------------------------------------//
+//                    Per-instance attributes                   //
+//-------------------------------------------------------------//
+// One GL buffer holding a model matrix and a normal matrix per
+// instance, read by glDrawElementsInstanced through attributes with
+// divisor 1. Each update writes two tightly packed runs, all model
+// matrices then all normal matrices, so the transform kernel can write
+// straight into the mapped buffer without interleaving. Each frame's
+// matrices go to the next region of a RingBuffer, so writing them never
+// waits for the draws of the frames before.
+
+#define INSTANCE_MODEL_LOCATION 2  // mat4, locations 2-5
+#define INSTANCE_NORMAL_LOCATION 6 // mat3, locations 6-8
+
+// Paste into a vertex shader after the #version line
+#define INSTANCE_ATTRIBUTES_GLSL \
+    "layout(location = 2) in mat4 instanceModel;\n" \
+    "layout(location = 6) in mat3 instanceNormalMatrix;\n"
+
+typedef struct {
+    RingBuffer ring;
+    GLintptr offset; // of the matrices written by the last update
+    int count;       // instances written by the last update
+    int capacity;
+} InstanceBuffer;
+
+// allow_persistent selects the persistently mapped ring when the
+// context has GL_ARB_buffer_storage
+int instance_buffer_create(InstanceBuffer* instances, int capacity, int allow_persistent);
+void instance_buffer_destroy(InstanceBuffer* instances);
+
+// Points the instance attributes at the matrices of the last update.
+// The target VAO must be bound.
+void instance_buffer_bind_attributes(const InstanceBuffer* instances);
+
+// The same, starting at instance `first`, so one update can feed several
+// draws that each use a run of the instances (GL 3.3 has no base instance)
+void instance_buffer_bind_attributes_from(const InstanceBuffer* instances, int first);
+
+// Recomputes the matrices of the first `count` transforms directly into
+// this frame's ring region and points the attributes of the bound VAO at
+// them. Returns 0 if mapping failed.
+int instance_buffer_update(InstanceBuffer* instances, const Transforms* transforms, int count);
+
+// Call after the frame's instanced draws
+void instance_buffer_end_frame(InstanceBuffer* instances);
+
+//-------------------------------------------------------------//
+//                         Test scenes                          //
+//-------------------------------------------------------------//
+// Appends `count` objects on a cube-shaped grid centered on the origin.
+// Returns the distance from the center to the farthest grid corner.
+float instances_layout_grid(Transforms* transforms, int count, float spacing);
+
+// Spins every object about its own fixed axis, `time` in seconds
+void instances_animate(Transforms* transforms, double time);
+
+#endif
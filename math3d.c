@@ -0,0 +1,865 @@
+#include "math3d.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MATH_HAVE_SSE 1
+#include <emmintrin.h>
+#if defined(_M_IX86)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define MATH_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+//-------------------------------------------------------------//
+//                       Backend dispatch                       //
+//-------------------------------------------------------------//
+typedef struct {
+    void (*multiply)(float* result, const float* a, const float* b);
+    void (*transpose)(float* result, const float* m);
+    int (*inverse)(float* result, const float* m);
+    void (*multiply_batch)(float* results, const float* a, const float* b, int count);
+    void (*transform_points)(Vec3* out, const float* m, const Vec3* points, int count);
+    void (*from_trs_batch)(float* models, float* normals, const TrsArrays* trs, int first, int count);
+    int (*cull_spheres)(const Frustum* frustum, const float* const center[3], const float* radius, int count, int* visible);
+} MathOps;
+
+static const MathOps scalar_ops = {
+    mat4_multiply_scalar,
+    mat4_transpose_scalar,
+    mat4_inverse_scalar,
+    mat4_multiply_batch_scalar,
+    mat4_transform_points_scalar,
+    mat4_from_trs_batch_scalar,
+    frustum_cull_spheres_scalar
+};
+
+static MathOps ops = {
+    mat4_multiply_scalar,
+    mat4_transpose_scalar,
+    mat4_inverse_scalar,
+    mat4_multiply_batch_scalar,
+    mat4_transform_points_scalar,
+    mat4_from_trs_batch_scalar,
+    frustum_cull_spheres_scalar
+};
+static MathBackend active_backend = MATH_BACKEND_SCALAR;
+
+//-------------------------------------------------------------//
+//                         Vec3 / Quat                          //
+//-------------------------------------------------------------//
+void vec3_sub(Vec3* result, Vec3 a, Vec3 b) {
+    result->x = a.x - b.x;
+    result->y = a.y - b.y;
+    result->z = a.z - b.z;
+}
+
+void vec3_normalize(Vec3* v) {
+    float len = sqrtf(v->x * v->x + v->y * v->y + v->z * v->z);
+    if (len > 0.00001f) {
+        v->x /= len;
+        v->y /= len;
+        v->z /= len;
+    }
+}
+
+void vec3_cross(Vec3* result, Vec3 a, Vec3 b) {
+    result->x = a.y * b.z - a.z * b.y;
+    result->y = a.z * b.x - a.x * b.z;
+    result->z = a.x * b.y - a.y * b.x;
+}
+
+Quat quat_identity(void) {
+    Quat q = { 0.0f, 0.0f, 0.0f, 1.0f };
+    return q;
+}
+
+Quat quat_from_axis_angle(Vec3 axis, float radians) {
+    float s = sinf(radians * 0.5f);
+    Quat q = { axis.x * s, axis.y * s, axis.z * s, cosf(radians * 0.5f) };
+    return q;
+}
+
+Quat quat_multiply(Quat a, Quat b) {
+    Quat q;
+    q.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+    q.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+    q.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+    q.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+    return q;
+}
+
+Quat quat_normalize(Quat q) {
+    float len = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    if (len < 0.00001f) return quat_identity();
+    float inv = 1.0f / len;
+    q.x *= inv;
+    q.y *= inv;
+    q.z *= inv;
+    q.w *= inv;
+    return q;
+}
+
+Quat quat_slerp(Quat a, Quat b, float t) {
+    float cos_theta = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    if (cos_theta < 0.0f) {
+        b.x = -b.x;
+        b.y = -b.y;
+        b.z = -b.z;
+        b.w = -b.w;
+        cos_theta = -cos_theta;
+    }
+
+    float wa, wb;
+    if (cos_theta > 0.9995f) {
+        // Nearly parallel, sin(theta) is too small to divide by
+        wa = 1.0f - t;
+        wb = t;
+    }
+    else {
+        float theta = acosf(cos_theta);
+        float inv_sin = 1.0f / sinf(theta);
+        wa = sinf((1.0f - t) * theta) * inv_sin;
+        wb = sinf(t * theta) * inv_sin;
+    }
+
+    Quat q = { wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z, wa * a.w + wb * b.w };
+    return quat_normalize(q);
+}
+
+Vec3 quat_rotate(Quat q, Vec3 v) {
+    // v + 2 * cross(q.xyz, cross(q.xyz, v) + w * v)
+    Vec3 u = { q.x, q.y, q.z };
+    Vec3 t;
+    vec3_cross(&t, u, v);
+    t.x += q.w * v.x;
+    t.y += q.w * v.y;
+    t.z += q.w * v.z;
+    Vec3 c;
+    vec3_cross(&c, u, t);
+    Vec3 r = { v.x + 2.0f * c.x, v.y + 2.0f * c.y, v.z + 2.0f * c.z };
+    return r;
+}
+
+//-------------------------------------------------------------//
+//                     Mat4 construction                        //
+//-------------------------------------------------------------//
+void mat4_identity(float* mat) {
+    for (int i = 0; i < 16; i++) mat[i] = 0.0f;
+    mat[0] = 1.0f;
+    mat[5] = 1.0f;
+    mat[10] = 1.0f;
+    mat[15] = 1.0f;
+}
+
+void mat4_perspective(float* mat, float fovy, float aspect, float near, float far) {
+    float f = 1.0f / tanf(fovy * 3.14159265f / 360.0f);
+    mat[0] = f / aspect;
+    mat[1] = 0;
+    mat[2] = 0;
+    mat[3] = 0;
+
+    mat[4] = 0;
+    mat[5] = f;
+    mat[6] = 0;
+    mat[7] = 0;
+
+    mat[8] = 0;
+    mat[9] = 0;
+    mat[10] = (far + near) / (near - far);
+    mat[11] = -1;
+
+    mat[12] = 0;
+    mat[13] = 0;
+    mat[14] = (2 * far * near) / (near - far);
+    mat[15] = 0;
+}
+
+void mat4_lookat(float* mat, Vec3 eye, Vec3 center, Vec3 up) {
+    Vec3 f, s, u;
+    vec3_sub(&f, center, eye);
+    vec3_normalize(&f);
+
+    vec3_cross(&s, f, up);
+    vec3_normalize(&s);
+
+    vec3_cross(&u, s, f);
+
+    mat[0] = s.x;
+    mat[1] = u.x;
+    mat[2] = -f.x;
+    mat[3] = 0;
+
+    mat[4] = s.y;
+    mat[5] = u.y;
+    mat[6] = -f.y;
+    mat[7] = 0;
+
+    mat[8] = s.z;
+    mat[9] = u.z;
+    mat[10] = -f.z;
+    mat[11] = 0;
+
+    mat[12] = -(s.x * eye.x + s.y * eye.y + s.z * eye.z);
+    mat[13] = -(u.x * eye.x + u.y * eye.y + u.z * eye.z);
+    mat[14] = (f.x * eye.x + f.y * eye.y + f.z * eye.z);
+    mat[15] = 1;
+}
+
+void mat4_from_trs(float* mat, Vec3 translation, Quat rotation, Vec3 scale) {
+    float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xy = x * y, xz = x * z, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+
+    mat[0] = (1.0f - 2.0f * (yy + zz)) * scale.x;
+    mat[1] = 2.0f * (xy + wz) * scale.x;
+    mat[2] = 2.0f * (xz - wy) * scale.x;
+    mat[3] = 0.0f;
+
+    mat[4] = 2.0f * (xy - wz) * scale.y;
+    mat[5] = (1.0f - 2.0f * (xx + zz)) * scale.y;
+    mat[6] = 2.0f * (yz + wx) * scale.y;
+    mat[7] = 0.0f;
+
+    mat[8] = 2.0f * (xz + wy) * scale.z;
+    mat[9] = 2.0f * (yz - wx) * scale.z;
+    mat[10] = (1.0f - 2.0f * (xx + yy)) * scale.z;
+    mat[11] = 0.0f;
+
+    mat[12] = translation.x;
+    mat[13] = translation.y;
+    mat[14] = translation.z;
+    mat[15] = 1.0f;
+}
+
+void mat3_normal_matrix(float* result, const float* m) {
+    float a = m[0], b = m[4], c = m[8];
+    float d = m[1], e = m[5], f = m[9];
+    float g = m[2], h = m[6], i = m[10];
+
+    float c00 = e * i - f * h, c01 = f * g - d * i, c02 = d * h - e * g;
+    float det = a * c00 + b * c01 + c * c02;
+    if (fabsf(det) < 1e-12f) {
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) result[col * 3 + row] = m[col * 4 + row];
+        }
+        return;
+    }
+    float inv_det = 1.0f / det;
+
+    // The inverse transpose is the cofactor matrix over the determinant:
+    // result[col * 3 + row] = cofactor(row, col) / det
+    result[0] = c00 * inv_det;
+    result[3] = c01 * inv_det;
+    result[6] = c02 * inv_det;
+    result[1] = (c * h - b * i) * inv_det;
+    result[4] = (a * i - c * g) * inv_det;
+    result[7] = (b * g - a * h) * inv_det;
+    result[2] = (b * f - c * e) * inv_det;
+    result[5] = (c * d - a * f) * inv_det;
+    result[8] = (a * e - b * d) * inv_det;
+}
+
+//-------------------------------------------------------------//
+//                     Bounds and culling                       //
+//-------------------------------------------------------------//
+void bounds_from_points(Bounds* bounds, const Vec3* points, int count) {
+    memset(bounds, 0, sizeof(*bounds));
+    if (count <= 0) return;
+
+    bounds->min = points[0];
+    bounds->max = points[0];
+    for (int i = 1; i < count; i++) {
+        Vec3 p = points[i];
+        if (p.x < bounds->min.x) bounds->min.x = p.x;
+        if (p.y < bounds->min.y) bounds->min.y = p.y;
+        if (p.z < bounds->min.z) bounds->min.z = p.z;
+        if (p.x > bounds->max.x) bounds->max.x = p.x;
+        if (p.y > bounds->max.y) bounds->max.y = p.y;
+        if (p.z > bounds->max.z) bounds->max.z = p.z;
+    }
+
+    // Centered on the box, but sized by the farthest actual point, which
+    // is tighter than half the box diagonal for most shapes
+    bounds->center.x = (bounds->min.x + bounds->max.x) * 0.5f;
+    bounds->center.y = (bounds->min.y + bounds->max.y) * 0.5f;
+    bounds->center.z = (bounds->min.z + bounds->max.z) * 0.5f;
+    float radius2 = 0.0f;
+    for (int i = 0; i < count; i++) {
+        float dx = points[i].x - bounds->center.x;
+        float dy = points[i].y - bounds->center.y;
+        float dz = points[i].z - bounds->center.z;
+        float d2 = dx * dx + dy * dy + dz * dz;
+        if (d2 > radius2) radius2 = d2;
+    }
+    bounds->radius = sqrtf(radius2);
+}
+
+void frustum_from_matrix(Frustum* frustum, const float* m) {
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or
+    // minus one of the others. Row i is (m[i], m[4 + i], m[8 + i], m[12 + i]).
+    for (int p = 0; p < 6; p++) {
+        int row = p / 2;
+        float sign = (p & 1) ? -1.0f : 1.0f;
+        float* plane = frustum->planes[p];
+        for (int k = 0; k < 4; k++) plane[k] = m[k * 4 + 3] + sign * m[k * 4 + row];
+
+        float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) {
+            for (int k = 0; k < 4; k++) plane[k] /= length;
+        }
+    }
+}
+
+//-------------------------------------------------------------//
+//                        Scalar backend                        //
+//-------------------------------------------------------------//
+void mat4_multiply_scalar(float* result, const float* a, const float* b) {
+    float r[16];
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            r[col * 4 + row] =
+                a[0 * 4 + row] * b[col * 4 + 0] +
+                a[1 * 4 + row] * b[col * 4 + 1] +
+                a[2 * 4 + row] * b[col * 4 + 2] +
+                a[3 * 4 + row] * b[col * 4 + 3];
+        }
+    }
+    memcpy(result, r, sizeof(r));
+}
+
+void mat4_transpose_scalar(float* result, const float* m) {
+    float r[16];
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            r[col * 4 + row] = m[row * 4 + col];
+        }
+    }
+    memcpy(result, r, sizeof(r));
+}
+
+// Cofactor expansion
+int mat4_inverse_scalar(float* result, const float* m) {
+    float inv[16];
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (fabsf(det) < 1e-12f) return 0;
+    float inv_det = 1.0f / det;
+    for (int i = 0; i < 16; i++) result[i] = inv[i] * inv_det;
+    return 1;
+}
+
+void mat4_multiply_batch_scalar(float* results, const float* a, const float* b, int count) {
+    for (int i = 0; i < count; i++) {
+        mat4_multiply_scalar(results + (size_t)i * 16, a, b + (size_t)i * 16);
+    }
+}
+
+void mat4_transform_points_scalar(Vec3* out, const float* m, const Vec3* points, int count) {
+    for (int i = 0; i < count; i++) {
+        Vec3 p = points[i];
+        out[i].x = m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12];
+        out[i].y = m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13];
+        out[i].z = m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14];
+    }
+}
+
+void mat4_from_trs_batch_scalar(float* models, float* normals, const TrsArrays* trs, int first, int count) {
+    for (int i = first; i < first + count; i++) {
+        Vec3 t = { trs->position[0][i], trs->position[1][i], trs->position[2][i] };
+        Quat r = { trs->rotation[0][i], trs->rotation[1][i], trs->rotation[2][i], trs->rotation[3][i] };
+        Vec3 s = { trs->scale[0][i], trs->scale[1][i], trs->scale[2][i] };
+        float* model = models + (size_t)i * 16;
+        mat4_from_trs(model, t, r, s);
+        if (normals) {
+            float* normal = normals + (size_t)i * 9;
+            float inv_scale2[3] = { 1.0f / (s.x * s.x), 1.0f / (s.y * s.y), 1.0f / (s.z * s.z) };
+            for (int col = 0; col < 3; col++) {
+                for (int row = 0; row < 3; row++) normal[col * 3 + row] = model[col * 4 + row] * inv_scale2[col];
+            }
+        }
+    }
+}
+
+int frustum_cull_spheres_scalar(const Frustum* frustum, const float* const center[3], const float* radius, int count, int* visible) {
+    int visible_count = 0;
+    for (int i = 0; i < count; i++) {
+        float x = center[0][i], y = center[1][i], z = center[2][i], r = radius[i];
+        int inside = 1;
+        for (int p = 0; p < 6 && inside; p++) {
+            const float* plane = frustum->planes[p];
+            inside = plane[0] * x + plane[1] * y + plane[2] * z + plane[3] >= -r;
+        }
+        if (inside) visible[visible_count++] = i;
+    }
+    return visible_count;
+}
+
+//-------------------------------------------------------------//
+//                          SSE backend                         //
+//-------------------------------------------------------------//
+// SSE2 only, which every x64 CPU has. The matrix columns map directly
+// onto four registers, so each result column is four broadcasts and
+// four multiply-adds.
+#ifdef MATH_HAVE_SSE
+
+#define SSE_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps((a), (b), _MM_SHUFFLE(w, z, y, x))
+#define SSE_SWIZZLE(v, x, y, z, w) SSE_SHUFFLE(v, v, x, y, z, w)
+#define SSE_SPLAT(v, i) SSE_SWIZZLE(v, i, i, i, i)
+
+static __m128 sse_linear_combine(__m128 column, __m128 a0, __m128 a1, __m128 a2, __m128 a3) {
+    __m128 r = _mm_mul_ps(a0, SSE_SPLAT(column, 0));
+    r = _mm_add_ps(r, _mm_mul_ps(a1, SSE_SPLAT(column, 1)));
+    r = _mm_add_ps(r, _mm_mul_ps(a2, SSE_SPLAT(column, 2)));
+    r = _mm_add_ps(r, _mm_mul_ps(a3, SSE_SPLAT(column, 3)));
+    return r;
+}
+
+static void mat4_multiply_sse(float* result, const float* a, const float* b) {
+    __m128 a0 = _mm_loadu_ps(a + 0), a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+    __m128 r0 = sse_linear_combine(_mm_loadu_ps(b + 0), a0, a1, a2, a3);
+    __m128 r1 = sse_linear_combine(_mm_loadu_ps(b + 4), a0, a1, a2, a3);
+    __m128 r2 = sse_linear_combine(_mm_loadu_ps(b + 8), a0, a1, a2, a3);
+    __m128 r3 = sse_linear_combine(_mm_loadu_ps(b + 12), a0, a1, a2, a3);
+    _mm_storeu_ps(result + 0, r0);
+    _mm_storeu_ps(result + 4, r1);
+    _mm_storeu_ps(result + 8, r2);
+    _mm_storeu_ps(result + 12, r3);
+}
+
+static void mat4_transpose_sse(float* result, const float* m) {
+    __m128 c0 = _mm_loadu_ps(m + 0), c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8), c3 = _mm_loadu_ps(m + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_storeu_ps(result + 0, c0);
+    _mm_storeu_ps(result + 4, c1);
+    _mm_storeu_ps(result + 8, c2);
+    _mm_storeu_ps(result + 12, c3);
+}
+
+// 2x2 blocks packed as (m00, m01, m10, m11)
+static __m128 sse_mat2_mul(__m128 a, __m128 b) { // a * b
+    return _mm_add_ps(_mm_mul_ps(a, SSE_SWIZZLE(b, 0, 3, 0, 3)),
+        _mm_mul_ps(SSE_SWIZZLE(a, 1, 0, 3, 2), SSE_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+static __m128 sse_mat2_adj_mul(__m128 a, __m128 b) { // adj(a) * b
+    return _mm_sub_ps(_mm_mul_ps(SSE_SWIZZLE(a, 3, 3, 0, 0), b),
+        _mm_mul_ps(SSE_SWIZZLE(a, 1, 1, 2, 2), SSE_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+static __m128 sse_mat2_mul_adj(__m128 a, __m128 b) { // a * adj(b)
+    return _mm_sub_ps(_mm_mul_ps(a, SSE_SWIZZLE(b, 3, 0, 3, 0)),
+        _mm_mul_ps(SSE_SWIZZLE(a, 1, 0, 3, 2), SSE_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// Block-wise inverse over 2x2 sub-matrices. It treats the columns as
+// rows, which is fine: inverting the transpose and storing the rows as
+// columns gives the inverse in our layout.
+static int mat4_inverse_sse(float* result, const float* m) {
+    __m128 r0 = _mm_loadu_ps(m + 0), r1 = _mm_loadu_ps(m + 4);
+    __m128 r2 = _mm_loadu_ps(m + 8), r3 = _mm_loadu_ps(m + 12);
+
+    // | A B |
+    // | C D |
+    __m128 A = _mm_movelh_ps(r0, r1);
+    __m128 B = _mm_movehl_ps(r1, r0);
+    __m128 C = _mm_movelh_ps(r2, r3);
+    __m128 D = _mm_movehl_ps(r3, r2);
+
+    // (|A|, |B|, |C|, |D|)
+    __m128 det_sub = _mm_sub_ps(
+        _mm_mul_ps(SSE_SHUFFLE(r0, r2, 0, 2, 0, 2), SSE_SHUFFLE(r1, r3, 1, 3, 1, 3)),
+        _mm_mul_ps(SSE_SHUFFLE(r0, r2, 1, 3, 1, 3), SSE_SHUFFLE(r1, r3, 0, 2, 0, 2)));
+    __m128 det_a = SSE_SPLAT(det_sub, 0);
+    __m128 det_b = SSE_SPLAT(det_sub, 1);
+    __m128 det_c = SSE_SPLAT(det_sub, 2);
+    __m128 det_d = SSE_SPLAT(det_sub, 3);
+
+    __m128 d_c = sse_mat2_adj_mul(D, C);
+    __m128 a_b = sse_mat2_adj_mul(A, B);
+    __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, A), sse_mat2_mul(B, d_c));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, D), sse_mat2_mul(C, a_b));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, C), sse_mat2_mul_adj(D, a_b));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, B), sse_mat2_mul_adj(A, d_c));
+
+    // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+    __m128 tr = _mm_mul_ps(a_b, SSE_SWIZZLE(d_c, 0, 2, 1, 3));
+    tr = _mm_add_ps(tr, SSE_SWIZZLE(tr, 1, 0, 3, 2));
+    tr = _mm_add_ps(tr, SSE_SWIZZLE(tr, 2, 3, 0, 1));
+    __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), tr);
+    if (fabsf(_mm_cvtss_f32(det)) < 1e-12f) return 0;
+
+    __m128 inv_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+    x = _mm_mul_ps(x, inv_det);
+    y = _mm_mul_ps(y, inv_det);
+    z = _mm_mul_ps(z, inv_det);
+    w = _mm_mul_ps(w, inv_det);
+
+    // The adjugate swizzle and the block-to-row shuffle in one step
+    _mm_storeu_ps(result + 0, SSE_SHUFFLE(x, y, 3, 1, 3, 1));
+    _mm_storeu_ps(result + 4, SSE_SHUFFLE(x, y, 2, 0, 2, 0));
+    _mm_storeu_ps(result + 8, SSE_SHUFFLE(z, w, 3, 1, 3, 1));
+    _mm_storeu_ps(result + 12, SSE_SHUFFLE(z, w, 2, 0, 2, 0));
+    return 1;
+}
+
+static void mat4_multiply_batch_sse(float* results, const float* a, const float* b, int count) {
+    __m128 a0 = _mm_loadu_ps(a + 0), a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+    for (int i = 0; i < count; i++) {
+        const float* src = b + (size_t)i * 16;
+        float* dst = results + (size_t)i * 16;
+        __m128 c0 = sse_linear_combine(_mm_loadu_ps(src + 0), a0, a1, a2, a3);
+        __m128 c1 = sse_linear_combine(_mm_loadu_ps(src + 4), a0, a1, a2, a3);
+        __m128 c2 = sse_linear_combine(_mm_loadu_ps(src + 8), a0, a1, a2, a3);
+        __m128 c3 = sse_linear_combine(_mm_loadu_ps(src + 12), a0, a1, a2, a3);
+        _mm_storeu_ps(dst + 0, c0);
+        _mm_storeu_ps(dst + 4, c1);
+        _mm_storeu_ps(dst + 8, c2);
+        _mm_storeu_ps(dst + 12, c3);
+    }
+}
+
+static void mat4_transform_points_sse(Vec3* out, const float* m, const Vec3* points, int count) {
+    __m128 m0 = _mm_loadu_ps(m + 0), m1 = _mm_loadu_ps(m + 4);
+    __m128 m2 = _mm_loadu_ps(m + 8), m3 = _mm_loadu_ps(m + 12);
+    for (int i = 0; i < count; i++) {
+        // Vec3 is 12 bytes, so no 16-byte loads or stores past the element
+        __m128 r = _mm_add_ps(m3, _mm_mul_ps(m0, _mm_set1_ps(points[i].x)));
+        r = _mm_add_ps(r, _mm_mul_ps(m1, _mm_set1_ps(points[i].y)));
+        r = _mm_add_ps(r, _mm_mul_ps(m2, _mm_set1_ps(points[i].z)));
+        float v[4];
+        _mm_storeu_ps(v, r);
+        out[i].x = v[0];
+        out[i].y = v[1];
+        out[i].z = v[2];
+    }
+}
+
+// Four objects per iteration, one per lane. The matrix elements come
+// out as 16 registers of "element k of objects 0-3", and four 4x4
+// transposes turn them into the columns of each object.
+static void mat4_from_trs_batch_sse(float* models, float* normals, const TrsArrays* trs, int first, int count) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    int i = first;
+    int end = first + count;
+
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(trs->rotation[0] + i);
+        __m128 y = _mm_loadu_ps(trs->rotation[1] + i);
+        __m128 z = _mm_loadu_ps(trs->rotation[2] + i);
+        __m128 w = _mm_loadu_ps(trs->rotation[3] + i);
+        __m128 sx = _mm_loadu_ps(trs->scale[0] + i);
+        __m128 sy = _mm_loadu_ps(trs->scale[1] + i);
+        __m128 sz = _mm_loadu_ps(trs->scale[2] + i);
+
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        // Rotation columns
+        __m128 r0 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+        __m128 r1 = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+        __m128 r2 = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+        __m128 r4 = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+        __m128 r5 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+        __m128 r6 = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+        __m128 r8 = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+        __m128 r9 = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+        __m128 r10 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+        __m128 c0 = _mm_mul_ps(r0, sx), c1 = _mm_mul_ps(r1, sx), c2 = _mm_mul_ps(r2, sx), c3 = _mm_setzero_ps();
+        __m128 c4 = _mm_mul_ps(r4, sy), c5 = _mm_mul_ps(r5, sy), c6 = _mm_mul_ps(r6, sy), c7 = _mm_setzero_ps();
+        __m128 c8 = _mm_mul_ps(r8, sz), c9 = _mm_mul_ps(r9, sz), c10 = _mm_mul_ps(r10, sz), c11 = _mm_setzero_ps();
+        __m128 c12 = _mm_loadu_ps(trs->position[0] + i);
+        __m128 c13 = _mm_loadu_ps(trs->position[1] + i);
+        __m128 c14 = _mm_loadu_ps(trs->position[2] + i);
+        __m128 c15 = one;
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        _MM_TRANSPOSE4_PS(c4, c5, c6, c7);
+        _MM_TRANSPOSE4_PS(c8, c9, c10, c11);
+        _MM_TRANSPOSE4_PS(c12, c13, c14, c15);
+
+        float* m = models + (size_t)i * 16;
+        _mm_storeu_ps(m + 0, c0);
+        _mm_storeu_ps(m + 4, c4);
+        _mm_storeu_ps(m + 8, c8);
+        _mm_storeu_ps(m + 12, c12);
+        _mm_storeu_ps(m + 16, c1);
+        _mm_storeu_ps(m + 20, c5);
+        _mm_storeu_ps(m + 24, c9);
+        _mm_storeu_ps(m + 28, c13);
+        _mm_storeu_ps(m + 32, c2);
+        _mm_storeu_ps(m + 36, c6);
+        _mm_storeu_ps(m + 40, c10);
+        _mm_storeu_ps(m + 44, c14);
+        _mm_storeu_ps(m + 48, c3);
+        _mm_storeu_ps(m + 52, c7);
+        _mm_storeu_ps(m + 56, c11);
+        _mm_storeu_ps(m + 60, c15);
+
+        if (normals) {
+            __m128 ix = _mm_div_ps(one, sx), iy = _mm_div_ps(one, sy), iz = _mm_div_ps(one, sz);
+            __m128 n0 = _mm_mul_ps(r0, ix), n1 = _mm_mul_ps(r1, ix), n2 = _mm_mul_ps(r2, ix), n3 = _mm_setzero_ps();
+            __m128 n4 = _mm_mul_ps(r4, iy), n5 = _mm_mul_ps(r5, iy), n6 = _mm_mul_ps(r6, iy), n7 = _mm_setzero_ps();
+            __m128 n8 = _mm_mul_ps(r8, iz), n9 = _mm_mul_ps(r9, iz), n10 = _mm_mul_ps(r10, iz), n11 = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(n0, n1, n2, n3);
+            _MM_TRANSPOSE4_PS(n4, n5, n6, n7);
+            _MM_TRANSPOSE4_PS(n8, n9, n10, n11);
+
+            // Each 4-wide store spills one float into the next column,
+            // which the next store overwrites. The last column of each
+            // object is stored as 2 + 1 floats so nothing runs past it.
+            __m128 columns[4][3] = { { n0, n4, n8 }, { n1, n5, n9 }, { n2, n6, n10 }, { n3, n7, n11 } };
+            for (int k = 0; k < 4; k++) {
+                float* n = normals + (size_t)(i + k) * 9;
+                _mm_storeu_ps(n + 0, columns[k][0]);
+                _mm_storeu_ps(n + 3, columns[k][1]);
+                _mm_storel_pi((__m64*)(n + 6), columns[k][2]);
+                _mm_store_ss(n + 8, _mm_movehl_ps(columns[k][2], columns[k][2]));
+            }
+        }
+    }
+
+    if (i < end) mat4_from_trs_batch_scalar(models, normals, trs, i, end - i);
+}
+
+// Four spheres per iteration against all six planes, no early out;
+// the lane mask then appends the survivors in order
+static int frustum_cull_spheres_sse(const Frustum* frustum, const float* const center[3], const float* radius, int count, int* visible) {
+    __m128 planes[6][4];
+    for (int p = 0; p < 6; p++) {
+        for (int k = 0; k < 4; k++) planes[p][k] = _mm_set1_ps(frustum->planes[p][k]);
+    }
+
+    int visible_count = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(center[0] + i);
+        __m128 y = _mm_loadu_ps(center[1] + i);
+        __m128 z = _mm_loadu_ps(center[2] + i);
+        __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_mul_ps(planes[p][0], x), planes[p][3]);
+            d = _mm_add_ps(d, _mm_mul_ps(planes[p][1], y));
+            d = _mm_add_ps(d, _mm_mul_ps(planes[p][2], z));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, neg_r));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int k = 0; k < 4; k++) {
+            if (mask & (1 << k)) visible[visible_count++] = i + k;
+        }
+    }
+
+    for (; i < count; i++) {
+        const float* tail_center[3] = { center[0] + i, center[1] + i, center[2] + i };
+        int index;
+        if (frustum_cull_spheres_scalar(frustum, tail_center, radius + i, 1, &index)) visible[visible_count++] = i;
+    }
+    return visible_count;
+}
+
+static const MathOps sse_ops = {
+    mat4_multiply_sse,
+    mat4_transpose_sse,
+    mat4_inverse_sse,
+    mat4_multiply_batch_sse,
+    mat4_transform_points_sse,
+    mat4_from_trs_batch_sse,
+    frustum_cull_spheres_sse
+};
+
+static int cpu_has_sse2(void) {
+#if defined(_M_IX86)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return 1; // part of the x64 baseline, or enabled by the compiler flags
+#endif
+}
+
+#endif
+
+//-------------------------------------------------------------//
+//                         NEON backend                         //
+//-------------------------------------------------------------//
+// AArch64 only, where NEON is always present. The inverse, the TRS
+// batch and sphere culling have no NEON version and stay scalar.
+#ifdef MATH_HAVE_NEON
+
+static float32x4_t neon_linear_combine(float32x4_t column, float32x4_t a0, float32x4_t a1, float32x4_t a2, float32x4_t a3) {
+    float32x4_t r = vmulq_laneq_f32(a0, column, 0);
+    r = vfmaq_laneq_f32(r, a1, column, 1);
+    r = vfmaq_laneq_f32(r, a2, column, 2);
+    r = vfmaq_laneq_f32(r, a3, column, 3);
+    return r;
+}
+
+static void mat4_multiply_neon(float* result, const float* a, const float* b) {
+    float32x4_t a0 = vld1q_f32(a + 0), a1 = vld1q_f32(a + 4);
+    float32x4_t a2 = vld1q_f32(a + 8), a3 = vld1q_f32(a + 12);
+    float32x4_t r0 = neon_linear_combine(vld1q_f32(b + 0), a0, a1, a2, a3);
+    float32x4_t r1 = neon_linear_combine(vld1q_f32(b + 4), a0, a1, a2, a3);
+    float32x4_t r2 = neon_linear_combine(vld1q_f32(b + 8), a0, a1, a2, a3);
+    float32x4_t r3 = neon_linear_combine(vld1q_f32(b + 12), a0, a1, a2, a3);
+    vst1q_f32(result + 0, r0);
+    vst1q_f32(result + 4, r1);
+    vst1q_f32(result + 8, r2);
+    vst1q_f32(result + 12, r3);
+}
+
+static void mat4_transpose_neon(float* result, const float* m) {
+    float32x4x4_t rows = vld4q_f32(m); // de-interleaving load is a transpose
+    vst1q_f32(result + 0, rows.val[0]);
+    vst1q_f32(result + 4, rows.val[1]);
+    vst1q_f32(result + 8, rows.val[2]);
+    vst1q_f32(result + 12, rows.val[3]);
+}
+
+static void mat4_multiply_batch_neon(float* results, const float* a, const float* b, int count) {
+    float32x4_t a0 = vld1q_f32(a + 0), a1 = vld1q_f32(a + 4);
+    float32x4_t a2 = vld1q_f32(a + 8), a3 = vld1q_f32(a + 12);
+    for (int i = 0; i < count; i++) {
+        const float* src = b + (size_t)i * 16;
+        float* dst = results + (size_t)i * 16;
+        float32x4_t c0 = neon_linear_combine(vld1q_f32(src + 0), a0, a1, a2, a3);
+        float32x4_t c1 = neon_linear_combine(vld1q_f32(src + 4), a0, a1, a2, a3);
+        float32x4_t c2 = neon_linear_combine(vld1q_f32(src + 8), a0, a1, a2, a3);
+        float32x4_t c3 = neon_linear_combine(vld1q_f32(src + 12), a0, a1, a2, a3);
+        vst1q_f32(dst + 0, c0);
+        vst1q_f32(dst + 4, c1);
+        vst1q_f32(dst + 8, c2);
+        vst1q_f32(dst + 12, c3);
+    }
+}
+
+static void mat4_transform_points_neon(Vec3* out, const float* m, const Vec3* points, int count) {
+    float32x4_t m0 = vld1q_f32(m + 0), m1 = vld1q_f32(m + 4);
+    float32x4_t m2 = vld1q_f32(m + 8), m3 = vld1q_f32(m + 12);
+    for (int i = 0; i < count; i++) {
+        float32x4_t r = vfmaq_n_f32(m3, m0, points[i].x);
+        r = vfmaq_n_f32(r, m1, points[i].y);
+        r = vfmaq_n_f32(r, m2, points[i].z);
+        float v[4];
+        vst1q_f32(v, r);
+        out[i].x = v[0];
+        out[i].y = v[1];
+        out[i].z = v[2];
+    }
+}
+
+static const MathOps neon_ops = {
+    mat4_multiply_neon,
+    mat4_transpose_neon,
+    mat4_inverse_scalar,
+    mat4_multiply_batch_neon,
+    mat4_transform_points_neon,
+    mat4_from_trs_batch_scalar,
+    frustum_cull_spheres_scalar
+};
+
+#endif
+
+//-------------------------------------------------------------//
+//                     Dispatched entry points                  //
+//-------------------------------------------------------------//
+void mat4_multiply(float* result, const float* a, const float* b) {
+    ops.multiply(result, a, b);
+}
+
+void mat4_transpose(float* result, const float* m) {
+    ops.transpose(result, m);
+}
+
+int mat4_inverse(float* result, const float* m) {
+    return ops.inverse(result, m);
+}
+
+void mat4_multiply_batch(float* results, const float* a, const float* b, int count) {
+    ops.multiply_batch(results, a, b, count);
+}
+
+void mat4_transform_points(Vec3* out, const float* m, const Vec3* points, int count) {
+    ops.transform_points(out, m, points, count);
+}
+
+void mat4_from_trs_batch(float* models, float* normals, const TrsArrays* trs, int first, int count) {
+    ops.from_trs_batch(models, normals, trs, first, count);
+}
+
+int frustum_cull_spheres(const Frustum* frustum, const float* const center[3], const float* radius, int count, int* visible) {
+    return ops.cull_spheres(frustum, center, radius, count, visible);
+}
+
+//-------------------------------------------------------------//
+//                       Backend selection                      //
+//-------------------------------------------------------------//
+int math_set_backend(MathBackend backend) {
+    switch (backend) {
+    case MATH_BACKEND_SCALAR:
+        ops = scalar_ops;
+        break;
+#ifdef MATH_HAVE_SSE
+    case MATH_BACKEND_SSE:
+        if (!cpu_has_sse2()) return 0;
+        ops = sse_ops;
+        break;
+#endif
+#ifdef MATH_HAVE_NEON
+    case MATH_BACKEND_NEON:
+        ops = neon_ops;
+        break;
+#endif
+    default:
+        return 0;
+    }
+    active_backend = backend;
+    return 1;
+}
+
+void math_init(void) {
+    if (math_set_backend(MATH_BACKEND_NEON)) return;
+    if (math_set_backend(MATH_BACKEND_SSE)) return;
+    math_set_backend(MATH_BACKEND_SCALAR);
+}
+
+MathBackend math_get_backend(void) {
+    return active_backend;
+}
+
+const char* math_backend_name(MathBackend backend) {
+    switch (backend) {
+    case MATH_BACKEND_SSE: return "SSE2";
+    case MATH_BACKEND_NEON: return "NEON";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef MATH3D_H
+#define MATH3D_H
+
+//-------------------------------------------------------------//
+//                        Vector math                           //
+//-------------------------------------------------------------//
+// Matrices are float[16], column-major like OpenGL: element (row, col)
+// is m[col * 4 + row]. Normal matrices are float[9], also column-major.
+// The hot matrix functions go through a backend table that math_init
+// points at SSE or NEON code when the CPU has it; until then, and on
+// other CPUs, the scalar versions run.
+
+typedef struct { float x, y, z; } Vec3;
+typedef struct { float x, y, z, w; } Quat; // unit quaternion, w is the real part
+
+typedef enum {
+    MATH_BACKEND_SCALAR,
+    MATH_BACKEND_SSE,
+    MATH_BACKEND_NEON
+} MathBackend;
+
+// Picks the fastest backend this CPU supports
+void math_init(void);
+// Returns 0 when the backend is not compiled in or the CPU lacks it
+int math_set_backend(MathBackend backend);
+MathBackend math_get_backend(void);
+const char* math_backend_name(MathBackend backend);
+
+//-------------------------------------------------------------//
+//                          Vec3 / Quat                         //
+//-------------------------------------------------------------//
+void vec3_sub(Vec3* result, Vec3 a, Vec3 b);
+void vec3_normalize(Vec3* v);
+void vec3_cross(Vec3* result, Vec3 a, Vec3 b);
+
+Quat quat_identity(void);
+Quat quat_from_axis_angle(Vec3 axis, float radians); // axis must be unit length
+Quat quat_multiply(Quat a, Quat b);                  // rotates by b, then a
+Quat quat_normalize(Quat q);
+Quat quat_slerp(Quat a, Quat b, float t);            // shortest path
+Vec3 quat_rotate(Quat q, Vec3 v);
+
+//-------------------------------------------------------------//
+//                            Mat4                              //
+//-------------------------------------------------------------//
+void mat4_identity(float* mat);
+void mat4_perspective(float* mat, float fovy, float aspect, float near, float far);
+void mat4_lookat(float* mat, Vec3 eye, Vec3 center, Vec3 up);
+// translation * rotation * scale
+void mat4_from_trs(float* mat, Vec3 translation, Quat rotation, Vec3 scale);
+
+// Dispatched. result may alias the inputs unless noted.
+void mat4_multiply(float* result, const float* a, const float* b); // result = a * b
+void mat4_transpose(float* result, const float* m);
+// Returns 0 and leaves result untouched when m is singular
+int mat4_inverse(float* result, const float* m);
+
+// mat3(transpose(inverse(m))). Inverts only the upper 3x3 block and
+// falls back to that block itself when it is singular.
+void mat3_normal_matrix(float* result, const float* m);
+
+//-------------------------------------------------------------//
+//                       Batch transforms                       //
+//-------------------------------------------------------------//
+// Dispatched. results[i] = a * b[i] for count matrices; results must
+// not alias a.
+void mat4_multiply_batch(float* results, const float* a, const float* b, int count);
+// out[i] = (m * vec4(points[i], 1)).xyz, out may alias points
+void mat4_transform_points(Vec3* out, const float* m, const Vec3* points, int count);
+
+// Structure-of-arrays translate/rotate/scale, one array per component
+typedef struct {
+    const float* position[3]; // x, y, z
+    const float* rotation[4]; // unit quaternion x, y, z, w
+    const float* scale[3];    // must be non-zero
+} TrsArrays;
+
+// Dispatched. For i in [first, first + count) writes mat4_from_trs of
+// element i to models + 16 * i and its normal matrix to normals + 9 * i.
+// normals may be NULL. For TRS matrices the normal matrix is just the
+// rotation with each column divided by its scale, no inverse needed.
+void mat4_from_trs_batch(float* models, float* normals, const TrsArrays* trs, int first, int count);
+
+//-------------------------------------------------------------//
+//                     Bounds and culling                       //
+//-------------------------------------------------------------//
+typedef struct {
+    Vec3 min, max;  // axis-aligned box
+    Vec3 center;    // sphere around the box center that holds every point
+    float radius;
+} Bounds;
+
+// Planes as (nx, ny, nz, d) with unit normals pointing inwards, so
+// dot(n, p) + d is the signed distance of p from the plane
+typedef struct {
+    float planes[6][4]; // left, right, bottom, top, near, far
+} Frustum;
+
+// Empty input gives a zero-sized box at the origin
+void bounds_from_points(Bounds* bounds, const Vec3* points, int count);
+
+// Extracts the frustum of a projection * view matrix, so culling
+// happens in world space
+void frustum_from_matrix(Frustum* frustum, const float* view_projection);
+
+// Dispatched. Tests spheres given as arrays (center x, y, z, radius)
+// against the frustum and writes the indices of those at least partly
+// inside to `visible`, in order. Returns how many there are.
+int frustum_cull_spheres(const Frustum* frustum, const float* const center[3], const float* radius, int count, int* visible);
+
+//-------------------------------------------------------------//
+//                       Scalar reference                       //
+//-------------------------------------------------------------//
+// The scalar backend, callable directly so benchmarks and checks can
+// compare against it whatever backend is active.
+void mat4_multiply_scalar(float* result, const float* a, const float* b);
+void mat4_transpose_scalar(float* result, const float* m);
+int mat4_inverse_scalar(float* result, const float* m);
+void mat4_multiply_batch_scalar(float* results, const float* a, const float* b, int count);
+void mat4_transform_points_scalar(Vec3* out, const float* m, const Vec3* points, int count);
+void mat4_from_trs_batch_scalar(float* models, float* normals, const TrsArrays* trs, int first, int count);
+int frustum_cull_spheres_scalar(const Frustum* frustum, const float* const center[3], const float* radius, int count, int* visible);
+
+#endif
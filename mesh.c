@@ -0,0 +1,111 @@
+#include "mesh.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MESH_MIN_CAPACITY 256
+
+void mesh_init(Mesh* mesh) {
+    mesh->vertices = NULL;
+    mesh->vertex_count = 0;
+    mesh->vertex_capacity = 0;
+    mesh->normals = NULL;
+    mesh->normal_count = 0;
+    mesh->normal_capacity = 0;
+    mesh->faces = NULL;
+    mesh->face_count = 0;
+    mesh->face_capacity = 0;
+    memset(&mesh->bounds, 0, sizeof(mesh->bounds));
+}
+
+void mesh_free(Mesh* mesh) {
+    free(mesh->vertices);
+    free(mesh->normals);
+    free(mesh->faces);
+    mesh_init(mesh);
+}
+
+void mesh_clear(Mesh* mesh) {
+    mesh->vertex_count = 0;
+    mesh->normal_count = 0;
+    mesh->face_count = 0;
+}
+
+// Resizes one array to exactly `capacity` elements
+static int resize_array(void** data, int* capacity, int new_capacity, size_t element_size) {
+    if (new_capacity == *capacity) return 1;
+    if (new_capacity == 0) {
+        free(*data);
+        *data = NULL;
+        *capacity = 0;
+        return 1;
+    }
+    void* resized = realloc(*data, (size_t)new_capacity * element_size);
+    if (!resized) return 0;
+    *data = resized;
+    *capacity = new_capacity;
+    return 1;
+}
+
+// Next capacity that holds `needed` elements, doubling from `current`
+static int grow_capacity(int current, int needed) {
+    long long capacity = current > MESH_MIN_CAPACITY ? current : MESH_MIN_CAPACITY;
+    while (capacity < needed) capacity *= 2;
+    if (capacity > INT_MAX) capacity = INT_MAX;
+    return (int)capacity;
+}
+
+int mesh_reserve(Mesh* mesh, int vertex_capacity, int normal_capacity, int face_capacity) {
+    // Vertices and normals only grow here, so a later failure leaves them larger but intact
+    if (vertex_capacity > mesh->vertex_capacity &&
+        !resize_array((void**)&mesh->vertices, &mesh->vertex_capacity, vertex_capacity, sizeof(Vec3))) return 0;
+    if (normal_capacity > mesh->normal_capacity &&
+        !resize_array((void**)&mesh->normals, &mesh->normal_capacity, normal_capacity, sizeof(Vec3))) return 0;
+    if (face_capacity > mesh->face_capacity &&
+        !resize_array((void**)&mesh->faces, &mesh->face_capacity, face_capacity, sizeof(Face))) return 0;
+    return 1;
+}
+
+void mesh_shrink_to_fit(Mesh* mesh) {
+    // A failed shrink just keeps the larger block
+    resize_array((void**)&mesh->vertices, &mesh->vertex_capacity, mesh->vertex_count, sizeof(Vec3));
+    resize_array((void**)&mesh->normals, &mesh->normal_capacity, mesh->normal_count, sizeof(Vec3));
+    resize_array((void**)&mesh->faces, &mesh->face_capacity, mesh->face_count, sizeof(Face));
+}
+
+int mesh_push_vertex(Mesh* mesh, Vec3 vertex) {
+    if (mesh->vertex_count >= mesh->vertex_capacity) {
+        if (mesh->vertex_count == INT_MAX) return 0;
+        int capacity = grow_capacity(mesh->vertex_capacity, mesh->vertex_count + 1);
+        if (!resize_array((void**)&mesh->vertices, &mesh->vertex_capacity, capacity, sizeof(Vec3))) return 0;
+    }
+    mesh->vertices[mesh->vertex_count++] = vertex;
+    return 1;
+}
+
+int mesh_push_normal(Mesh* mesh, Vec3 normal) {
+    if (mesh->normal_count >= mesh->normal_capacity) {
+        if (mesh->normal_count == INT_MAX) return 0;
+        int capacity = grow_capacity(mesh->normal_capacity, mesh->normal_count + 1);
+        if (!resize_array((void**)&mesh->normals, &mesh->normal_capacity, capacity, sizeof(Vec3))) return 0;
+    }
+    mesh->normals[mesh->normal_count++] = normal;
+    return 1;
+}
+
+int mesh_push_face(Mesh* mesh, const Face* face) {
+    if (mesh->face_count >= mesh->face_capacity) {
+        if (mesh->face_count == INT_MAX) return 0;
+        int capacity = grow_capacity(mesh->face_capacity, mesh->face_count + 1);
+        if (!resize_array((void**)&mesh->faces, &mesh->face_capacity, capacity, sizeof(Face))) return 0;
+    }
+    mesh->faces[mesh->face_count++] = *face;
+    return 1;
+}
+
+size_t mesh_memory_bytes(const Mesh* mesh) {
+    return (size_t)mesh->vertex_capacity * sizeof(Vec3) +
+           (size_t)mesh->normal_capacity * sizeof(Vec3) +
+           (size_t)mesh->face_capacity * sizeof(Face);
+}
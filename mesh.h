@@ -0,0 +1,59 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stddef.h>
+
+#include "math3d.h"
+
+//-------------------------------------------------------------//
+//                         Mesh structs                         //
+//-------------------------------------------------------------//
+typedef struct {
+    unsigned int v_idx[3]; // vertex indices per face tri
+    unsigned int n_idx[3]; // normal indices per face tri
+} Face;
+
+//-------------------------------------------------------------//
+//                         Mesh storage                         //
+//-------------------------------------------------------------//
+// Growable arrays for one loaded mesh. Any number of meshes can exist
+// at once; a zeroed Mesh (or mesh_init) is empty and owns nothing.
+typedef struct {
+    Vec3* vertices;
+    int vertex_count;
+    int vertex_capacity;
+
+    Vec3* normals;
+    int normal_count;
+    int normal_capacity;
+
+    Face* faces;
+    int face_count;
+    int face_capacity;
+
+    Bounds bounds; // of all vertices, filled in by the OBJ loader
+} Mesh;
+
+void mesh_init(Mesh* mesh);
+void mesh_free(Mesh* mesh);
+
+// Empties the mesh but keeps its storage
+void mesh_clear(Mesh* mesh);
+
+// Makes room for at least this many elements in total, so a caller that
+// knows the final sizes allocates exactly once. Returns 1 on success,
+// 0 when out of memory (the mesh is left unchanged).
+int mesh_reserve(Mesh* mesh, int vertex_capacity, int normal_capacity, int face_capacity);
+
+// Drops unused capacity once loading is done
+void mesh_shrink_to_fit(Mesh* mesh);
+
+// Appends one element, growing geometrically. Returns 0 when out of memory.
+int mesh_push_vertex(Mesh* mesh, Vec3 vertex);
+int mesh_push_normal(Mesh* mesh, Vec3 normal);
+int mesh_push_face(Mesh* mesh, const Face* face);
+
+// Bytes held by the mesh arrays, including unused capacity
+size_t mesh_memory_bytes(const Mesh* mesh);
+
+#endif
@@ -0,0 +1,309 @@
+#include "mesh_cache.h"
+#include "mesh_quantize.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------//
+//                         File layout                          //
+//-------------------------------------------------------------//
+//   MeshCacheHeader
+//   OBJ path (path_length bytes, no terminator)
+//   padding to 16 bytes, vertex block
+//   padding to 16 bytes, index block
+
+#define MESH_CACHE_MAGIC "OGLCMESH"
+#define MESH_CACHE_ENDIAN 0x01020304u
+#define MESH_CACHE_ALIGN 16
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t header_size;
+    uint32_t flags;
+
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+
+    uint32_t path_length;
+    uint32_t vertex_count;
+    uint32_t vertex_stride;
+    uint32_t index_count;
+    uint32_t index_size;
+    uint32_t vertex_format;
+    float position_offset[3];
+    float position_scale[3];
+    float bounds_min[3];
+    float bounds_max[3];
+    float bounds_center[3];
+    float bounds_radius;
+    uint32_t lod_count;
+    uint32_t lod_first_index[MESH_MAX_LODS];
+    uint32_t lod_index_count[MESH_MAX_LODS];
+    float lod_error[MESH_MAX_LODS];
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint64_t file_size;
+} MeshCacheHeader;
+
+static int cache_path(const char* obj_path, char* out, size_t out_size) {
+    int written = snprintf(out, out_size, "%s.meshcache", obj_path);
+    return written > 0 && (size_t)written < out_size;
+}
+
+static uint64_t align_up(uint64_t value) {
+    return (value + MESH_CACHE_ALIGN - 1) & ~(uint64_t)(MESH_CACHE_ALIGN - 1);
+}
+
+//-------------------------------------------------------------//
+//                        Content hash                          //
+//-------------------------------------------------------------//
+// 64-bit multiply/rotate hash over 8-byte words in four independent
+// lanes, so it runs near memory speed. Not cryptographic; it only has
+// to tell edited files apart.
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t mix_lane(uint64_t lane, uint64_t word) {
+    lane += word * 0xc2b2ae3d27d4eb4fULL;
+    lane = rotl64(lane, 31);
+    return lane * 0x9e3779b185ebca87ULL;
+}
+
+static uint64_t hash_bytes(const unsigned char* data, size_t size) {
+    uint64_t lanes[4] = { 0x243f6a8885a308d3ULL, 0x13198a2e03707344ULL, 0xa4093822299f31d0ULL, 0x082efa98ec4e6c89ULL };
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int l = 0; l < 4; l++) {
+            uint64_t word;
+            memcpy(&word, data + i + l * 8, 8);
+            lanes[l] = mix_lane(lanes[l], word);
+        }
+    }
+    uint64_t hash = (uint64_t)size;
+    for (int l = 0; l < 4; l++) hash = mix_lane(hash, lanes[l]);
+    for (; i < size; i++) hash = mix_lane(hash, data[i]);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static int hash_file(const char* path, uint64_t* hash) {
+    MappedFile file;
+    if (!platform_map_file(path, &file)) return 0;
+    *hash = hash_bytes((const unsigned char*)file.data, file.size);
+    platform_unmap_file(&file);
+    return 1;
+}
+
+//-------------------------------------------------------------//
+//                          Reading                             //
+//-------------------------------------------------------------//
+static int header_valid(const MeshCacheHeader* header, const MappedFile* file, const char* obj_path, unsigned int flags) {
+    if (file->size < sizeof(MeshCacheHeader)) return 0;
+    if (memcmp(header->magic, MESH_CACHE_MAGIC, 8) != 0) return 0;
+    if (header->version != MESH_CACHE_VERSION || header->endian != MESH_CACHE_ENDIAN) return 0;
+    if (header->header_size != sizeof(MeshCacheHeader) || header->file_size != file->size) return 0;
+    if (header->flags != flags) return 0;
+
+    size_t path_length = strlen(obj_path);
+    if (header->path_length != path_length || sizeof(MeshCacheHeader) + path_length > file->size) return 0;
+    if (memcmp(file->data + sizeof(MeshCacheHeader), obj_path, path_length) != 0) return 0;
+
+    if (header->vertex_format == VERTEX_FORMAT_FLOAT) {
+        if (header->vertex_stride != sizeof(float) * INDEXED_VERTEX_FLOATS) return 0;
+    }
+    else if (header->vertex_format == VERTEX_FORMAT_PACKED) {
+        if (header->vertex_stride != PACKED_VERTEX_BYTES) return 0;
+    }
+    else {
+        return 0;
+    }
+    if (header->index_size != 2 && header->index_size != 4) return 0;
+    uint64_t vertex_bytes = (uint64_t)header->vertex_count * header->vertex_stride;
+    uint64_t index_bytes = (uint64_t)header->index_count * header->index_size;
+    if (header->vertex_offset % MESH_CACHE_ALIGN || header->index_offset % MESH_CACHE_ALIGN) return 0;
+    if (header->vertex_offset + vertex_bytes > file->size || header->index_offset + index_bytes > file->size) return 0;
+
+    if (header->lod_count < 1 || header->lod_count > MESH_MAX_LODS) return 0;
+    for (uint32_t i = 0; i < header->lod_count; i++) {
+        if ((uint64_t)header->lod_first_index[i] + header->lod_index_count[i] > header->index_count) return 0;
+    }
+    return 1;
+}
+
+// The header can pass while the payload is damaged; an index past the
+// vertices would reach the GPU and the meshlet builder unchecked
+static int indices_valid(const MeshCacheHeader* header, const MappedFile* file) {
+    const char* data = file->data + header->index_offset;
+    uint32_t largest = 0;
+    if (header->index_size == 2) {
+        const uint16_t* indices = (const uint16_t*)data;
+        for (uint32_t i = 0; i < header->index_count; i++) {
+            if (indices[i] > largest) largest = indices[i];
+        }
+    }
+    else {
+        const uint32_t* indices = (const uint32_t*)data;
+        for (uint32_t i = 0; i < header->index_count; i++) {
+            if (indices[i] > largest) largest = indices[i];
+        }
+    }
+    return header->index_count == 0 || largest < header->vertex_count;
+}
+
+int mesh_cache_open(const char* obj_path, unsigned int flags, MeshCache* cache) {
+    memset(cache, 0, sizeof(*cache));
+    if (!cache_path(obj_path, cache->path, sizeof(cache->path))) return 0;
+
+    unsigned long long source_size;
+    long long source_mtime;
+    if (!platform_file_info(obj_path, &source_size, &source_mtime)) return 0;
+    if (!platform_map_file(cache->path, &cache->file)) return 0;
+
+    MeshCacheHeader header;
+    if (cache->file.size >= sizeof(header)) memcpy(&header, cache->file.data, sizeof(header));
+    if (!header_valid(&header, &cache->file, obj_path, flags) || header.source_size != source_size) {
+        printf("Mesh cache: %s is stale, rebuilding\n", cache->path);
+        platform_unmap_file(&cache->file);
+        return 0;
+    }
+
+    if (header.source_mtime != source_mtime) {
+        uint64_t source_hash;
+        if (!hash_file(obj_path, &source_hash) || source_hash != header.source_hash) {
+            printf("Mesh cache: %s is stale, rebuilding\n", cache->path);
+            platform_unmap_file(&cache->file);
+            return 0;
+        }
+        cache->refreshed_mtime = source_mtime;
+    }
+
+    if (!indices_valid(&header, &cache->file)) {
+        printf("Mesh cache: %s has indices past its %u vertices, rebuilding\n", cache->path, header.vertex_count);
+        platform_unmap_file(&cache->file);
+        cache->refreshed_mtime = 0;
+        return 0;
+    }
+
+    MeshBuffers* buffers = &cache->buffers;
+    buffers->vertices = cache->file.data + header.vertex_offset;
+    buffers->vertex_count = header.vertex_count;
+    buffers->vertex_stride = header.vertex_stride;
+    buffers->vertex_format = header.vertex_format;
+    buffers->indices = cache->file.data + header.index_offset;
+    buffers->index_count = header.index_count;
+    buffers->index_size = header.index_size;
+    memcpy(buffers->position_offset, header.position_offset, sizeof(header.position_offset));
+    memcpy(buffers->position_scale, header.position_scale, sizeof(header.position_scale));
+    memcpy(&buffers->bounds.min, header.bounds_min, sizeof(header.bounds_min));
+    memcpy(&buffers->bounds.max, header.bounds_max, sizeof(header.bounds_max));
+    memcpy(&buffers->bounds.center, header.bounds_center, sizeof(header.bounds_center));
+    buffers->bounds.radius = header.bounds_radius;
+    buffers->lod_count = header.lod_count;
+    for (uint32_t i = 0; i < header.lod_count; i++) {
+        buffers->lods[i].first_index = header.lod_first_index[i];
+        buffers->lods[i].index_count = header.lod_index_count[i];
+        buffers->lods[i].error = header.lod_error[i];
+    }
+    return 1;
+}
+
+void mesh_cache_close(MeshCache* cache) {
+    platform_unmap_file(&cache->file);
+
+    // Content matched after a touch; store the new write time so the next
+    // start skips the hash. Done after unmapping since Windows refuses
+    // writes to a mapped file.
+    if (cache->refreshed_mtime) {
+        FILE* file = platform_fopen(cache->path, "r+b");
+        MeshCacheHeader header;
+        if (file && fread(&header, sizeof(header), 1, file) == 1) {
+            header.source_mtime = cache->refreshed_mtime;
+            if (fseek(file, 0, SEEK_SET) == 0) fwrite(&header, sizeof(header), 1, file);
+        }
+        if (file) fclose(file);
+    }
+    cache->refreshed_mtime = 0;
+    memset(&cache->buffers, 0, sizeof(cache->buffers));
+}
+
+//-------------------------------------------------------------//
+//                          Writing                             //
+//-------------------------------------------------------------//
+static int write_padding(FILE* file, uint64_t from, uint64_t to) {
+    static const char zeros[MESH_CACHE_ALIGN] = { 0 };
+    return to == from || fwrite(zeros, 1, (size_t)(to - from), file) == (size_t)(to - from);
+}
+
+int mesh_cache_write(const char* obj_path, unsigned int flags, const MeshBuffers* buffers) {
+    char path[1024];
+    char temp_path[1040];
+    if (!cache_path(obj_path, path, sizeof(path))) return 0;
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    unsigned long long source_size;
+    long long source_mtime;
+    uint64_t source_hash;
+    if (!platform_file_info(obj_path, &source_size, &source_mtime) || !hash_file(obj_path, &source_hash)) return 0;
+
+    size_t path_length = strlen(obj_path);
+    memcpy(header.magic, MESH_CACHE_MAGIC, 8);
+    header.version = MESH_CACHE_VERSION;
+    header.endian = MESH_CACHE_ENDIAN;
+    header.header_size = sizeof(MeshCacheHeader);
+    header.flags = flags;
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+    header.source_hash = source_hash;
+    header.path_length = (uint32_t)path_length;
+    header.vertex_count = buffers->vertex_count;
+    header.vertex_stride = buffers->vertex_stride;
+    header.index_count = buffers->index_count;
+    header.index_size = buffers->index_size;
+    header.vertex_format = buffers->vertex_format;
+    memcpy(header.position_offset, buffers->position_offset, sizeof(header.position_offset));
+    memcpy(header.position_scale, buffers->position_scale, sizeof(header.position_scale));
+    memcpy(header.bounds_min, &buffers->bounds.min, sizeof(header.bounds_min));
+    memcpy(header.bounds_max, &buffers->bounds.max, sizeof(header.bounds_max));
+    memcpy(header.bounds_center, &buffers->bounds.center, sizeof(header.bounds_center));
+    header.bounds_radius = buffers->bounds.radius;
+    header.lod_count = buffers->lod_count;
+    for (unsigned int i = 0; i < buffers->lod_count; i++) {
+        header.lod_first_index[i] = buffers->lods[i].first_index;
+        header.lod_index_count[i] = buffers->lods[i].index_count;
+        header.lod_error[i] = buffers->lods[i].error;
+    }
+    header.vertex_offset = align_up(sizeof(MeshCacheHeader) + path_length);
+    header.index_offset = align_up(header.vertex_offset + (uint64_t)header.vertex_count * header.vertex_stride);
+    header.file_size = header.index_offset + (uint64_t)header.index_count * header.index_size;
+
+    // Written to a temporary file first so a crash never leaves a torn cache behind
+    FILE* file = platform_fopen(temp_path, "wb");
+    int ok = file != NULL;
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(obj_path, 1, path_length, file) == path_length;
+    ok = ok && write_padding(file, sizeof(header) + path_length, header.vertex_offset);
+    ok = ok && fwrite(buffers->vertices, header.vertex_stride, header.vertex_count, file) == header.vertex_count;
+    ok = ok && write_padding(file, header.vertex_offset + (uint64_t)header.vertex_count * header.vertex_stride, header.index_offset);
+    ok = ok && fwrite(buffers->indices, header.index_size, header.index_count, file) == header.index_count;
+    if (file && fclose(file) != 0) ok = 0;
+
+    if (ok) ok = platform_replace_file(temp_path, path);
+    if (!ok) {
+        remove(temp_path);
+        printf("WARNING: Could not write mesh cache %s\n", path);
+        return 0;
+    }
+    printf("Mesh cache: wrote %s (%.1f KB)\n", path, (double)header.file_size / 1024.0);
+    return 1;
+}
@@ -0,0 +1,45 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "mesh_index.h"
+#include "platform.h"
+
+//-------------------------------------------------------------//
+//                      Binary mesh cache                       //
+//-------------------------------------------------------------//
+// "<model.obj>.meshcache" holds the final interleaved vertex buffer
+// (float or packed, see MeshBuffers) and the 16/32-bit index buffer of
+// a model, laid out so that
+// a warm start only maps the file and hands both blocks to
+// glBufferData.
+//
+// A cache is valid for the same OBJ path, the same build flags, and
+// an OBJ with the same size and write time. When only the write time
+// changed (touch, fresh checkout) the OBJ content hash decides, and a
+// match refreshes the stored write time.
+
+#define MESH_CACHE_VERSION 4
+
+// Build flags are part of the key; a cache built with different
+// options is stale
+#define MESH_CACHE_OPTIMIZED 0x1u
+#define MESH_CACHE_QUANTIZED 0x2u
+#define MESH_CACHE_LOD 0x4u
+
+typedef struct {
+    MeshBuffers buffers;          // points into the mapping
+
+    MappedFile file;
+    char path[1024];
+    long long refreshed_mtime;    // nonzero when the header needs rewriting on close
+} MeshCache;
+
+// Maps the cache of `obj_path` if it is valid for `flags`.
+// Returns 1 on a hit, 0 when missing or stale.
+int mesh_cache_open(const char* obj_path, unsigned int flags, MeshCache* cache);
+void mesh_cache_close(MeshCache* cache);
+
+// Writes (or replaces) the cache of `obj_path`. Returns 1 on success.
+int mesh_cache_write(const char* obj_path, unsigned int flags, const MeshBuffers* buffers);
+
+#endif
@@ -0,0 +1,132 @@
+#include "mesh_index.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EMPTY_SLOT 0xffffffffu
+
+// 64-bit finalizer from MurmurHash3, spreads (v, n) pairs over the table
+static uint64_t hash_key(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+int mesh_build_indexed(const Mesh* mesh, IndexedMesh* out) {
+    out->vertices = NULL;
+    out->vertex_count = 0;
+    out->indices = NULL;
+    out->index_count = 0;
+
+    size_t corner_count = (size_t)mesh->face_count * 3;
+    if (corner_count >= EMPTY_SLOT) {
+        printf("FATAL ERROR: Mesh has too many triangles to index\n");
+        return 0;
+    }
+
+    // Power of two with at least twice as many slots as corners keeps probes short
+    size_t table_size = 16;
+    while (table_size < corner_count * 2) table_size *= 2;
+    uint32_t* table = malloc(sizeof(uint32_t) * table_size);
+    uint64_t* keys = malloc(sizeof(uint64_t) * (corner_count ? corner_count : 1));
+    out->indices = malloc(sizeof(unsigned int) * (corner_count ? corner_count : 1));
+    if (!table || !keys || !out->indices) {
+        free(table);
+        free(keys);
+        indexed_mesh_free(out);
+        printf("FATAL ERROR: Out of memory while indexing mesh\n");
+        return 0;
+    }
+    for (size_t i = 0; i < table_size; i++) table[i] = EMPTY_SLOT;
+
+    size_t mask = table_size - 1;
+    uint32_t unique = 0;
+    for (int i = 0; i < mesh->face_count; i++) {
+        for (int j = 0; j < 3; j++) {
+            uint64_t key = ((uint64_t)mesh->faces[i].v_idx[j] << 32) | mesh->faces[i].n_idx[j];
+            size_t slot = (size_t)hash_key(key) & mask;
+            while (table[slot] != EMPTY_SLOT && keys[table[slot]] != key) slot = (slot + 1) & mask;
+            if (table[slot] == EMPTY_SLOT) {
+                keys[unique] = key;
+                table[slot] = unique++;
+            }
+            out->indices[out->index_count++] = table[slot];
+        }
+    }
+    free(table);
+
+    out->vertices = malloc(sizeof(float) * INDEXED_VERTEX_FLOATS * (unique ? unique : 1));
+    if (!out->vertices) {
+        free(keys);
+        indexed_mesh_free(out);
+        printf("FATAL ERROR: Out of memory while indexing mesh\n");
+        return 0;
+    }
+    out->vertex_count = unique;
+    for (uint32_t i = 0; i < unique; i++) {
+        Vec3 v = mesh->vertices[keys[i] >> 32];
+        Vec3 n = mesh->normals[keys[i] & 0xffffffffu];
+        float* dst = &out->vertices[(size_t)i * INDEXED_VERTEX_FLOATS];
+        dst[0] = v.x;
+        dst[1] = v.y;
+        dst[2] = v.z;
+        dst[3] = n.x;
+        dst[4] = n.y;
+        dst[5] = n.z;
+    }
+    free(keys);
+
+    size_t vertex_bytes = sizeof(float) * INDEXED_VERTEX_FLOATS;
+    double soup_bytes = (double)corner_count * (double)vertex_bytes;
+    double indexed_bytes = (double)unique * (double)vertex_bytes +
+                           (double)corner_count * (double)indexed_mesh_index_size(out);
+    printf("Mesh indexed: %u unique of %u vertices (%.1f%%), %d-bit indices\n", unique, out->index_count,
+        corner_count ? 100.0 * unique / (double)corner_count : 0.0, indexed_mesh_index_size(out) * 8);
+    printf("Mesh indexed: %.1f KB -> %.1f KB, %.1f KB saved\n", soup_bytes / 1024.0,
+        indexed_bytes / 1024.0, (soup_bytes - indexed_bytes) / 1024.0);
+    return 1;
+}
+
+void indexed_mesh_free(IndexedMesh* mesh) {
+    free(mesh->vertices);
+    free(mesh->indices);
+    mesh->vertices = NULL;
+    mesh->vertex_count = 0;
+    mesh->indices = NULL;
+    mesh->index_count = 0;
+}
+
+int indexed_mesh_index_size(const IndexedMesh* mesh) {
+    return mesh->vertex_count <= 0x10000 ? 2 : 4;
+}
+
+unsigned short* indexed_mesh_indices16(const IndexedMesh* mesh) {
+    if (indexed_mesh_index_size(mesh) != 2) return NULL;
+    unsigned short* narrow = malloc(sizeof(unsigned short) * (mesh->index_count ? mesh->index_count : 1));
+    if (!narrow) return NULL;
+    for (unsigned int i = 0; i < mesh->index_count; i++) narrow[i] = (unsigned short)mesh->indices[i];
+    return narrow;
+}
+
+void mesh_buffers_from_indexed(const IndexedMesh* mesh, const unsigned short* indices16, MeshBuffers* buffers) {
+    buffers->vertices = mesh->vertices;
+    buffers->vertex_count = mesh->vertex_count;
+    buffers->vertex_stride = sizeof(float) * INDEXED_VERTEX_FLOATS;
+    buffers->vertex_format = VERTEX_FORMAT_FLOAT;
+    buffers->indices = indices16 ? (const void*)indices16 : (const void*)mesh->indices;
+    buffers->index_count = mesh->index_count;
+    buffers->index_size = indices16 ? 2 : 4;
+    for (int i = 0; i < 3; i++) {
+        buffers->position_offset[i] = 0.0f;
+        buffers->position_scale[i] = 1.0f;
+    }
+    memset(&buffers->bounds, 0, sizeof(buffers->bounds));
+    memset(buffers->lods, 0, sizeof(buffers->lods));
+    buffers->lods[0].index_count = mesh->index_count;
+    buffers->lod_count = 1;
+}
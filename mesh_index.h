@@ -0,0 +1,81 @@
+#ifndef MESH_INDEX_H
+#define MESH_INDEX_H
+
+#include "mesh.h"
+
+//-------------------------------------------------------------//
+//                        Indexed mesh                          //
+//-------------------------------------------------------------//
+// GPU-ready form of a Mesh: one interleaved vertex per unique
+// (v_idx, n_idx) pair plus a triangle list of indices into them.
+
+#define INDEXED_VERTEX_FLOATS 6 // position xyz, normal xyz
+
+typedef struct {
+    float* vertices;            // INDEXED_VERTEX_FLOATS per vertex
+    unsigned int vertex_count;
+    unsigned int* indices;      // 3 per triangle
+    unsigned int index_count;
+} IndexedMesh;
+
+// Deduplicates the face corners of `mesh` with a hash table and prints
+// the unique/total ratio and the bytes saved against a de-indexed
+// triangle soup. Returns 1 on success, 0 when out of memory.
+int mesh_build_indexed(const Mesh* mesh, IndexedMesh* out);
+void indexed_mesh_free(IndexedMesh* mesh);
+
+// 2 when every index fits in an unsigned short, otherwise 4
+int indexed_mesh_index_size(const IndexedMesh* mesh);
+
+// Copy of the indices narrowed to 16 bits, or NULL when they don't fit
+// or out of memory. The caller frees it.
+unsigned short* indexed_mesh_indices16(const IndexedMesh* mesh);
+
+//-------------------------------------------------------------//
+//                      Final GPU buffers                       //
+//-------------------------------------------------------------//
+// The vertex and index blocks exactly as they are uploaded. They are
+// views; whoever fills the struct owns the memory.
+
+#define MESH_MAX_LODS 5
+
+// One level of detail: a range of the index block
+typedef struct {
+    unsigned int first_index;
+    unsigned int index_count;
+    float error; // object-space distance from the full mesh, 0 for level 0
+} MeshLod;
+
+enum {
+    VERTEX_FORMAT_FLOAT,  // float position xyz, float normal xyz (24 bytes)
+    VERTEX_FORMAT_PACKED  // snorm16 position xyzw, 2_10_10_10 normal (12 bytes)
+};
+
+typedef struct {
+    const void* vertices;
+    unsigned int vertex_count;
+    unsigned int vertex_stride;   // bytes
+    unsigned int vertex_format;   // VERTEX_FORMAT_*
+    const void* indices;
+    unsigned int index_count;
+    unsigned int index_size;      // 2 or 4 bytes
+
+    // Object space position = stored position * scale + offset.
+    // Identity (scale 1, offset 0) for VERTEX_FORMAT_FLOAT.
+    float position_offset[3];
+    float position_scale[3];
+
+    Bounds bounds; // object space, for culling
+
+    // Level 0 is the full mesh. With simplified levels the index block
+    // holds every level's indices one after the other.
+    MeshLod lods[MESH_MAX_LODS];
+    unsigned int lod_count;
+} MeshBuffers;
+
+// Fills `buffers` with the float layout of `mesh`, using `indices16`
+// instead of the 32-bit indices when it is not NULL. Bounds are left
+// to the caller, and the whole index block becomes the single LOD.
+void mesh_buffers_from_indexed(const IndexedMesh* mesh, const unsigned short* indices16, MeshBuffers* buffers);
+
+#endif
@@ -0,0 +1,284 @@
+#include "mesh_optimize.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------//
+//                  Vertex cache simulation                     //
+//-------------------------------------------------------------//
+
+// FIFO with timestamps: a vertex is cached while fewer than cache_size
+// misses happened since it was inserted. Returns the miss count.
+static unsigned int simulate_fifo(const unsigned int* indices, unsigned int index_count,
+    unsigned int vertex_count, unsigned int cache_size, unsigned int* stamps) {
+    unsigned int time = cache_size + 1;
+    unsigned int misses = 0;
+    for (unsigned int v = 0; v < vertex_count; v++) stamps[v] = 0;
+    for (unsigned int i = 0; i < index_count; i++) {
+        unsigned int v = indices[i];
+        if (time - stamps[v] > cache_size) {
+            stamps[v] = time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+// Small LRU, most recent entry first. Returns the miss count.
+typedef struct {
+    unsigned int entries[64];
+    unsigned int size;
+    unsigned int used;
+} LruCache;
+
+static int lru_access(LruCache* cache, unsigned int id) {
+    unsigned int i = 0;
+    while (i < cache->used && cache->entries[i] != id) i++;
+    int hit = i < cache->used;
+    if (!hit) {
+        if (cache->used < cache->size) cache->used++;
+        i = cache->used - 1;
+    }
+    memmove(&cache->entries[1], &cache->entries[0], sizeof(unsigned int) * i);
+    cache->entries[0] = id;
+    return hit;
+}
+
+void mesh_analyze_vertex_cache(const IndexedMesh* mesh, VertexCacheStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (mesh->index_count == 0 || mesh->vertex_count == 0) return;
+
+    double triangles = mesh->index_count / 3.0;
+    unsigned int* stamps = malloc(sizeof(unsigned int) * mesh->vertex_count);
+    if (stamps) {
+        unsigned int misses = simulate_fifo(mesh->indices, mesh->index_count, mesh->vertex_count, VCACHE_FIFO_SIZE, stamps);
+        stats->acmr_fifo = misses / triangles;
+        stats->atvr_fifo = misses / (double)mesh->vertex_count;
+        free(stamps);
+    }
+
+    LruCache transform = { { 0 }, VCACHE_LRU_SIZE, 0 };
+    LruCache fetch = { { 0 }, VFETCH_CACHE_LINES, 0 };
+    unsigned int lru_misses = 0;
+    unsigned int line_misses = 0;
+    size_t vertex_bytes = sizeof(float) * INDEXED_VERTEX_FLOATS;
+    for (unsigned int i = 0; i < mesh->index_count; i++) {
+        unsigned int v = mesh->indices[i];
+        if (lru_access(&transform, v)) continue;
+        lru_misses++;
+
+        // Only vertices that miss the post-transform cache are fetched
+        size_t first_line = (size_t)v * vertex_bytes / VFETCH_LINE_BYTES;
+        size_t last_line = ((size_t)v * vertex_bytes + vertex_bytes - 1) / VFETCH_LINE_BYTES;
+        for (size_t line = first_line; line <= last_line; line++) {
+            if (!lru_access(&fetch, (unsigned int)line)) line_misses++;
+        }
+    }
+    stats->acmr_lru = lru_misses / triangles;
+    stats->atvr_lru = lru_misses / (double)mesh->vertex_count;
+    stats->overfetch = (double)line_misses * VFETCH_LINE_BYTES / ((double)mesh->vertex_count * (double)vertex_bytes);
+}
+
+static void print_stats(const char* pass, const VertexCacheStats* before, const VertexCacheStats* after, double seconds) {
+    printf("%s: FIFO%d ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", pass, VCACHE_FIFO_SIZE,
+        before->acmr_fifo, after->acmr_fifo, before->atvr_fifo, after->atvr_fifo);
+    printf("%s: LRU%d ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", pass, VCACHE_LRU_SIZE,
+        before->acmr_lru, after->acmr_lru, before->atvr_lru, after->atvr_lru);
+    printf("%s: overfetch %.3f -> %.3f (%.3f ms)\n", pass, before->overfetch, after->overfetch, seconds * 1000.0);
+}
+
+//-------------------------------------------------------------//
+//                      Tipsify reordering                      //
+//-------------------------------------------------------------//
+typedef struct {
+    unsigned int* offsets;    // vertex_count + 1, start of each vertex's triangles
+    unsigned int* triangles;  // triangle ids grouped by vertex
+    unsigned int* live;       // triangles per vertex not emitted yet
+    unsigned int* stamps;     // FIFO insertion time per vertex
+    unsigned int* dead_end;   // stack of recently used vertices
+    unsigned int* candidates; // vertices touched by the current fan
+    unsigned char* emitted;   // per triangle
+} TipsifyState;
+
+static void tipsify_free(TipsifyState* state) {
+    free(state->offsets);
+    free(state->triangles);
+    free(state->live);
+    free(state->stamps);
+    free(state->dead_end);
+    free(state->candidates);
+    free(state->emitted);
+}
+
+#define NO_VERTEX 0xffffffffu
+
+// Most recently used vertex that still has triangles, then the next
+// live vertex in input order
+static unsigned int skip_dead_end(const TipsifyState* state, unsigned int* dead_end_size,
+    unsigned int* cursor, unsigned int vertex_count) {
+    while (*dead_end_size > 0) {
+        unsigned int v = state->dead_end[--*dead_end_size];
+        if (state->live[v] > 0) return v;
+    }
+    while (*cursor < vertex_count) {
+        unsigned int v = (*cursor)++;
+        if (state->live[v] > 0) return v;
+    }
+    return NO_VERTEX;
+}
+
+int mesh_optimize_vertex_cache(IndexedMesh* mesh) {
+    unsigned int vertex_count = mesh->vertex_count;
+    unsigned int triangle_count = mesh->index_count / 3;
+    if (triangle_count == 0) return 1;
+
+    VertexCacheStats before, after;
+    mesh_analyze_vertex_cache(mesh, &before);
+    double start_time = platform_time_seconds();
+
+    TipsifyState state;
+    state.offsets = calloc((size_t)vertex_count + 1, sizeof(unsigned int));
+    state.triangles = malloc(sizeof(unsigned int) * mesh->index_count);
+    state.live = calloc(vertex_count, sizeof(unsigned int));
+    state.stamps = calloc(vertex_count, sizeof(unsigned int));
+    state.dead_end = malloc(sizeof(unsigned int) * mesh->index_count);
+    state.candidates = NULL;
+    state.emitted = calloc(triangle_count, 1);
+    unsigned int* output = malloc(sizeof(unsigned int) * mesh->index_count);
+    if (!state.offsets || !state.triangles || !state.live || !state.stamps || !state.dead_end || !state.emitted || !output) {
+        tipsify_free(&state);
+        free(output);
+        printf("WARNING: Out of memory, vertex cache optimization skipped\n");
+        return 0;
+    }
+
+    // Vertex -> triangle adjacency as a counting sort
+    for (unsigned int i = 0; i < mesh->index_count; i++) state.live[mesh->indices[i]]++;
+    unsigned int max_valence = 0;
+    for (unsigned int v = 0; v < vertex_count; v++) {
+        state.offsets[v + 1] = state.offsets[v] + state.live[v];
+        if (state.live[v] > max_valence) max_valence = state.live[v];
+    }
+    for (unsigned int i = 0; i < mesh->index_count; i++) {
+        unsigned int v = mesh->indices[i];
+        state.triangles[state.offsets[v + 1] - state.live[v]] = i / 3;
+        state.live[v]--;
+    }
+    for (unsigned int v = 0; v < vertex_count; v++) state.live[v] = state.offsets[v + 1] - state.offsets[v];
+
+    state.candidates = malloc(sizeof(unsigned int) * 3 * (size_t)max_valence);
+    if (!state.candidates) {
+        tipsify_free(&state);
+        free(output);
+        printf("WARNING: Out of memory, vertex cache optimization skipped\n");
+        return 0;
+    }
+
+    const unsigned int cache_size = VCACHE_FIFO_SIZE;
+    unsigned int time = cache_size + 1;
+    unsigned int dead_end_size = 0;
+    unsigned int cursor = 0;
+    unsigned int written = 0;
+    unsigned int fan = mesh->indices[0];
+
+    while (fan != NO_VERTEX) {
+        // Emit every remaining triangle around the fanning vertex
+        unsigned int candidate_count = 0;
+        for (unsigned int a = state.offsets[fan]; a < state.offsets[fan + 1]; a++) {
+            unsigned int t = state.triangles[a];
+            if (state.emitted[t]) continue;
+            state.emitted[t] = 1;
+            for (int c = 0; c < 3; c++) {
+                unsigned int v = mesh->indices[t * 3 + c];
+                output[written++] = v;
+                state.dead_end[dead_end_size++] = v;
+                state.candidates[candidate_count++] = v;
+                state.live[v]--;
+                if (time - state.stamps[v] > cache_size) state.stamps[v] = time++;
+            }
+        }
+
+        // Next fan: the candidate that is still cached after emitting all its
+        // triangles and has been in the cache longest, so it is used before eviction
+        unsigned int next = NO_VERTEX;
+        unsigned int best = 0;
+        for (unsigned int i = 0; i < candidate_count; i++) {
+            unsigned int v = state.candidates[i];
+            if (state.live[v] == 0) continue;
+            unsigned int priority = 0;
+            if (time - state.stamps[v] + 2 * state.live[v] <= cache_size) priority = time - state.stamps[v];
+            if (next == NO_VERTEX || priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+        if (next == NO_VERTEX) next = skip_dead_end(&state, &dead_end_size, &cursor, vertex_count);
+        fan = next;
+    }
+
+    memcpy(mesh->indices, output, sizeof(unsigned int) * mesh->index_count);
+    tipsify_free(&state);
+    free(output);
+
+    double elapsed = platform_time_seconds() - start_time;
+    mesh_analyze_vertex_cache(mesh, &after);
+    print_stats("Vertex cache", &before, &after, elapsed);
+    return 1;
+}
+
+//-------------------------------------------------------------//
+//                    Vertex fetch reordering                   //
+//-------------------------------------------------------------//
+int mesh_optimize_vertex_fetch(IndexedMesh* mesh) {
+    if (mesh->vertex_count == 0) return 1;
+
+    VertexCacheStats before, after;
+    mesh_analyze_vertex_cache(mesh, &before);
+    double start_time = platform_time_seconds();
+
+    unsigned int* remap = malloc(sizeof(unsigned int) * mesh->vertex_count);
+    float* vertices = malloc(sizeof(float) * INDEXED_VERTEX_FLOATS * mesh->vertex_count);
+    unsigned int* indices = malloc(sizeof(unsigned int) * mesh->index_count);
+    if (!remap || !vertices || !indices) {
+        free(remap);
+        free(vertices);
+        free(indices);
+        printf("WARNING: Out of memory, vertex fetch optimization skipped\n");
+        return 0;
+    }
+    for (unsigned int v = 0; v < mesh->vertex_count; v++) remap[v] = NO_VERTEX;
+
+    unsigned int next = 0;
+    for (unsigned int i = 0; i < mesh->index_count; i++) {
+        unsigned int v = mesh->indices[i];
+        if (remap[v] == NO_VERTEX) {
+            remap[v] = next;
+            memcpy(&vertices[(size_t)next * INDEXED_VERTEX_FLOATS], &mesh->vertices[(size_t)v * INDEXED_VERTEX_FLOATS],
+                sizeof(float) * INDEXED_VERTEX_FLOATS);
+            next++;
+        }
+        indices[i] = remap[v];
+    }
+    free(remap);
+
+    // Vertices no triangle uses are dropped
+    IndexedMesh reordered = { vertices, next, indices, mesh->index_count };
+    mesh_analyze_vertex_cache(&reordered, &after);
+    double elapsed = platform_time_seconds() - start_time;
+    print_stats("Vertex fetch", &before, &after, elapsed);
+    if (after.overfetch > before.overfetch) {
+        printf("Vertex fetch: the original vertex order fetches less, kept it\n");
+        free(vertices);
+        free(indices);
+        return 1;
+    }
+
+    free(mesh->vertices);
+    free(mesh->indices);
+    mesh->vertices = vertices;
+    mesh->vertex_count = next;
+    mesh->indices = indices;
+    return 1;
+}
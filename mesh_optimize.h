@@ -0,0 +1,47 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include "mesh_index.h"
+
+//-------------------------------------------------------------//
+//                  Vertex cache simulation                     //
+//-------------------------------------------------------------//
+// Caches are simulated on the CPU so the numbers can be checked
+// without a GPU. ACMR is transformed vertices per triangle (0.5 is
+// the ideal for large closed meshes, 3.0 is no reuse at all), ATVR
+// is transformed vertices per unique vertex (1.0 is ideal).
+
+#define VCACHE_FIFO_SIZE 16   // what the reordering pass targets
+#define VCACHE_LRU_SIZE  32
+#define VFETCH_LINE_BYTES 64  // pre-transform fetch granularity
+#define VFETCH_CACHE_LINES 16
+
+typedef struct {
+    double acmr_fifo;
+    double atvr_fifo;
+    double acmr_lru;
+    double atvr_lru;
+    double overfetch; // bytes fetched / vertex bytes, 1.0 is ideal
+} VertexCacheStats;
+
+void mesh_analyze_vertex_cache(const IndexedMesh* mesh, VertexCacheStats* stats);
+
+//-------------------------------------------------------------//
+//                      Reordering passes                       //
+//-------------------------------------------------------------//
+// Both passes keep the rendered result identical and print the stats
+// before and after. They return 1 on success and 0 when out of memory,
+// in which case the mesh is left untouched.
+
+// Reorders triangles for post-transform cache reuse (Tipsify, Sander
+// et al. 2007), tuned for a VCACHE_FIFO_SIZE entry FIFO cache
+int mesh_optimize_vertex_cache(IndexedMesh* mesh);
+
+// Renumbers vertices in first-use order of the index buffer, so the
+// vertex fetch walks memory mostly forward. Run after the cache pass.
+// Meshes whose vertices already sit in a coherent order (grids, rings)
+// can fetch worse after it, so the new order is only kept when the
+// simulated overfetch does not go up.
+int mesh_optimize_vertex_fetch(IndexedMesh* mesh);
+
+#endif
@@ -0,0 +1,121 @@
+#include "mesh_quantize.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int clamp_int(int value, int low, int high) {
+    return value < low ? low : value > high ? high : value;
+}
+
+// Round to nearest signed normalized value with `bits` bits
+static int quantize_snorm(float value, int bits) {
+    int max = (1 << (bits - 1)) - 1;
+    float scaled = value * (float)max;
+    return clamp_int((int)(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f), -max, max);
+}
+
+// Decoding follows the GL 4.2+ rule (c / max, clamped to -1), which is
+// what current drivers implement even in 3.3 contexts
+static float dequantize_snorm(int value, int bits) {
+    int max = (1 << (bits - 1)) - 1;
+    float result = (float)value / (float)max;
+    return result < -1.0f ? -1.0f : result;
+}
+
+static uint32_t pack_normal_2_10_10_10(float x, float y, float z) {
+    uint32_t packed = 0;
+    packed |= (uint32_t)(quantize_snorm(x, 10) & 0x3ff);
+    packed |= (uint32_t)(quantize_snorm(y, 10) & 0x3ff) << 10;
+    packed |= (uint32_t)(quantize_snorm(z, 10) & 0x3ff) << 20;
+    return packed; // w = 0
+}
+
+static int sign_extend_10(uint32_t bits) {
+    return (bits & 0x200) ? (int)bits - 0x400 : (int)bits;
+}
+
+void* mesh_quantize_vertices(const IndexedMesh* mesh, MeshBuffers* buffers, QuantizeStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    unsigned char* packed = malloc((size_t)PACKED_VERTEX_BYTES * (mesh->vertex_count ? mesh->vertex_count : 1));
+    if (!packed) {
+        printf("WARNING: Out of memory, vertex quantization skipped\n");
+        return NULL;
+    }
+
+    // AABB center and half extent become the decode offset and scale
+    float low[3] = { 0.0f, 0.0f, 0.0f }, high[3] = { 0.0f, 0.0f, 0.0f };
+    for (unsigned int v = 0; v < mesh->vertex_count; v++) {
+        const float* src = &mesh->vertices[(size_t)v * INDEXED_VERTEX_FLOATS];
+        for (int i = 0; i < 3; i++) {
+            if (v == 0 || src[i] < low[i]) low[i] = src[i];
+            if (v == 0 || src[i] > high[i]) high[i] = src[i];
+        }
+    }
+    double diagonal = 0.0;
+    for (int i = 0; i < 3; i++) {
+        float half_extent = (high[i] - low[i]) * 0.5f;
+        buffers->position_offset[i] = low[i] + half_extent;
+        buffers->position_scale[i] = half_extent > 0.0f ? half_extent : 1.0f;
+        diagonal += (double)(high[i] - low[i]) * (high[i] - low[i]);
+    }
+    diagonal = sqrt(diagonal);
+
+    double min_normal_cos = 1.0;
+    for (unsigned int v = 0; v < mesh->vertex_count; v++) {
+        const float* src = &mesh->vertices[(size_t)v * INDEXED_VERTEX_FLOATS];
+        unsigned char* dst = &packed[(size_t)v * PACKED_VERTEX_BYTES];
+
+        int16_t position[4] = { 0, 0, 0, 0 };
+        double error_sq = 0.0;
+        for (int i = 0; i < 3; i++) {
+            float local = (src[i] - buffers->position_offset[i]) / buffers->position_scale[i];
+            int q = quantize_snorm(local, 16);
+            position[i] = (int16_t)q;
+            float decoded = dequantize_snorm(q, 16) * buffers->position_scale[i] + buffers->position_offset[i];
+            error_sq += (double)(decoded - src[i]) * (decoded - src[i]);
+        }
+        double error = sqrt(error_sq);
+        if (error > stats->max_position_error) stats->max_position_error = error;
+
+        // Normals are renormalized before packing so the error is pure quantization
+        float nx = src[3], ny = src[4], nz = src[5];
+        float length = sqrtf(nx * nx + ny * ny + nz * nz);
+        if (length > 0.00001f) {
+            nx /= length;
+            ny /= length;
+            nz /= length;
+        }
+        uint32_t normal = pack_normal_2_10_10_10(nx, ny, nz);
+
+        float dx = dequantize_snorm(sign_extend_10(normal & 0x3ff), 10);
+        float dy = dequantize_snorm(sign_extend_10((normal >> 10) & 0x3ff), 10);
+        float dz = dequantize_snorm(sign_extend_10((normal >> 20) & 0x3ff), 10);
+        float decoded_length = sqrtf(dx * dx + dy * dy + dz * dz);
+        if (length > 0.00001f && decoded_length > 0.0f) {
+            double cos_angle = (nx * dx + ny * dy + nz * dz) / decoded_length;
+            if (cos_angle < min_normal_cos) min_normal_cos = cos_angle;
+        }
+
+        memcpy(dst, position, sizeof(position));
+        memcpy(dst + sizeof(position), &normal, sizeof(normal));
+    }
+
+    if (min_normal_cos > 1.0) min_normal_cos = 1.0;
+    stats->max_normal_error_degrees = acos(min_normal_cos) * 180.0 / 3.14159265358979;
+    stats->max_position_error_rel = diagonal > 0.0 ? stats->max_position_error / diagonal : 0.0;
+
+    buffers->vertices = packed;
+    buffers->vertex_count = mesh->vertex_count;
+    buffers->vertex_stride = PACKED_VERTEX_BYTES;
+    buffers->vertex_format = VERTEX_FORMAT_PACKED;
+
+    size_t float_bytes = sizeof(float) * INDEXED_VERTEX_FLOATS;
+    printf("Quantized vertices: %u -> %u bytes per vertex, %.1f KB saved\n", (unsigned int)float_bytes,
+        PACKED_VERTEX_BYTES, (double)(float_bytes - PACKED_VERTEX_BYTES) * mesh->vertex_count / 1024.0);
+    printf("Quantized vertices: max position error %g (%.2e of AABB diagonal), max normal error %.3f deg\n",
+        stats->max_position_error, stats->max_position_error_rel, stats->max_normal_error_degrees);
+    return packed;
+}
@@ -0,0 +1,29 @@
+#ifndef MESH_QUANTIZE_H
+#define MESH_QUANTIZE_H
+
+#include "mesh_index.h"
+
+//-------------------------------------------------------------//
+//                  Quantized vertex attributes                 //
+//-------------------------------------------------------------//
+// VERTEX_FORMAT_PACKED: positions as normalized int16 relative to the
+// mesh AABB (x, y, z, unused w) followed by the normal as one
+// GL_INT_2_10_10_10_REV word. 12 bytes per vertex instead of 24. The
+// vertex shader decodes positions with the offset/scale stored in
+// MeshBuffers; normals are decoded by the vertex fetch.
+
+#define PACKED_VERTEX_BYTES 12
+
+typedef struct {
+    double max_position_error;       // object space units
+    double max_position_error_rel;   // relative to the AABB diagonal
+    double max_normal_error_degrees;
+} QuantizeStats;
+
+// Packs the float vertices of `mesh` into a new malloc'ed block and
+// fills the decode transform of `buffers` (vertices, vertex_count,
+// vertex_stride, vertex_format, position_offset, position_scale).
+// Prints the error report. Returns the block or NULL when out of memory.
+void* mesh_quantize_vertices(const IndexedMesh* mesh, MeshBuffers* buffers, QuantizeStats* stats);
+
+#endif
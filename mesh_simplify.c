@@ -0,0 +1,514 @@
+#include "mesh_simplify.h"
+#include "parallel.h"
+#include "platform.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIMPLIFY_BOUNDARY_WEIGHT 10.0 // boundary planes against surface planes
+#define SIMPLIFY_MIN_NORMAL_DOT 0.2f  // cosine a moved triangle may turn by at most
+#define SIMPLIFY_PASS_SLACK 1.5       // a pass takes collapses up to this times the goal's cost
+#define SIMPLIFY_MIN_LOD_RATIO 0.9    // a level must drop at least 10% of the previous one
+
+//-------------------------------------------------------------//
+//                          Quadrics                            //
+//-------------------------------------------------------------//
+// Symmetric 4x4 matrix (upper triangle) summing squared distances to
+// weighted planes; weight is the total plane weight
+typedef struct {
+    double m[10];
+    double weight;
+} Quadric;
+
+static void quadric_add_plane(Quadric* q, double a, double b, double c, double d, double weight) {
+    q->m[0] += weight * a * a;
+    q->m[1] += weight * a * b;
+    q->m[2] += weight * a * c;
+    q->m[3] += weight * a * d;
+    q->m[4] += weight * b * b;
+    q->m[5] += weight * b * c;
+    q->m[6] += weight * b * d;
+    q->m[7] += weight * c * c;
+    q->m[8] += weight * c * d;
+    q->m[9] += weight * d * d;
+    q->weight += weight;
+}
+
+static void quadric_add(Quadric* q, const Quadric* other) {
+    for (int i = 0; i < 10; i++) q->m[i] += other->m[i];
+    q->weight += other->weight;
+}
+
+// Weighted mean squared distance of `p` to the planes
+static double quadric_error(const Quadric* q, const float* p) {
+    double x = p[0], y = p[1], z = p[2];
+    double e = q->m[0] * x * x + 2.0 * q->m[1] * x * y + 2.0 * q->m[2] * x * z + 2.0 * q->m[3] * x +
+        q->m[4] * y * y + 2.0 * q->m[5] * y * z + 2.0 * q->m[6] * y +
+        q->m[7] * z * z + 2.0 * q->m[8] * z + q->m[9];
+    if (e < 0.0) e = 0.0; // rounding
+    return q->weight > 0.0 ? e / q->weight : 0.0;
+}
+
+//-------------------------------------------------------------//
+//                         Mesh setup                           //
+//-------------------------------------------------------------//
+// Everything that only depends on the full mesh, shared read-only by
+// all levels
+typedef struct {
+    const IndexedMesh* mesh;
+    unsigned int* canonical;   // first vertex with the same position
+    unsigned char* locked;     // seam or non-manifold, never moves
+    Quadric* quadrics;
+} SimplifyShared;
+
+static const float* vertex_position(const IndexedMesh* mesh, unsigned int v) {
+    return mesh->vertices + (size_t)v * INDEXED_VERTEX_FLOATS;
+}
+
+static const float* vertex_normal(const IndexedMesh* mesh, unsigned int v) {
+    return mesh->vertices + (size_t)v * INDEXED_VERTEX_FLOATS + 3;
+}
+
+static void triangle_normal(const float* p0, const float* p1, const float* p2, double* n) {
+    double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+// qsort has no user pointer, so each record carries its own position
+typedef struct {
+    float position[3];
+    unsigned int vertex;
+} PositionKey;
+
+static int compare_positions(const void* a, const void* b) {
+    return memcmp(((const PositionKey*)a)->position, ((const PositionKey*)b)->position, sizeof(float) * 3);
+}
+
+// Vertex -> triangle lists in CSR form, over any vertex numbering
+typedef struct {
+    unsigned int* offsets;   // vertex_count + 1
+    unsigned int* triangles;
+    unsigned int max_degree;
+} Adjacency;
+
+static int adjacency_build(Adjacency* adjacency, const unsigned int* indices, unsigned int index_count,
+    const unsigned int* vertex_map, unsigned int vertex_count) {
+    unsigned int* offsets = adjacency->offsets;
+    memset(offsets, 0, sizeof(unsigned int) * (vertex_count + 1));
+    for (unsigned int i = 0; i < index_count; i++) {
+        unsigned int v = vertex_map ? vertex_map[indices[i]] : indices[i];
+        offsets[v + 1]++;
+    }
+    adjacency->max_degree = 0;
+    for (unsigned int v = 0; v < vertex_count; v++) {
+        if (offsets[v + 1] > adjacency->max_degree) adjacency->max_degree = offsets[v + 1];
+        offsets[v + 1] += offsets[v];
+    }
+    for (unsigned int i = 0; i < index_count; i++) {
+        unsigned int v = vertex_map ? vertex_map[indices[i]] : indices[i];
+        adjacency->triangles[offsets[v]++] = i / 3;
+    }
+    // The fill pass moved every offset to the next list's start
+    for (unsigned int v = vertex_count; v > 0; v--) offsets[v] = offsets[v - 1];
+    offsets[0] = 0;
+    return 1;
+}
+
+// Number of triangles around `a` that also use `b`, comparing through vertex_map
+static unsigned int edge_triangles(const Adjacency* adjacency, const unsigned int* indices, const unsigned int* vertex_map,
+    unsigned int a, unsigned int b) {
+    unsigned int count = 0;
+    for (unsigned int i = adjacency->offsets[a]; i < adjacency->offsets[a + 1]; i++) {
+        const unsigned int* corner = indices + (size_t)adjacency->triangles[i] * 3;
+        for (int k = 0; k < 3; k++) {
+            if (vertex_map[corner[k]] == b) {
+                count++;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+static void shared_free(SimplifyShared* shared) {
+    free(shared->canonical);
+    free(shared->locked);
+    free(shared->quadrics);
+    memset(shared, 0, sizeof(*shared));
+}
+
+static int shared_init(SimplifyShared* shared, const IndexedMesh* mesh) {
+    memset(shared, 0, sizeof(*shared));
+    shared->mesh = mesh;
+    unsigned int vertex_count = mesh->vertex_count;
+    shared->canonical = malloc(sizeof(unsigned int) * (vertex_count ? vertex_count : 1));
+    shared->locked = calloc(vertex_count ? vertex_count : 1, 1);
+    shared->quadrics = calloc(vertex_count ? vertex_count : 1, sizeof(Quadric));
+    PositionKey* order = malloc(sizeof(PositionKey) * (vertex_count ? vertex_count : 1));
+    Adjacency adjacency;
+    adjacency.offsets = malloc(sizeof(unsigned int) * (vertex_count + 1));
+    adjacency.triangles = malloc(sizeof(unsigned int) * (mesh->index_count ? mesh->index_count : 1));
+    if (!shared->canonical || !shared->locked || !shared->quadrics || !order || !adjacency.offsets || !adjacency.triangles) {
+        free(order);
+        free(adjacency.offsets);
+        free(adjacency.triangles);
+        shared_free(shared);
+        return 0;
+    }
+
+    // Vertices sharing a position: a normal seam, locked so the crease stays
+    for (unsigned int v = 0; v < vertex_count; v++) {
+        memcpy(order[v].position, vertex_position(mesh, v), sizeof(float) * 3);
+        order[v].vertex = v;
+    }
+    qsort(order, vertex_count, sizeof(PositionKey), compare_positions);
+    for (unsigned int i = 0; i < vertex_count;) {
+        unsigned int j = i + 1;
+        while (j < vertex_count && compare_positions(&order[i], &order[j]) == 0) j++;
+        unsigned int first = order[i].vertex;
+        for (unsigned int k = i; k < j; k++) {
+            if (order[k].vertex < first) first = order[k].vertex;
+        }
+        for (unsigned int k = i; k < j; k++) {
+            shared->canonical[order[k].vertex] = first;
+            if (j - i > 1) shared->locked[order[k].vertex] = 1;
+        }
+        i = j;
+    }
+    free(order);
+
+    // Surface planes, weighted by triangle area
+    adjacency_build(&adjacency, mesh->indices, mesh->index_count, shared->canonical, vertex_count);
+    for (unsigned int t = 0; t < mesh->index_count / 3; t++) {
+        const unsigned int* corner = mesh->indices + (size_t)t * 3;
+        const float* p[3] = { vertex_position(mesh, corner[0]), vertex_position(mesh, corner[1]), vertex_position(mesh, corner[2]) };
+        double n[3];
+        triangle_normal(p[0], p[1], p[2], n);
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length <= 0.0) continue;
+        for (int k = 0; k < 3; k++) n[k] /= length;
+        double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+        for (int k = 0; k < 3; k++) quadric_add_plane(&shared->quadrics[corner[k]], n[0], n[1], n[2], d, length * 0.5);
+
+        // Open edges get a plane through them, perpendicular to the
+        // surface, so the outline resists moving sideways. Edges used by
+        // more than two triangles pin their ends.
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = corner[k], b = corner[(k + 1) % 3];
+            unsigned int uses = edge_triangles(&adjacency, mesh->indices, shared->canonical, shared->canonical[a], shared->canonical[b]);
+            if (uses > 2) {
+                shared->locked[a] = shared->locked[b] = 1;
+            }
+            else if (uses == 1) {
+                const float* pa = vertex_position(mesh, a);
+                const float* pb = vertex_position(mesh, b);
+                double e[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+                double edge_length2 = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+                double q[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+                double q_length = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+                if (q_length <= 0.0) continue;
+                for (int i = 0; i < 3; i++) q[i] /= q_length;
+                double qd = -(q[0] * pa[0] + q[1] * pa[1] + q[2] * pa[2]);
+                quadric_add_plane(&shared->quadrics[a], q[0], q[1], q[2], qd, SIMPLIFY_BOUNDARY_WEIGHT * edge_length2);
+                quadric_add_plane(&shared->quadrics[b], q[0], q[1], q[2], qd, SIMPLIFY_BOUNDARY_WEIGHT * edge_length2);
+            }
+        }
+    }
+    free(adjacency.offsets);
+    free(adjacency.triangles);
+    return 1;
+}
+
+//-------------------------------------------------------------//
+//                        Collapse passes                       //
+//-------------------------------------------------------------//
+typedef struct {
+    double cost;
+    unsigned int from;
+    unsigned int to;
+} Collapse;
+
+static int compare_collapses(const void* a, const void* b) {
+    double ca = ((const Collapse*)a)->cost, cb = ((const Collapse*)b)->cost;
+    return ca < cb ? -1 : ca > cb ? 1 : 0;
+}
+
+// Error of moving `from` onto `to`: its planes, plus a term for the
+// normal it gives up, scaled by how far it moves
+static double collapse_cost(const SimplifyShared* shared, const Quadric* quadrics, unsigned int from, unsigned int to) {
+    const IndexedMesh* mesh = shared->mesh;
+    const float* p_from = vertex_position(mesh, from);
+    const float* p_to = vertex_position(mesh, to);
+    const float* n_from = vertex_normal(mesh, from);
+    const float* n_to = vertex_normal(mesh, to);
+    double dx = p_to[0] - p_from[0], dy = p_to[1] - p_from[1], dz = p_to[2] - p_from[2];
+    double normal_dot = n_from[0] * n_to[0] + n_from[1] * n_to[1] + n_from[2] * n_to[2];
+    return quadric_error(&quadrics[from], p_to) + (1.0 - normal_dot) * 0.5 * (dx * dx + dy * dy + dz * dz);
+}
+
+// 1 when moving `from` onto `to` would flip or sharply turn one of the
+// triangles that survive the collapse
+static int collapse_flips(const IndexedMesh* mesh, const Adjacency* adjacency, const unsigned int* indices,
+    unsigned int from, unsigned int to) {
+    const float* p_to = vertex_position(mesh, to);
+    for (unsigned int i = adjacency->offsets[from]; i < adjacency->offsets[from + 1]; i++) {
+        const unsigned int* corner = indices + (size_t)adjacency->triangles[i] * 3;
+        if (corner[0] == to || corner[1] == to || corner[2] == to) continue; // removed by the collapse
+
+        const float* before[3];
+        const float* after[3];
+        for (int k = 0; k < 3; k++) {
+            before[k] = vertex_position(mesh, corner[k]);
+            after[k] = corner[k] == from ? p_to : before[k];
+        }
+        double n0[3], n1[3];
+        triangle_normal(before[0], before[1], before[2], n0);
+        triangle_normal(after[0], after[1], after[2], n1);
+        double l0 = sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+        double l1 = sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+        if (l1 <= 0.0) return 1;
+        if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] < SIMPLIFY_MIN_NORMAL_DOT * l0 * l1) return 1;
+    }
+    return 0;
+}
+
+static unsigned int simplify_with(const SimplifyShared* shared, unsigned int target_index_count, unsigned int* out_indices, float* out_error) {
+    const IndexedMesh* mesh = shared->mesh;
+    unsigned int vertex_count = mesh->vertex_count;
+    unsigned int index_count = mesh->index_count;
+    *out_error = 0.0f;
+
+    unsigned int* indices = malloc(sizeof(unsigned int) * (index_count ? index_count : 1));
+    Quadric* quadrics = malloc(sizeof(Quadric) * (vertex_count ? vertex_count : 1));
+    unsigned int* remap = malloc(sizeof(unsigned int) * (vertex_count ? vertex_count : 1));
+    unsigned char* touched = malloc(vertex_count ? vertex_count : 1);
+    Collapse* candidates = malloc(sizeof(Collapse) * (vertex_count ? vertex_count : 1));
+    Adjacency adjacency;
+    adjacency.offsets = malloc(sizeof(unsigned int) * (vertex_count + 1));
+    adjacency.triangles = malloc(sizeof(unsigned int) * (index_count ? index_count : 1));
+    if (!indices || !quadrics || !remap || !touched || !candidates || !adjacency.offsets || !adjacency.triangles) {
+        free(indices);
+        free(quadrics);
+        free(remap);
+        free(touched);
+        free(candidates);
+        free(adjacency.offsets);
+        free(adjacency.triangles);
+        memcpy(out_indices, mesh->indices, sizeof(unsigned int) * index_count);
+        return index_count;
+    }
+    memcpy(indices, mesh->indices, sizeof(unsigned int) * index_count);
+    memcpy(quadrics, shared->quadrics, sizeof(Quadric) * vertex_count);
+
+    double max_cost = 0.0;
+    while (index_count > target_index_count) {
+        adjacency_build(&adjacency, indices, index_count, NULL, vertex_count);
+
+        // Cheapest allowed collapse of every free vertex
+        unsigned int candidate_count = 0;
+        for (unsigned int from = 0; from < vertex_count; from++) {
+            if (shared->locked[from] || adjacency.offsets[from] == adjacency.offsets[from + 1]) continue;
+
+            // Open vertices may only slide along an open edge; edges
+            // made non-manifold by earlier collapses pin the vertex
+            int boundary = 0, pinned = 0;
+            for (unsigned int i = adjacency.offsets[from]; i < adjacency.offsets[from + 1] && !pinned; i++) {
+                const unsigned int* corner = indices + (size_t)adjacency.triangles[i] * 3;
+                for (int k = 0; k < 3; k++) {
+                    if (corner[k] == from) continue;
+                    unsigned int uses = edge_triangles(&adjacency, indices, shared->canonical, from, shared->canonical[corner[k]]);
+                    if (uses == 1) boundary = 1;
+                    if (uses > 2) pinned = 1;
+                }
+            }
+            if (pinned) continue;
+
+            Collapse best = { 1e300, from, from };
+            for (unsigned int i = adjacency.offsets[from]; i < adjacency.offsets[from + 1]; i++) {
+                const unsigned int* corner = indices + (size_t)adjacency.triangles[i] * 3;
+                for (int k = 0; k < 3; k++) {
+                    unsigned int to = corner[k];
+                    if (to == from) continue;
+                    if (boundary && edge_triangles(&adjacency, indices, shared->canonical, from, shared->canonical[to]) != 1) continue;
+                    double cost = collapse_cost(shared, quadrics, from, to);
+                    if (cost < best.cost) {
+                        best.cost = cost;
+                        best.to = to;
+                    }
+                }
+            }
+            if (best.to != from) candidates[candidate_count++] = best;
+        }
+        if (candidate_count == 0) break;
+        qsort(candidates, candidate_count, sizeof(Collapse), compare_collapses);
+
+        // Each collapse removes about two triangles. Going far past the
+        // cost of the goal-th candidate in one pass would take expensive
+        // collapses before cheaper ones have been exposed.
+        unsigned int goal = (index_count - target_index_count) / 6 + 1;
+        double cost_limit = candidates[(goal < candidate_count ? goal : candidate_count) - 1].cost * SIMPLIFY_PASS_SLACK;
+
+        for (unsigned int v = 0; v < vertex_count; v++) remap[v] = v;
+        memset(touched, 0, vertex_count);
+        unsigned int remaining = index_count;
+        unsigned int collapses = 0;
+        for (unsigned int c = 0; c < candidate_count && remaining > target_index_count; c++) {
+            const Collapse* collapse = &candidates[c];
+            if (collapse->cost > cost_limit && collapses > 0) break;
+            if (touched[collapse->from] || touched[collapse->to]) continue;
+            if (collapse_flips(mesh, &adjacency, indices, collapse->from, collapse->to)) continue;
+
+            // Neighbours stay put for the rest of the pass, so the flip
+            // tests above remain valid
+            for (unsigned int i = adjacency.offsets[collapse->from]; i < adjacency.offsets[collapse->from + 1]; i++) {
+                const unsigned int* corner = indices + (size_t)adjacency.triangles[i] * 3;
+                if (corner[0] == collapse->to || corner[1] == collapse->to || corner[2] == collapse->to) remaining -= 3;
+                for (int k = 0; k < 3; k++) touched[corner[k]] = 1;
+            }
+            remap[collapse->from] = collapse->to;
+            quadric_add(&quadrics[collapse->to], &quadrics[collapse->from]);
+            if (collapse->cost > max_cost) max_cost = collapse->cost;
+            collapses++;
+        }
+        if (collapses == 0) break;
+
+        // Apply the pass and drop the triangles that became degenerate
+        unsigned int write = 0;
+        for (unsigned int i = 0; i < index_count; i += 3) {
+            unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (a == b || b == c || a == c) continue;
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        index_count = write;
+    }
+
+    memcpy(out_indices, indices, sizeof(unsigned int) * index_count);
+    *out_error = (float)sqrt(max_cost);
+    free(indices);
+    free(quadrics);
+    free(remap);
+    free(touched);
+    free(candidates);
+    free(adjacency.offsets);
+    free(adjacency.triangles);
+    return index_count;
+}
+
+unsigned int mesh_simplify(const IndexedMesh* mesh, unsigned int target_index_count, unsigned int* indices, float* error) {
+    SimplifyShared shared;
+    if (!shared_init(&shared, mesh)) {
+        memcpy(indices, mesh->indices, sizeof(unsigned int) * mesh->index_count);
+        *error = 0.0f;
+        return mesh->index_count;
+    }
+    unsigned int count = simplify_with(&shared, target_index_count, indices, error);
+    shared_free(&shared);
+    return count;
+}
+
+//-------------------------------------------------------------//
+//                          LOD chain                           //
+//-------------------------------------------------------------//
+typedef struct {
+    const SimplifyShared* shared;
+    unsigned int* indices[MESH_MAX_LODS];
+    unsigned int index_count[MESH_MAX_LODS];
+    float error[MESH_MAX_LODS];
+    double seconds[MESH_MAX_LODS];
+} LodJob;
+
+static void lod_task(void* user, int index) {
+    LodJob* job = user;
+    int level = index + 1;
+    if (!job->indices[level]) return;
+    double start = platform_time_seconds();
+    unsigned int target = job->shared->mesh->index_count / 3 >> level;
+    job->index_count[level] = simplify_with(job->shared, target * 3, job->indices[level], &job->error[level]);
+    job->seconds[level] = platform_time_seconds() - start;
+}
+
+unsigned int mesh_build_lods(IndexedMesh* mesh, MeshLod* lods) {
+    memset(lods, 0, sizeof(MeshLod) * MESH_MAX_LODS);
+    lods[0].index_count = mesh->index_count;
+    double start = platform_time_seconds();
+
+    SimplifyShared shared;
+    if (!shared_init(&shared, mesh)) {
+        printf("WARNING: Out of memory for LOD generation\n");
+        return 1;
+    }
+    LodJob job;
+    memset(&job, 0, sizeof(job));
+    job.shared = &shared;
+    for (int level = 1; level < MESH_MAX_LODS; level++) {
+        job.indices[level] = malloc(sizeof(unsigned int) * (mesh->index_count ? mesh->index_count : 1));
+    }
+    parallel_for(MESH_MAX_LODS - 1, lod_task, &job);
+    shared_free(&shared);
+
+    // Keep levels while each is clearly smaller than the one before;
+    // errors are made monotonic so selection can stop at the first miss
+    unsigned int lod_count = 1;
+    unsigned int total = mesh->index_count;
+    for (int level = 1; level < MESH_MAX_LODS; level++) {
+        if (!job.indices[level] || job.index_count[level] == 0) break;
+        if (job.index_count[level] > lods[lod_count - 1].index_count * SIMPLIFY_MIN_LOD_RATIO) break;
+        lods[lod_count].first_index = total;
+        lods[lod_count].index_count = job.index_count[level];
+        lods[lod_count].error = job.error[level] > lods[lod_count - 1].error ? job.error[level] : lods[lod_count - 1].error;
+        total += job.index_count[level];
+        lod_count++;
+    }
+
+    unsigned int* grown = lod_count > 1 ? realloc(mesh->indices, sizeof(unsigned int) * total) : NULL;
+    if (lod_count > 1 && !grown) {
+        printf("WARNING: Out of memory for LOD indices\n");
+        lod_count = 1;
+    }
+    if (lod_count > 1) {
+        mesh->indices = grown;
+        for (unsigned int level = 1; level < lod_count; level++) {
+            memcpy(mesh->indices + lods[level].first_index, job.indices[level], sizeof(unsigned int) * lods[level].index_count);
+        }
+        mesh->index_count = total;
+    }
+    for (int level = 1; level < MESH_MAX_LODS; level++) free(job.indices[level]);
+
+    // Error relative to the model size as well, so scans of any scale compare
+    float low[3] = { 1e30f, 1e30f, 1e30f }, high[3] = { -1e30f, -1e30f, -1e30f };
+    for (unsigned int v = 0; v < mesh->vertex_count; v++) {
+        const float* p = vertex_position(mesh, v);
+        for (int k = 0; k < 3; k++) {
+            if (p[k] < low[k]) low[k] = p[k];
+            if (p[k] > high[k]) high[k] = p[k];
+        }
+    }
+    double extent = 0.0;
+    for (int k = 0; k < 3; k++) extent += (double)(high[k] - low[k]) * (high[k] - low[k]);
+    extent = sqrt(extent);
+
+    printf("LOD chain: %u levels in %.3f ms (%d threads)\n", lod_count, (platform_time_seconds() - start) * 1000.0, parallel_thread_count());
+    for (unsigned int level = 0; level < lod_count; level++) {
+        printf("  LOD %u: %8u triangles (%5.1f%%), error %.5f (%.3f%% of the model size), %.3f ms\n", level,
+            lods[level].index_count / 3, 100.0 * lods[level].index_count / lods[0].index_count, lods[level].error,
+            extent > 0.0 ? 100.0 * lods[level].error / extent : 0.0, job.seconds[level] * 1000.0);
+    }
+    return lod_count;
+}
+
+unsigned int mesh_lod_select(const MeshLod* lods, unsigned int lod_count, float distance,
+    const float* projection, float viewport_height, float max_pixels) {
+    // projection[5] is 1 / tan(fovy / 2)
+    if (distance < 1e-4f) distance = 1e-4f;
+    float pixels_per_unit = projection[5] * viewport_height * 0.5f / distance;
+    unsigned int level = 0;
+    while (level + 1 < lod_count && lods[level + 1].error * pixels_per_unit <= max_pixels) level++;
+    return level;
+}
@@ -0,0 +1,39 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include "mesh_index.h"
+
+//-------------------------------------------------------------//
+//                    Quadric simplification                    //
+//-------------------------------------------------------------//
+// Edge collapse ordered by the quadric error metric (Garland and
+// Heckbert 1997). Vertices only ever collapse onto one of their
+// neighbours, so a simplified level is just another index list over the
+// same vertex buffer. Open boundaries only slide along themselves and
+// are held by extra perpendicular quadrics. Vertices split by a normal
+// seam or a non-manifold edge never move, and collapses that flip a
+// triangle or bend the normal too far are rejected.
+
+// Simplifies the triangles of `mesh` towards target_index_count.
+// `indices` receives at most mesh->index_count indices. Returns the
+// index count reached; *error gets the largest distance, in object
+// units, between a moved vertex and the planes it stood for.
+unsigned int mesh_simplify(const IndexedMesh* mesh, unsigned int target_index_count, unsigned int* indices, float* error);
+
+//-------------------------------------------------------------//
+//                          LOD chain                           //
+//-------------------------------------------------------------//
+// Appends MESH_MAX_LODS - 1 levels at 1/2, 1/4, ... of the triangles
+// to mesh->indices. Each level is simplified from the full mesh as its
+// own task on the thread pool. Fills `lods` (level 0 is the original)
+// and prints the error against the reduction. Returns the level count,
+// 1 when nothing could be simplified or out of memory.
+unsigned int mesh_build_lods(IndexedMesh* mesh, MeshLod* lods);
+
+// Coarsest level whose error, projected at `distance` from the camera,
+// stays within max_pixels. projection is the matrix from
+// mat4_perspective and viewport_height is in pixels.
+unsigned int mesh_lod_select(const MeshLod* lods, unsigned int lod_count, float distance,
+    const float* projection, float viewport_height, float max_pixels);
+
+#endif
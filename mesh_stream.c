@@ -0,0 +1,1000 @@
+#include "mesh_stream.h"
+#include "mesh_index.h"
+#include "obj_loader.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------//
+//                         File layout                          //
+//-------------------------------------------------------------//
+//   StreamFileHeader
+//   StreamChunkRecord per chunk
+//   per chunk, padded to 16 bytes: float vertices, then 16-bit indices
+
+#define STREAM_FILE_MAGIC "OGLCSTRM"
+#define STREAM_FILE_VERSION 1
+#define STREAM_FILE_ENDIAN 0x01020304u
+#define STREAM_FILE_ALIGN 16
+#define STREAM_VERTEX_BYTES (sizeof(float) * INDEXED_VERTEX_FLOATS)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t header_size;
+    uint32_t chunk_count;
+
+    uint64_t source_size;
+    int64_t source_mtime;
+
+    uint64_t vertex_count;   // over all chunks
+    uint64_t triangle_count;
+    float bounds_min[3];
+    float bounds_max[3];
+    float bounds_center[3];
+    float bounds_radius;
+    uint64_t file_size;
+} StreamFileHeader;
+
+typedef struct {
+    float bounds_min[3];
+    float bounds_max[3];
+    float bounds_center[3];
+    float bounds_radius;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint64_t offset;
+} StreamChunkRecord;
+
+static int chunk_file_path(const char* obj_path, char* out, size_t out_size) {
+    int written = snprintf(out, out_size, "%s.meshchunks", obj_path);
+    return written > 0 && (size_t)written < out_size;
+}
+
+static uint64_t align_up(uint64_t value) {
+    return (value + STREAM_FILE_ALIGN - 1) & ~(uint64_t)(STREAM_FILE_ALIGN - 1);
+}
+
+static size_t chunk_bytes(unsigned int vertex_count, unsigned int index_count) {
+    return (size_t)vertex_count * STREAM_VERTEX_BYTES + (size_t)index_count * sizeof(unsigned short);
+}
+
+static void bounds_store(const Bounds* bounds, float* min, float* max, float* center, float* radius) {
+    memcpy(min, &bounds->min, sizeof(float) * 3);
+    memcpy(max, &bounds->max, sizeof(float) * 3);
+    memcpy(center, &bounds->center, sizeof(float) * 3);
+    *radius = bounds->radius;
+}
+
+static void bounds_load(Bounds* bounds, const float* min, const float* max, const float* center, float radius) {
+    memcpy(&bounds->min, min, sizeof(float) * 3);
+    memcpy(&bounds->max, max, sizeof(float) * 3);
+    memcpy(&bounds->center, center, sizeof(float) * 3);
+    bounds->radius = radius;
+}
+
+//-------------------------------------------------------------//
+//                         Chunk build                          //
+//-------------------------------------------------------------//
+// Out of core, so meshes larger than memory can be chunked:
+//   1. the OBJ is streamed once into flat position, normal and
+//      triangle files next to the output, which are then mapped
+//   2. a sample of the triangle centroids places median planes that
+//      cut the mesh into spatial buckets of about
+//      STREAM_BUCKET_TRIANGLES triangles
+//   3. every triangle is appended to its bucket in a bucket file
+//   4. each bucket on its own is split into chunks and deduplicated
+// Only one bucket is held in memory at a time. Median splits along the
+// longest axis give balanced pieces, and tight ones even for flat
+// meshes like terrain where a uniform grid would waste cells.
+
+#define STREAM_BUCKET_TRIANGLES (STREAM_CHUNK_TRIANGLES * 16)
+#define STREAM_BUCKET_MAX_DEPTH 12    // at most 4096 buckets
+#define STREAM_BUCKET_BLOCK 256       // triangles buffered per bucket between writes
+#define STREAM_SAMPLE_COUNT 65536
+#define STREAM_DEDUP_SLOTS (1u << 17) // twice the most corners a chunk can have
+#define STREAM_EMPTY_SLOT 0xffffffffu
+
+enum {
+    TEMP_POSITIONS,
+    TEMP_NORMALS,
+    TEMP_FACES,
+    TEMP_BUCKETS,
+    TEMP_OUTPUT,
+    TEMP_COUNT
+};
+
+typedef struct {
+    // Pass 1: the source as flat arrays, then mapped
+    FILE* positions;
+    FILE* normals;
+    FILE* faces;
+    unsigned int vertex_count;
+    unsigned int normal_count;
+    unsigned int face_count;
+    MappedFile position_file;
+    MappedFile normal_file;
+    MappedFile face_file;
+    const Vec3* position;
+    const Vec3* normal;
+    const Face* face;
+
+    // Pass 2: complete tree of planes, node i has children 2i + 1 and 2i + 2
+    int depth;
+    int bucket_count;
+    int* plane_axis;
+    float* plane_value;
+
+    // Pass 3: each bucket is a list of blocks in the bucket file
+    MappedFile bucket_file;
+    unsigned int* bucket_total;       // triangles
+    uint64_t** bucket_block;          // file offsets, in write order
+    unsigned int* bucket_block_count;
+    unsigned int* bucket_block_capacity;
+} ChunkBuild;
+
+typedef struct {
+    float* centroid[3];
+    unsigned int* triangles;
+    unsigned int* leaf_first;   // ranges of `triangles`, one per chunk
+    unsigned int* leaf_count;
+    unsigned int leaf_total;
+} ChunkSplit;
+
+static void temp_file_path(const char* path, int kind, char* out, size_t out_size) {
+    static const char* const suffix[TEMP_COUNT] = { ".positions.tmp", ".normals.tmp", ".faces.tmp", ".buckets.tmp", ".tmp" };
+    snprintf(out, out_size, "%s%s", path, suffix[kind]);
+}
+
+static Vec3 face_centroid(const Vec3* position, const Face* face) {
+    Vec3 a = position[face->v_idx[0]], b = position[face->v_idx[1]], c = position[face->v_idx[2]];
+    Vec3 centroid = { (a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f };
+    return centroid;
+}
+
+// Quickselect: afterwards triangles[first, first + k) all have a
+// centroid[axis] no larger than those after
+static void select_kth(const float* key, unsigned int* triangles, int first, int count, int k) {
+    int lo = first, hi = first + count - 1, target = first + k;
+    while (lo < hi) {
+        float pivot = key[triangles[lo + (hi - lo) / 2]];
+        int i = lo, j = hi;
+        while (i <= j) {
+            while (key[triangles[i]] < pivot) i++;
+            while (key[triangles[j]] > pivot) j--;
+            if (i <= j) {
+                unsigned int t = triangles[i];
+                triangles[i] = triangles[j];
+                triangles[j] = t;
+                i++;
+                j--;
+            }
+        }
+        if (target <= j) hi = j;
+        else if (target >= i) lo = i;
+        else break;
+    }
+}
+
+static int longest_axis(float* const centroid[3], const unsigned int* triangles, unsigned int first, unsigned int count) {
+    float low[3] = { 1e30f, 1e30f, 1e30f }, high[3] = { -1e30f, -1e30f, -1e30f };
+    for (unsigned int i = first; i < first + count; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            float c = centroid[axis][triangles[i]];
+            if (c < low[axis]) low[axis] = c;
+            if (c > high[axis]) high[axis] = c;
+        }
+    }
+    int axis = 0;
+    if (high[1] - low[1] > high[axis] - low[axis]) axis = 1;
+    if (high[2] - low[2] > high[axis] - low[axis]) axis = 2;
+    return axis;
+}
+
+static void split_range(ChunkSplit* split, unsigned int first, unsigned int count) {
+    // Iterative over an explicit stack; the depth is only log2 of the chunk count
+    unsigned int stack[64][2];
+    int top = 0;
+    stack[top][0] = first;
+    stack[top][1] = count;
+    top++;
+    while (top > 0) {
+        top--;
+        first = stack[top][0];
+        count = stack[top][1];
+        if (count <= STREAM_CHUNK_TRIANGLES || top + 2 > 64) {
+            split->leaf_first[split->leaf_total] = first;
+            split->leaf_count[split->leaf_total] = count;
+            split->leaf_total++;
+            continue;
+        }
+
+        int axis = longest_axis(split->centroid, split->triangles, first, count);
+        unsigned int half = count / 2;
+        select_kth(split->centroid[axis], split->triangles, (int)first, (int)count, (int)half);
+        stack[top][0] = first + half;
+        stack[top][1] = count - half;
+        top++;
+        stack[top][0] = first;
+        stack[top][1] = half;
+        top++;
+    }
+}
+
+// How many leaves split_range makes of `count` triangles
+static unsigned int split_leaf_count(unsigned int count) {
+    if (count <= STREAM_CHUNK_TRIANGLES) return 1;
+    return split_leaf_count(count / 2) + split_leaf_count(count - count / 2);
+}
+
+static int write_padding(FILE* file, uint64_t from, uint64_t to) {
+    static const char zeros[STREAM_FILE_ALIGN] = { 0 };
+    return to == from || fwrite(zeros, 1, (size_t)(to - from), file) == (size_t)(to - from);
+}
+
+//----------------- Pass 1: stream the source -----------------//
+static int source_vertex(void* user, Vec3 position) {
+    ChunkBuild* build = user;
+    build->vertex_count++;
+    return fwrite(&position, sizeof(Vec3), 1, build->positions) == 1;
+}
+
+static int source_normal(void* user, Vec3 normal) {
+    ChunkBuild* build = user;
+    build->normal_count++;
+    return fwrite(&normal, sizeof(Vec3), 1, build->normals) == 1;
+}
+
+static int source_face(void* user, const Face* face) {
+    ChunkBuild* build = user;
+    if (build->face_count == UINT_MAX) return 0;
+    build->face_count++;
+    return fwrite(face, sizeof(Face), 1, build->faces) == 1;
+}
+
+static int stream_source(ChunkBuild* build, const char* obj_path, char temp[TEMP_COUNT][1040]) {
+    build->positions = platform_fopen(temp[TEMP_POSITIONS], "wb");
+    build->normals = platform_fopen(temp[TEMP_NORMALS], "wb");
+    build->faces = platform_fopen(temp[TEMP_FACES], "wb");
+    int ok = build->positions && build->normals && build->faces;
+    if (ok) {
+        ObjStreamCallbacks callbacks = { build, source_vertex, source_normal, source_face };
+        ok = obj_stream(obj_path, &callbacks);
+    }
+    // Like the loader, a mesh without normals gets a single up normal
+    Vec3 up = { 0.0f, 0.0f, 1.0f };
+    if (ok && build->normal_count == 0) ok = source_normal(build, up);
+
+    if (build->positions && fclose(build->positions) != 0) ok = 0;
+    if (build->normals && fclose(build->normals) != 0) ok = 0;
+    if (build->faces && fclose(build->faces) != 0) ok = 0;
+    build->positions = build->normals = build->faces = NULL;
+
+    ok = ok && platform_map_file(temp[TEMP_POSITIONS], &build->position_file);
+    ok = ok && platform_map_file(temp[TEMP_NORMALS], &build->normal_file);
+    ok = ok && platform_map_file(temp[TEMP_FACES], &build->face_file);
+    if (!ok) {
+        printf("FATAL ERROR: Could not write the temporary mesh files next to %s\n", temp[TEMP_OUTPUT]);
+        return 0;
+    }
+    build->position = (const Vec3*)build->position_file.data;
+    build->normal = (const Vec3*)build->normal_file.data;
+    build->face = (const Face*)build->face_file.data;
+    return 1;
+}
+
+//----------------- Pass 2: place the buckets -----------------//
+static int plan_buckets(ChunkBuild* build) {
+    // Positive indices could only be checked once the counts were final
+    for (unsigned int t = 0; t < build->face_count; t++) {
+        for (int k = 0; k < 3; k++) {
+            if (build->face[t].v_idx[k] >= build->vertex_count || build->face[t].n_idx[k] >= build->normal_count) {
+                printf("FATAL ERROR: OBJ face %u references a vertex or normal that does not exist\n", t + 1);
+                return 0;
+            }
+        }
+    }
+
+    build->depth = 0;
+    while (build->depth < STREAM_BUCKET_MAX_DEPTH && (build->face_count >> build->depth) > STREAM_BUCKET_TRIANGLES) build->depth++;
+    build->bucket_count = 1 << build->depth;
+    if (build->depth == 0) return 1;
+
+    // Every stride-th triangle, so the planes are the same on every build
+    unsigned int stride = build->face_count / STREAM_SAMPLE_COUNT + 1;
+    unsigned int sample_count = (build->face_count + stride - 1) / stride;
+    int node_total = build->bucket_count - 1;
+    float* centroid[3];
+    for (int axis = 0; axis < 3; axis++) centroid[axis] = malloc(sizeof(float) * sample_count);
+    unsigned int* order = malloc(sizeof(unsigned int) * sample_count);
+    unsigned int* node_first = malloc(sizeof(unsigned int) * node_total);
+    unsigned int* node_count = malloc(sizeof(unsigned int) * node_total);
+    build->plane_axis = malloc(sizeof(int) * node_total);
+    build->plane_value = malloc(sizeof(float) * node_total);
+    int ok = centroid[0] && centroid[1] && centroid[2] && order && node_first && node_count && build->plane_axis &&
+        build->plane_value;
+
+    if (ok) {
+        for (unsigned int i = 0; i < sample_count; i++) {
+            Vec3 c = face_centroid(build->position, &build->face[(size_t)i * stride]);
+            centroid[0][i] = c.x;
+            centroid[1][i] = c.y;
+            centroid[2][i] = c.z;
+            order[i] = i;
+        }
+        node_first[0] = 0;
+        node_count[0] = sample_count;
+        for (int node = 0; node < node_total; node++) {
+            unsigned int first = node_first[node], count = node_count[node], half = count / 2;
+            int axis = longest_axis(centroid, order, first, count);
+            if (count > 0) select_kth(centroid[axis], order, (int)first, (int)count, (int)half);
+            build->plane_axis[node] = axis;
+            build->plane_value[node] = count > 0 ? centroid[axis][order[first + half]] : 0.0f;
+            if (2 * node + 2 < node_total) {
+                node_first[2 * node + 1] = first;
+                node_count[2 * node + 1] = half;
+                node_first[2 * node + 2] = first + half;
+                node_count[2 * node + 2] = count - half;
+            }
+        }
+    }
+    else {
+        printf("FATAL ERROR: Out of memory building mesh chunks\n");
+    }
+
+    for (int axis = 0; axis < 3; axis++) free(centroid[axis]);
+    free(order);
+    free(node_first);
+    free(node_count);
+    return ok;
+}
+
+static int bucket_of(const ChunkBuild* build, Vec3 centroid) {
+    const float c[3] = { centroid.x, centroid.y, centroid.z };
+    int node = 0;
+    for (int level = 0; level < build->depth; level++) {
+        node = 2 * node + (c[build->plane_axis[node]] < build->plane_value[node] ? 1 : 2);
+    }
+    return node - (build->bucket_count - 1);
+}
+
+//----------------- Pass 3: fill the buckets ------------------//
+static int write_block(ChunkBuild* build, FILE* file, uint64_t* position, int bucket, const Face* faces, unsigned int count) {
+    if (build->bucket_block_count[bucket] == build->bucket_block_capacity[bucket]) {
+        unsigned int capacity = build->bucket_block_capacity[bucket] ? build->bucket_block_capacity[bucket] * 2 : 16;
+        uint64_t* grown = realloc(build->bucket_block[bucket], sizeof(uint64_t) * capacity);
+        if (!grown) return 0;
+        build->bucket_block[bucket] = grown;
+        build->bucket_block_capacity[bucket] = capacity;
+    }
+    build->bucket_block[bucket][build->bucket_block_count[bucket]++] = *position;
+    *position += (uint64_t)count * sizeof(Face);
+    return fwrite(faces, sizeof(Face), count, file) == count;
+}
+
+static int fill_buckets(ChunkBuild* build, const char* bucket_path) {
+    int buckets = build->bucket_count;
+    Face* buffer = malloc(sizeof(Face) * STREAM_BUCKET_BLOCK * buckets);
+    unsigned int* buffered = calloc(buckets, sizeof(unsigned int));
+    build->bucket_total = calloc(buckets, sizeof(unsigned int));
+    build->bucket_block = calloc(buckets, sizeof(uint64_t*));
+    build->bucket_block_count = calloc(buckets, sizeof(unsigned int));
+    build->bucket_block_capacity = calloc(buckets, sizeof(unsigned int));
+    int ok = buffer && buffered && build->bucket_total && build->bucket_block && build->bucket_block_count &&
+        build->bucket_block_capacity;
+    if (!ok) printf("FATAL ERROR: Out of memory building mesh chunks\n");
+
+    FILE* file = ok ? platform_fopen(bucket_path, "wb") : NULL;
+    uint64_t position = 0;
+    int opened = ok && file != NULL;
+    ok = opened;
+    for (unsigned int t = 0; ok && t < build->face_count; t++) {
+        int bucket = bucket_of(build, face_centroid(build->position, &build->face[t]));
+        Face* block = buffer + (size_t)bucket * STREAM_BUCKET_BLOCK;
+        block[buffered[bucket]++] = build->face[t];
+        build->bucket_total[bucket]++;
+        if (buffered[bucket] == STREAM_BUCKET_BLOCK) {
+            ok = write_block(build, file, &position, bucket, block, STREAM_BUCKET_BLOCK);
+            buffered[bucket] = 0;
+        }
+    }
+    for (int bucket = 0; ok && bucket < buckets; bucket++) {
+        if (buffered[bucket]) ok = write_block(build, file, &position, bucket, buffer + (size_t)bucket * STREAM_BUCKET_BLOCK, buffered[bucket]);
+    }
+    if (file && fclose(file) != 0) ok = 0;
+    ok = ok && platform_map_file(bucket_path, &build->bucket_file);
+    if (opened && !ok) printf("FATAL ERROR: Could not write the temporary bucket file %s\n", bucket_path);
+
+    free(buffer);
+    free(buffered);
+    return ok;
+}
+
+static void load_bucket(const ChunkBuild* build, int bucket, Face* out) {
+    unsigned int remaining = build->bucket_total[bucket];
+    for (unsigned int b = 0; b < build->bucket_block_count[bucket]; b++) {
+        unsigned int count = remaining < STREAM_BUCKET_BLOCK ? remaining : STREAM_BUCKET_BLOCK;
+        memcpy(out + (size_t)b * STREAM_BUCKET_BLOCK, build->bucket_file.data + build->bucket_block[bucket][b], sizeof(Face) * count);
+        remaining -= count;
+    }
+}
+
+static void chunk_build_free(ChunkBuild* build, char temp[TEMP_COUNT][1040]) {
+    if (build->positions) fclose(build->positions);
+    if (build->normals) fclose(build->normals);
+    if (build->faces) fclose(build->faces);
+    platform_unmap_file(&build->position_file);
+    platform_unmap_file(&build->normal_file);
+    platform_unmap_file(&build->face_file);
+    platform_unmap_file(&build->bucket_file);
+    for (int kind = TEMP_POSITIONS; kind <= TEMP_BUCKETS; kind++) remove(temp[kind]);
+
+    free(build->plane_axis);
+    free(build->plane_value);
+    for (int bucket = 0; build->bucket_block && bucket < build->bucket_count; bucket++) free(build->bucket_block[bucket]);
+    free(build->bucket_block);
+    free(build->bucket_total);
+    free(build->bucket_block_count);
+    free(build->bucket_block_capacity);
+}
+
+//---------------- Pass 4: chunk every bucket -----------------//
+static int build_chunk_file(const char* obj_path, const char* path) {
+    double start_time = platform_time_seconds();
+    unsigned long long source_size;
+    long long source_mtime;
+    if (!platform_file_info(obj_path, &source_size, &source_mtime)) {
+        printf("FATAL ERROR: Could not open %s\n", obj_path);
+        return 0;
+    }
+
+    char temp[TEMP_COUNT][1040];
+    for (int kind = 0; kind < TEMP_COUNT; kind++) temp_file_path(path, kind, temp[kind], sizeof(temp[kind]));
+    ChunkBuild build;
+    memset(&build, 0, sizeof(build));
+    if (!stream_source(&build, obj_path, temp) || !plan_buckets(&build) || !fill_buckets(&build, temp[TEMP_BUCKETS])) {
+        chunk_build_free(&build, temp);
+        return 0;
+    }
+
+    // One bucket at a time, so everything here is sized by the largest
+    unsigned int largest = 0;
+    unsigned int chunk_count = 0;
+    for (int bucket = 0; bucket < build.bucket_count; bucket++) {
+        unsigned int total = build.bucket_total[bucket];
+        if (total > largest) largest = total;
+        if (total > 0) chunk_count += split_leaf_count(total);
+    }
+    ChunkSplit split;
+    memset(&split, 0, sizeof(split));
+    for (int axis = 0; axis < 3; axis++) split.centroid[axis] = malloc(sizeof(float) * (largest ? largest : 1));
+    split.triangles = malloc(sizeof(unsigned int) * (largest ? largest : 1));
+    split.leaf_first = malloc(sizeof(unsigned int) * (largest / (STREAM_CHUNK_TRIANGLES / 2) + 2));
+    split.leaf_count = malloc(sizeof(unsigned int) * (largest / (STREAM_CHUNK_TRIANGLES / 2) + 2));
+    Face* faces = malloc(sizeof(Face) * (largest ? largest : 1));
+    uint32_t* slots = malloc(sizeof(uint32_t) * STREAM_DEDUP_SLOTS);
+    uint32_t* slot_of = malloc(sizeof(uint32_t) * STREAM_CHUNK_TRIANGLES * 3);
+    uint64_t* keys = malloc(sizeof(uint64_t) * STREAM_CHUNK_TRIANGLES * 3);
+    float* chunk_vertices = malloc(STREAM_VERTEX_BYTES * STREAM_CHUNK_TRIANGLES * 3);
+    unsigned short* chunk_indices = malloc(sizeof(unsigned short) * STREAM_CHUNK_TRIANGLES * 3);
+    Vec3* points = malloc(sizeof(Vec3) * STREAM_CHUNK_TRIANGLES * 3);
+    StreamChunkRecord* records = calloc(chunk_count ? chunk_count : 1, sizeof(StreamChunkRecord));
+
+    int ok = split.centroid[0] && split.centroid[1] && split.centroid[2] && split.triangles && split.leaf_first &&
+        split.leaf_count && faces && slots && slot_of && keys && chunk_vertices && chunk_indices && points && records;
+    if (!ok) printf("FATAL ERROR: Out of memory building mesh chunks\n");
+    if (ok) {
+        for (unsigned int s = 0; s < STREAM_DEDUP_SLOTS; s++) slots[s] = STREAM_EMPTY_SLOT;
+    }
+
+    Bounds bounds;
+    bounds_from_points(&bounds, build.position, (int)build.vertex_count);
+    StreamFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STREAM_FILE_MAGIC, 8);
+    header.version = STREAM_FILE_VERSION;
+    header.endian = STREAM_FILE_ENDIAN;
+    header.header_size = sizeof(StreamFileHeader);
+    header.chunk_count = chunk_count;
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+    header.triangle_count = build.face_count;
+    bounds_store(&bounds, header.bounds_min, header.bounds_max, header.bounds_center, &header.bounds_radius);
+
+    // The table is written last, once every chunk's offset is known
+    FILE* file = ok ? platform_fopen(temp[TEMP_OUTPUT], "wb") : NULL;
+    uint64_t position = sizeof(StreamFileHeader) + (uint64_t)chunk_count * sizeof(StreamChunkRecord);
+    ok = ok && file != NULL;
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && (chunk_count == 0 || fwrite(records, sizeof(StreamChunkRecord), chunk_count, file) == chunk_count);
+
+    unsigned int chunk = 0;
+    for (int bucket = 0; ok && bucket < build.bucket_count; bucket++) {
+        unsigned int total = build.bucket_total[bucket];
+        if (total == 0) continue;
+        load_bucket(&build, bucket, faces);
+        for (unsigned int t = 0; t < total; t++) {
+            Vec3 c = face_centroid(build.position, &faces[t]);
+            split.centroid[0][t] = c.x;
+            split.centroid[1][t] = c.y;
+            split.centroid[2][t] = c.z;
+            split.triangles[t] = t;
+        }
+        split.leaf_total = 0;
+        split_range(&split, 0, total);
+
+        for (unsigned int leaf = 0; ok && leaf < split.leaf_total; leaf++) {
+            // Unique (position, normal) pairs, numbered in first-use order
+            unsigned int vertex_count = 0;
+            unsigned int index_count = 0;
+            for (unsigned int i = split.leaf_first[leaf]; i < split.leaf_first[leaf] + split.leaf_count[leaf]; i++) {
+                const Face* face = &faces[split.triangles[i]];
+                for (int k = 0; k < 3; k++) {
+                    uint64_t key = ((uint64_t)face->v_idx[k] << 32) | face->n_idx[k];
+                    uint32_t slot = (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> 40) & (STREAM_DEDUP_SLOTS - 1);
+                    while (slots[slot] != STREAM_EMPTY_SLOT && keys[slots[slot]] != key) slot = (slot + 1) & (STREAM_DEDUP_SLOTS - 1);
+                    if (slots[slot] == STREAM_EMPTY_SLOT) {
+                        Vec3 v = build.position[face->v_idx[k]];
+                        Vec3 n = build.normal[face->n_idx[k]];
+                        float* dst = chunk_vertices + (size_t)vertex_count * INDEXED_VERTEX_FLOATS;
+                        dst[0] = v.x;
+                        dst[1] = v.y;
+                        dst[2] = v.z;
+                        dst[3] = n.x;
+                        dst[4] = n.y;
+                        dst[5] = n.z;
+                        points[vertex_count] = v;
+                        keys[vertex_count] = key;
+                        slot_of[vertex_count] = slot;
+                        slots[slot] = vertex_count++;
+                    }
+                    chunk_indices[index_count++] = (unsigned short)slots[slot];
+                }
+            }
+            for (unsigned int v = 0; v < vertex_count; v++) slots[slot_of[v]] = STREAM_EMPTY_SLOT;
+
+            Bounds chunk_bounds;
+            bounds_from_points(&chunk_bounds, points, (int)vertex_count);
+            StreamChunkRecord* record = &records[chunk++];
+            bounds_store(&chunk_bounds, record->bounds_min, record->bounds_max, record->bounds_center, &record->bounds_radius);
+            record->vertex_count = vertex_count;
+            record->index_count = index_count;
+            record->offset = align_up(position);
+            header.vertex_count += vertex_count;
+
+            ok = ok && write_padding(file, position, record->offset);
+            ok = ok && fwrite(chunk_vertices, STREAM_VERTEX_BYTES, vertex_count, file) == vertex_count;
+            ok = ok && fwrite(chunk_indices, sizeof(unsigned short), index_count, file) == index_count;
+            position = record->offset + chunk_bytes(vertex_count, index_count);
+        }
+    }
+    header.file_size = position;
+    ok = ok && fseek(file, 0, SEEK_SET) == 0;
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && (chunk_count == 0 || fwrite(records, sizeof(StreamChunkRecord), chunk_count, file) == chunk_count);
+    if (file && fclose(file) != 0) ok = 0;
+    if (file && ok) ok = platform_replace_file(temp[TEMP_OUTPUT], path);
+    if (file && !ok) {
+        remove(temp[TEMP_OUTPUT]);
+        printf("FATAL ERROR: Could not write mesh chunks %s\n", path);
+    }
+    if (ok) {
+        printf("Mesh chunks: wrote %s, %u chunks of <= %d triangles from %d bucket%s (%.1f MB) in %.3f ms\n", path,
+            chunk_count, STREAM_CHUNK_TRIANGLES, build.bucket_count, build.bucket_count == 1 ? "" : "s",
+            (double)position / (1024.0 * 1024.0), (platform_time_seconds() - start_time) * 1000.0);
+    }
+
+    for (int axis = 0; axis < 3; axis++) free(split.centroid[axis]);
+    free(split.triangles);
+    free(split.leaf_first);
+    free(split.leaf_count);
+    free(faces);
+    free(slots);
+    free(slot_of);
+    free(keys);
+    free(chunk_vertices);
+    free(chunk_indices);
+    free(points);
+    free(records);
+    chunk_build_free(&build, temp);
+    return ok;
+}
+
+static int chunk_file_valid(const MappedFile* file, unsigned long long source_size, long long source_mtime) {
+    StreamFileHeader header;
+    if (file->size < sizeof(header)) return 0;
+    memcpy(&header, file->data, sizeof(header));
+    if (memcmp(header.magic, STREAM_FILE_MAGIC, 8) != 0) return 0;
+    if (header.version != STREAM_FILE_VERSION || header.endian != STREAM_FILE_ENDIAN) return 0;
+    if (header.header_size != sizeof(StreamFileHeader) || header.file_size != file->size) return 0;
+    if (header.source_size != source_size || header.source_mtime != source_mtime) return 0;
+    if (sizeof(StreamFileHeader) + (uint64_t)header.chunk_count * sizeof(StreamChunkRecord) > file->size) return 0;
+
+    for (uint32_t c = 0; c < header.chunk_count; c++) {
+        StreamChunkRecord record;
+        memcpy(&record, file->data + sizeof(StreamFileHeader) + (size_t)c * sizeof(StreamChunkRecord), sizeof(record));
+        if (record.vertex_count > 65536 || record.index_count > STREAM_CHUNK_TRIANGLES * 3) return 0;
+        if (record.offset % STREAM_FILE_ALIGN || record.offset + chunk_bytes(record.vertex_count, record.index_count) > file->size) return 0;
+    }
+    return 1;
+}
+
+//-------------------------------------------------------------//
+//                         Loader threads                       //
+//-------------------------------------------------------------//
+static void loader_main(void* user) {
+    MeshStream* stream = user;
+    platform_mutex_lock(stream->mutex);
+    for (;;) {
+        while (!stream->stopping && stream->queue_count == 0) platform_cond_wait(stream->wake, stream->mutex);
+        if (stream->stopping) break;
+        int index = stream->queue[stream->queue_head++];
+        stream->queue_count--;
+        stream->loading_count++;
+        StreamChunk* chunk = &stream->chunks[index];
+        chunk->state = STREAM_CHUNK_LOADING;
+        platform_mutex_unlock(stream->mutex);
+
+        // The page faults of the mapping land here instead of on the render thread
+        size_t bytes = chunk_bytes(chunk->vertex_count, chunk->index_count);
+        void* data = malloc(bytes ? bytes : 1);
+        if (data) memcpy(data, stream->file.data + chunk->offset, bytes);
+
+        platform_mutex_lock(stream->mutex);
+        stream->loading_count--;
+        platform_cond_broadcast(stream->arrived);
+        if (!data) {
+            chunk->state = STREAM_CHUNK_ON_DISK; // asked for again next frame
+            continue;
+        }
+        chunk->data = data;
+        chunk->state = STREAM_CHUNK_LOADED;
+        stream->loaded[stream->loaded_count++] = index;
+        stream->staging_bytes += bytes;
+        if (stream->staging_bytes > stream->staging_bytes_max) stream->staging_bytes_max = stream->staging_bytes;
+    }
+    platform_mutex_unlock(stream->mutex);
+}
+
+//-------------------------------------------------------------//
+//                         Open / close                         //
+//-------------------------------------------------------------//
+typedef struct {
+    float distance;
+    int chunk;
+} ChunkDistance;
+
+int mesh_stream_open(MeshStream* stream, const char* obj_path, unsigned long long budget_bytes) {
+    memset(stream, 0, sizeof(*stream));
+    char path[1024];
+    unsigned long long source_size;
+    long long source_mtime;
+    if (!chunk_file_path(obj_path, path, sizeof(path))) return 0;
+    if (!platform_file_info(obj_path, &source_size, &source_mtime)) {
+        printf("FATAL ERROR: Could not open %s\n", obj_path);
+        return 0;
+    }
+
+    int mapped = platform_map_file(path, &stream->file);
+    if (mapped && !chunk_file_valid(&stream->file, source_size, source_mtime)) {
+        printf("Mesh chunks: %s is stale, rebuilding\n", path);
+        platform_unmap_file(&stream->file);
+        mapped = 0;
+    }
+    if (!mapped) {
+        if (!build_chunk_file(obj_path, path) || !platform_map_file(path, &stream->file)) return 0;
+        if (!chunk_file_valid(&stream->file, source_size, source_mtime)) {
+            printf("FATAL ERROR: Mesh chunks %s do not match %s\n", path, obj_path);
+            platform_unmap_file(&stream->file);
+            return 0;
+        }
+    }
+
+    StreamFileHeader header;
+    memcpy(&header, stream->file.data, sizeof(header));
+    int count = (int)header.chunk_count;
+    size_t slots = count ? (size_t)count : 1;
+    stream->chunk_count = count;
+    stream->budget_bytes = budget_bytes;
+    bounds_load(&stream->bounds, header.bounds_min, header.bounds_max, header.bounds_center, header.bounds_radius);
+    stream->chunks = calloc(slots, sizeof(StreamChunk));
+    for (int i = 0; i < 3; i++) stream->center[i] = malloc(slots * sizeof(float));
+    stream->radius = malloc(slots * sizeof(float));
+    stream->visible = malloc(slots * sizeof(int));
+    stream->order = malloc(slots * sizeof(ChunkDistance));
+    stream->draw_list = malloc(slots * sizeof(int));
+    stream->queue = malloc(slots * sizeof(int));
+    stream->loaded = malloc(slots * sizeof(int));
+    stream->mutex = platform_mutex_create();
+    stream->wake = platform_cond_create();
+    stream->arrived = platform_cond_create();
+    if (!stream->chunks || !stream->center[0] || !stream->center[1] || !stream->center[2] || !stream->radius ||
+        !stream->visible || !stream->order || !stream->draw_list || !stream->queue || !stream->loaded ||
+        !stream->mutex || !stream->wake || !stream->arrived) {
+        printf("FATAL ERROR: Out of memory for %d mesh chunks\n", count);
+        mesh_stream_close(stream);
+        return 0;
+    }
+
+    size_t largest = 0;
+    for (int c = 0; c < count; c++) {
+        StreamChunkRecord record;
+        memcpy(&record, stream->file.data + sizeof(StreamFileHeader) + (size_t)c * sizeof(StreamChunkRecord), sizeof(record));
+        StreamChunk* chunk = &stream->chunks[c];
+        bounds_load(&chunk->bounds, record.bounds_min, record.bounds_max, record.bounds_center, record.bounds_radius);
+        chunk->offset = record.offset;
+        chunk->vertex_count = record.vertex_count;
+        chunk->index_count = record.index_count;
+        stream->center[0][c] = record.bounds_center[0];
+        stream->center[1][c] = record.bounds_center[1];
+        stream->center[2][c] = record.bounds_center[2];
+        stream->radius[c] = record.bounds_radius;
+        size_t bytes = chunk_bytes(record.vertex_count, record.index_count);
+        if (bytes > largest) largest = bytes;
+    }
+    if (largest > budget_bytes) {
+        printf("WARNING: Streaming budget of %.1f MB is smaller than one chunk (%.1f MB)\n",
+            (double)budget_bytes / (1024.0 * 1024.0), (double)largest / (1024.0 * 1024.0));
+    }
+
+    for (int i = 0; i < STREAM_LOADER_THREADS; i++) {
+        stream->threads[stream->thread_count] = platform_thread_create(loader_main, stream);
+        if (stream->threads[stream->thread_count]) stream->thread_count++;
+    }
+    if (stream->thread_count == 0) {
+        printf("FATAL ERROR: Could not start mesh loader threads\n");
+        mesh_stream_close(stream);
+        return 0;
+    }
+    printf("Mesh stream %s: %d chunks, %llu triangles, %.1f MB on disk, %.1f MB GPU budget\n", obj_path, count,
+        (unsigned long long)header.triangle_count, (double)stream->file.size / (1024.0 * 1024.0),
+        (double)budget_bytes / (1024.0 * 1024.0));
+    return 1;
+}
+
+static void chunk_release(MeshStream* stream, StreamChunk* chunk) {
+    if (chunk->state == STREAM_CHUNK_RESIDENT) {
+        glDeleteVertexArrays(1, &chunk->vao);
+        glDeleteBuffers(1, &chunk->vbo);
+        glDeleteBuffers(1, &chunk->ebo);
+        chunk->vao = chunk->vbo = chunk->ebo = 0;
+        stream->gpu_bytes -= chunk_bytes(chunk->vertex_count, chunk->index_count);
+    }
+    chunk->state = STREAM_CHUNK_ON_DISK;
+    chunk->request_time = 0.0;
+}
+
+void mesh_stream_close(MeshStream* stream) {
+    if (stream->mutex) {
+        platform_mutex_lock(stream->mutex);
+        stream->stopping = 1;
+        platform_cond_broadcast(stream->wake);
+        platform_mutex_unlock(stream->mutex);
+    }
+    for (int i = 0; i < stream->thread_count; i++) platform_thread_join(stream->threads[i]);
+
+    for (int c = 0; stream->chunks && c < stream->chunk_count; c++) {
+        free(stream->chunks[c].data);
+        chunk_release(stream, &stream->chunks[c]);
+    }
+    if (stream->mutex) platform_mutex_destroy(stream->mutex);
+    if (stream->wake) platform_cond_destroy(stream->wake);
+    if (stream->arrived) platform_cond_destroy(stream->arrived);
+    for (int i = 0; i < 3; i++) free(stream->center[i]);
+    free(stream->radius);
+    free(stream->visible);
+    free(stream->order);
+    free(stream->draw_list);
+    free(stream->queue);
+    free(stream->loaded);
+    free(stream->chunks);
+    platform_unmap_file(&stream->file);
+    memset(stream, 0, sizeof(*stream));
+}
+
+//-------------------------------------------------------------//
+//                          Per frame                           //
+//-------------------------------------------------------------//
+static int compare_distance(const void* a, const void* b) {
+    float da = ((const ChunkDistance*)a)->distance, db = ((const ChunkDistance*)b)->distance;
+    return da < db ? -1 : da > db ? 1 : 0;
+}
+
+// Evicts resident chunks not used this frame, oldest first, until
+// `bytes` more fit in the budget. Returns 0 if they cannot.
+static int make_room(MeshStream* stream, size_t bytes) {
+    while (stream->gpu_bytes + bytes > stream->budget_bytes) {
+        StreamChunk* oldest = NULL;
+        for (int c = 0; c < stream->chunk_count; c++) {
+            StreamChunk* chunk = &stream->chunks[c];
+            if (chunk->state != STREAM_CHUNK_RESIDENT || chunk->last_used >= stream->frame) continue;
+            if (!oldest || chunk->last_used < oldest->last_used) oldest = chunk;
+        }
+        if (!oldest) return 0;
+        chunk_release(stream, oldest);
+        stream->evictions++;
+    }
+    return 1;
+}
+
+static void chunk_upload(StreamChunk* chunk) {
+    size_t vertex_bytes = (size_t)chunk->vertex_count * STREAM_VERTEX_BYTES;
+    glGenVertexArrays(1, &chunk->vao);
+    glGenBuffers(1, &chunk->vbo);
+    glGenBuffers(1, &chunk->ebo);
+    glBindVertexArray(chunk->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertex_bytes, chunk->data, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (GLsizei)STREAM_VERTEX_BYTES, (void*)0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, (GLsizei)STREAM_VERTEX_BYTES, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)chunk->index_count * sizeof(unsigned short),
+        (const char*)chunk->data + vertex_bytes, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Uploads what the loaders finished, in arrival order, until `byte_limit`
+// is reached
+static void upload_loaded(MeshStream* stream, size_t byte_limit) {
+    int* uploads = stream->draw_list; // free until the draw list is rebuilt
+    int upload_count = 0;
+    size_t upload_bytes = 0;
+    platform_mutex_lock(stream->mutex);
+    while (upload_count < stream->loaded_count && upload_bytes < byte_limit) {
+        StreamChunk* chunk = &stream->chunks[stream->loaded[upload_count]];
+        upload_bytes += chunk_bytes(chunk->vertex_count, chunk->index_count);
+        uploads[upload_count] = stream->loaded[upload_count];
+        upload_count++;
+    }
+    stream->loaded_count -= upload_count;
+    memmove(stream->loaded, stream->loaded + upload_count, sizeof(int) * (size_t)stream->loaded_count);
+    stream->staging_bytes -= upload_bytes;
+    platform_mutex_unlock(stream->mutex);
+
+    // Loaded chunks are only touched by this thread from here on
+    for (int i = 0; i < upload_count; i++) {
+        StreamChunk* chunk = &stream->chunks[uploads[i]];
+        size_t bytes = chunk_bytes(chunk->vertex_count, chunk->index_count);
+        if (make_room(stream, bytes)) {
+            chunk_upload(chunk);
+            stream->gpu_bytes += bytes;
+            if (stream->gpu_bytes > stream->gpu_bytes_max) stream->gpu_bytes_max = stream->gpu_bytes;
+            double latency = platform_time_seconds() - chunk->request_time;
+            stream->latency_total += latency;
+            if (latency > stream->latency_max) stream->latency_max = latency;
+            stream->page_ins++;
+            chunk->state = STREAM_CHUNK_RESIDENT;
+            chunk->request_time = 0.0;
+            chunk->last_used = stream->frame;
+        }
+        else {
+            stream->dropped++;
+            platform_mutex_lock(stream->mutex);
+            chunk->state = STREAM_CHUNK_ON_DISK;
+            chunk->request_time = 0.0;
+            platform_mutex_unlock(stream->mutex);
+        }
+        free(chunk->data);
+        chunk->data = NULL;
+    }
+}
+
+// Everything visible that is on the GPU is drawn, wanted or not
+static void build_draw_list(MeshStream* stream) {
+    const ChunkDistance* order = stream->order;
+    stream->draw_count = 0;
+    for (int i = 0; i < stream->visible_count; i++) {
+        int c = order[i].chunk;
+        if (stream->chunks[c].state == STREAM_CHUNK_RESIDENT) stream->draw_list[stream->draw_count++] = c;
+    }
+}
+
+int mesh_stream_update(MeshStream* stream, const float* view_projection, Vec3 eye) {
+    double start = platform_time_seconds();
+    stream->frame++;
+
+    Frustum frustum;
+    frustum_from_matrix(&frustum, view_projection);
+    const float* center[3] = { stream->center[0], stream->center[1], stream->center[2] };
+    int visible = frustum_cull_spheres(&frustum, center, stream->radius, stream->chunk_count, stream->visible);
+
+    // Nearest first, by the closest point of each chunk's sphere
+    ChunkDistance* order = stream->order;
+    for (int i = 0; i < visible; i++) {
+        int c = stream->visible[i];
+        float dx = stream->center[0][c] - eye.x;
+        float dy = stream->center[1][c] - eye.y;
+        float dz = stream->center[2][c] - eye.z;
+        order[i].distance = sqrtf(dx * dx + dy * dy + dz * dz) - stream->radius[c];
+        order[i].chunk = c;
+    }
+    qsort(order, (size_t)visible, sizeof(ChunkDistance), compare_distance);
+
+    // Wanted: the nearest visible chunks that fit in the budget together.
+    // Last frame's queue is replaced, so requests follow the camera.
+    double now = platform_time_seconds();
+    unsigned long long wanted_bytes = 0;
+    platform_mutex_lock(stream->mutex);
+    for (int i = 0; i < visible; i++) {
+        StreamChunk* chunk = &stream->chunks[order[i].chunk];
+        wanted_bytes += chunk_bytes(chunk->vertex_count, chunk->index_count);
+        if (wanted_bytes > stream->budget_bytes) break;
+        chunk->wanted_frame = stream->frame;
+        chunk->last_used = stream->frame;
+    }
+    for (int i = stream->queue_head; i < stream->queue_head + stream->queue_count; i++) {
+        StreamChunk* chunk = &stream->chunks[stream->queue[i]];
+        chunk->state = STREAM_CHUNK_ON_DISK;
+        if (chunk->wanted_frame != stream->frame) chunk->request_time = 0.0;
+    }
+    stream->queue_head = 0;
+    stream->queue_count = 0;
+    for (int i = 0; i < visible; i++) {
+        StreamChunk* chunk = &stream->chunks[order[i].chunk];
+        if (chunk->wanted_frame != stream->frame) break;
+        if (chunk->state != STREAM_CHUNK_ON_DISK) continue;
+        chunk->state = STREAM_CHUNK_QUEUED;
+        if (chunk->request_time == 0.0) chunk->request_time = now;
+        stream->queue[stream->queue_count++] = order[i].chunk;
+    }
+    if (stream->queue_count > 0) platform_cond_broadcast(stream->wake);
+    platform_mutex_unlock(stream->mutex);
+
+    upload_loaded(stream, STREAM_UPLOAD_BYTES_PER_FRAME);
+    stream->visible_count = visible;
+    build_draw_list(stream);
+
+    stream->frames++;
+    stream->chunks_visible += (unsigned long long)visible;
+    stream->chunks_drawn += (unsigned long long)stream->draw_count;
+    stream->update_seconds += platform_time_seconds() - start;
+    return stream->draw_count;
+}
+
+int mesh_stream_wait(MeshStream* stream) {
+    int drawn_before = stream->draw_count;
+    for (;;) {
+        platform_mutex_lock(stream->mutex);
+        while (stream->loaded_count == 0 && (stream->queue_count > 0 || stream->loading_count > 0)) {
+            platform_cond_wait(stream->arrived, stream->mutex);
+        }
+        int settled = stream->loaded_count == 0;
+        platform_mutex_unlock(stream->mutex);
+        if (settled) break;
+        upload_loaded(stream, (size_t)-1);
+    }
+    build_draw_list(stream);
+    stream->chunks_drawn += (unsigned long long)(stream->draw_count - drawn_before);
+    return stream->draw_count;
+}
+
+void mesh_stream_draw(const MeshStream* stream) {
+    for (int i = 0; i < stream->draw_count; i++) {
+        const StreamChunk* chunk = &stream->chunks[stream->draw_list[i]];
+        glBindVertexArray(chunk->vao);
+        glDrawElements(GL_TRIANGLES, (GLsizei)chunk->index_count, GL_UNSIGNED_SHORT, (void*)0);
+    }
+    glBindVertexArray(0);
+}
+
+void mesh_stream_print_stats(const MeshStream* stream) {
+    if (stream->frames == 0) return;
+    double frames = (double)stream->frames;
+    double mb = 1024.0 * 1024.0;
+    printf("Streaming: %.1f of %.1f visible chunks drawn per frame, %.3f ms update per frame\n",
+        (double)stream->chunks_drawn / frames, (double)stream->chunks_visible / frames, stream->update_seconds * 1000.0 / frames);
+    printf("Streaming memory: GPU %.1f MB now, %.1f MB high-water of %.1f MB budget; staging %.1f MB high-water\n",
+        (double)stream->gpu_bytes / mb, (double)stream->gpu_bytes_max / mb, (double)stream->budget_bytes / mb,
+        (double)stream->staging_bytes_max / mb);
+    printf("Streaming page-ins: %llu, latency %.3f ms avg, %.3f ms max; %llu evictions, %llu dropped for lack of room\n",
+        stream->page_ins, stream->page_ins ? stream->latency_total * 1000.0 / (double)stream->page_ins : 0.0,
+        stream->latency_max * 1000.0, stream->evictions, stream->dropped);
+}
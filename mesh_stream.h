@@ -0,0 +1,126 @@
+#ifndef MESH_STREAM_H
+#define MESH_STREAM_H
+
+#include <glad/glad.h>
+
+#include "math3d.h"
+#include "platform.h"
+
+//-------------------------------------------------------------//
+//                       Chunked mesh file                      //
+//-------------------------------------------------------------//
+// "<model.obj>.meshchunks" holds the mesh cut into spatial chunks of
+// at most STREAM_CHUNK_TRIANGLES triangles, each with its own float
+// vertices, 16-bit indices and bounds. It is built once from the OBJ,
+// out of core through temporary files next to it, and rebuilt when the
+// OBJ size or write time changes.
+//
+// At run time the file is only mapped. Background loader threads copy
+// the chunks the camera wants into staging memory, and the render
+// thread uploads them within a GPU byte budget, evicting the chunks
+// that went unused the longest.
+
+#define STREAM_CHUNK_TRIANGLES 21845 // 3 * 21845 = 65535, so 16-bit indices always fit
+#define STREAM_LOADER_THREADS 2
+#define STREAM_UPLOAD_BYTES_PER_FRAME (32u << 20) // keeps a burst of arrivals from stalling one frame
+
+enum {
+    STREAM_CHUNK_ON_DISK,
+    STREAM_CHUNK_QUEUED,   // waiting for a loader
+    STREAM_CHUNK_LOADING,
+    STREAM_CHUNK_LOADED,   // in staging memory, waiting for the upload
+    STREAM_CHUNK_RESIDENT  // on the GPU
+};
+
+typedef struct {
+    // From the chunk table
+    Bounds bounds;
+    unsigned long long offset;    // vertices, then indices
+    unsigned int vertex_count;
+    unsigned int index_count;
+
+    // Residency; state and data are shared with the loaders under the mutex
+    int state;
+    void* data;
+    GLuint vao, vbo, ebo;
+    unsigned long long last_used;    // frame
+    unsigned long long wanted_frame;
+    double request_time;             // 0 while nobody is waiting for it
+} StreamChunk;
+
+typedef struct {
+    MappedFile file;
+    StreamChunk* chunks;
+    int chunk_count;
+    Bounds bounds;
+    unsigned long long budget_bytes;
+    unsigned long long frame;
+
+    // Per frame scratch
+    float* center[3];
+    float* radius;
+    int* visible;
+    void* order;        // visible chunks by distance
+    int visible_count;
+    int* draw_list;
+    int draw_count;
+
+    // Loader threads
+    PlatformThread* threads[STREAM_LOADER_THREADS];
+    int thread_count;
+    PlatformMutex* mutex;
+    PlatformCond* wake;
+    PlatformCond* arrived; // a loader finished a chunk
+    int* queue;          // chunk indices, nearest first
+    int queue_head;
+    int queue_count;
+    int loading_count;   // taken off the queue, not loaded yet
+    int* loaded;         // chunks ready for upload, in arrival order
+    int loaded_count;
+    int stopping;
+
+    // Memory, now and at the high-water mark
+    unsigned long long gpu_bytes;
+    unsigned long long gpu_bytes_max;
+    unsigned long long staging_bytes;
+    unsigned long long staging_bytes_max;
+
+    // Totals
+    unsigned long long frames;
+    unsigned long long chunks_visible;
+    unsigned long long chunks_drawn;
+    unsigned long long page_ins;
+    unsigned long long evictions;
+    unsigned long long dropped;      // loaded, but no room once they arrived
+    double latency_total;            // request until resident, seconds
+    double latency_max;
+    double update_seconds;
+} MeshStream;
+
+// Opens (building it first if needed) the chunk file of `obj_path` and
+// starts the loaders. Needs a current GL context. Returns 1 on success;
+// on failure the stream owns nothing.
+int mesh_stream_open(MeshStream* stream, const char* obj_path, unsigned long long budget_bytes);
+// Stops the loaders and frees every chunk. Safe on a zeroed stream.
+void mesh_stream_close(MeshStream* stream);
+
+// Once per frame on the GL thread, with the view-projection of the mesh's
+// own space: culls the chunks, queues the missing ones nearest first,
+// uploads what the loaders finished and evicts to stay in budget.
+// Returns the number of chunks mesh_stream_draw will draw.
+int mesh_stream_update(MeshStream* stream, const float* view_projection, Vec3 eye);
+
+// Blocks after mesh_stream_update until every chunk it asked for is on
+// the GPU, with no upload allowance, and redoes the draw list. Which
+// chunks are drawn then no longer depends on how fast the loaders are,
+// so every run draws the same frames. Returns the new chunk count.
+int mesh_stream_wait(MeshStream* stream);
+
+// Draws the resident visible chunks with the current program. Leaves
+// no VAO bound.
+void mesh_stream_draw(const MeshStream* stream);
+
+// Memory high-water marks, page-in latency and eviction counts
+void mesh_stream_print_stats(const MeshStream* stream);
+
+#endif
@@ -0,0 +1,292 @@
+#include "meshlet.h"
+#include "platform.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------//
+//                       Buffer access                          //
+//-------------------------------------------------------------//
+static unsigned int read_index(const MeshBuffers* buffers, unsigned int i) {
+    if (buffers->index_size == 2) return ((const unsigned short*)buffers->indices)[i];
+    return ((const unsigned int*)buffers->indices)[i];
+}
+
+// Object-space position, decoding packed vertices the way the shader does
+static Vec3 read_position(const MeshBuffers* buffers, unsigned int vertex) {
+    const unsigned char* base = (const unsigned char*)buffers->vertices + (size_t)vertex * buffers->vertex_stride;
+    float p[3];
+    if (buffers->vertex_format == VERTEX_FORMAT_PACKED) {
+        const short* packed = (const short*)base;
+        for (int k = 0; k < 3; k++) {
+            float value = (float)packed[k] / 32767.0f;
+            if (value < -1.0f) value = -1.0f;
+            p[k] = value * buffers->position_scale[k] + buffers->position_offset[k];
+        }
+    }
+    else {
+        memcpy(p, base, sizeof(p));
+    }
+    Vec3 position = { p[0], p[1], p[2] };
+    return position;
+}
+
+//-------------------------------------------------------------//
+//                          Building                            //
+//-------------------------------------------------------------//
+// Sphere around the AABB center, and the cone of the triangle normals
+static void meshlet_bounds(const MeshBuffers* buffers, Meshlet* meshlet, float* center, float* radius) {
+    Vec3 low = { 1e30f, 1e30f, 1e30f }, high = { -1e30f, -1e30f, -1e30f };
+    Vec3 normal_sum = { 0.0f, 0.0f, 0.0f };
+    unsigned int end = meshlet->first_index + meshlet->index_count;
+
+    for (unsigned int i = meshlet->first_index; i < end; i += 3) {
+        Vec3 corner[3];
+        for (int k = 0; k < 3; k++) {
+            corner[k] = read_position(buffers, read_index(buffers, i + k));
+            if (corner[k].x < low.x) low.x = corner[k].x;
+            if (corner[k].y < low.y) low.y = corner[k].y;
+            if (corner[k].z < low.z) low.z = corner[k].z;
+            if (corner[k].x > high.x) high.x = corner[k].x;
+            if (corner[k].y > high.y) high.y = corner[k].y;
+            if (corner[k].z > high.z) high.z = corner[k].z;
+        }
+        Vec3 e1, e2, normal;
+        vec3_sub(&e1, corner[1], corner[0]);
+        vec3_sub(&e2, corner[2], corner[0]);
+        vec3_cross(&normal, e1, e2);
+        float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (length > 0.0f) {
+            normal_sum.x += normal.x / length;
+            normal_sum.y += normal.y / length;
+            normal_sum.z += normal.z / length;
+        }
+    }
+
+    center[0] = (low.x + high.x) * 0.5f;
+    center[1] = (low.y + high.y) * 0.5f;
+    center[2] = (low.z + high.z) * 0.5f;
+    float radius2 = 0.0f;
+    for (unsigned int i = meshlet->first_index; i < end; i++) {
+        Vec3 p = read_position(buffers, read_index(buffers, i));
+        float dx = p.x - center[0], dy = p.y - center[1], dz = p.z - center[2];
+        float d2 = dx * dx + dy * dy + dz * dz;
+        if (d2 > radius2) radius2 = d2;
+    }
+    *radius = sqrtf(radius2);
+
+    // Cone: the average normal, opened up to the farthest triangle normal
+    meshlet->cone_axis[0] = meshlet->cone_axis[1] = meshlet->cone_axis[2] = 0.0f;
+    meshlet->cone_cutoff = 1.0f;
+    float sum_length = sqrtf(normal_sum.x * normal_sum.x + normal_sum.y * normal_sum.y + normal_sum.z * normal_sum.z);
+    if (sum_length <= 0.0f) return;
+    Vec3 axis = { normal_sum.x / sum_length, normal_sum.y / sum_length, normal_sum.z / sum_length };
+
+    float min_dot = 1.0f;
+    for (unsigned int i = meshlet->first_index; i < end; i += 3) {
+        Vec3 corner[3];
+        for (int k = 0; k < 3; k++) corner[k] = read_position(buffers, read_index(buffers, i + k));
+        Vec3 e1, e2, normal;
+        vec3_sub(&e1, corner[1], corner[0]);
+        vec3_sub(&e2, corner[2], corner[0]);
+        vec3_cross(&normal, e1, e2);
+        float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (length <= 0.0f) continue;
+        float d = (normal.x * axis.x + normal.y * axis.y + normal.z * axis.z) / length;
+        if (d < min_dot) min_dot = d;
+    }
+
+    meshlet->cone_axis[0] = axis.x;
+    meshlet->cone_axis[1] = axis.y;
+    meshlet->cone_axis[2] = axis.z;
+    // Cones close to a half space would almost never pass the test
+    if (min_dot > 0.1f) meshlet->cone_cutoff = sqrtf(1.0f - min_dot * min_dot);
+}
+
+int meshlets_build(const MeshBuffers* buffers, MeshletSet* set) {
+    memset(set, 0, sizeof(*set));
+    double start_time = platform_time_seconds();
+    unsigned int triangle_count = buffers->lods[0].index_count / 3; // full detail only
+    set->triangle_count = triangle_count;
+
+    // Enough when the triangle limit is what closes meshlets, grown otherwise
+    unsigned int capacity = triangle_count / MESHLET_MAX_TRIANGLES + 1;
+    unsigned int* last_meshlet = malloc(sizeof(unsigned int) * (buffers->vertex_count ? buffers->vertex_count : 1));
+    set->meshlets = malloc(sizeof(Meshlet) * capacity);
+    if (!last_meshlet || !set->meshlets) {
+        printf("FATAL ERROR: Out of memory for meshlets\n");
+        free(last_meshlet);
+        meshlets_free(set);
+        return 0;
+    }
+    for (unsigned int v = 0; v < buffers->vertex_count; v++) last_meshlet[v] = UINT_MAX;
+
+    // Greedy scan: a meshlet takes triangles in order until the next one
+    // would exceed either limit
+    Meshlet* current = NULL;
+    unsigned int triangles = 0;
+    for (unsigned int t = 0; t < triangle_count; t++) {
+        unsigned int corner[3];
+        for (int k = 0; k < 3; k++) corner[k] = read_index(buffers, t * 3 + k);
+
+        unsigned int id = current ? (unsigned int)(current - set->meshlets) : UINT_MAX;
+        unsigned int new_vertices = 0;
+        for (int k = 0; k < 3; k++) {
+            int repeated = (k > 0 && corner[k] == corner[0]) || (k > 1 && corner[k] == corner[1]);
+            if (!repeated && last_meshlet[corner[k]] != id) new_vertices++;
+        }
+
+        if (!current || triangles == MESHLET_MAX_TRIANGLES || current->vertex_count + new_vertices > MESHLET_MAX_VERTICES) {
+            // Every corner of the triangle is new to the next meshlet
+            new_vertices = 1 + (corner[1] != corner[0]) + (corner[2] != corner[0] && corner[2] != corner[1]);
+            if (set->count == capacity) {
+                Meshlet* grown = realloc(set->meshlets, sizeof(Meshlet) * capacity * 2);
+                if (!grown) {
+                    printf("FATAL ERROR: Out of memory for meshlets\n");
+                    free(last_meshlet);
+                    meshlets_free(set);
+                    return 0;
+                }
+                set->meshlets = grown;
+                capacity *= 2;
+            }
+            current = &set->meshlets[set->count++];
+            memset(current, 0, sizeof(*current));
+            current->first_index = t * 3;
+            id = (unsigned int)(current - set->meshlets);
+            triangles = 0;
+        }
+        for (int k = 0; k < 3; k++) last_meshlet[corner[k]] = id;
+        current->vertex_count += new_vertices;
+        current->index_count += 3;
+        triangles++;
+    }
+    free(last_meshlet);
+
+    for (int k = 0; k < 3; k++) set->center[k] = malloc(sizeof(float) * (set->count ? set->count : 1));
+    set->radius = malloc(sizeof(float) * (set->count ? set->count : 1));
+    if (!set->center[0] || !set->center[1] || !set->center[2] || !set->radius) {
+        printf("FATAL ERROR: Out of memory for meshlets\n");
+        meshlets_free(set);
+        return 0;
+    }
+
+    double vertex_sum = 0.0;
+    for (unsigned int m = 0; m < set->count; m++) {
+        float center[3];
+        meshlet_bounds(buffers, &set->meshlets[m], center, &set->radius[m]);
+        for (int k = 0; k < 3; k++) set->center[k][m] = center[k];
+        vertex_sum += set->meshlets[m].vertex_count;
+    }
+
+    printf("Meshlets: %u (<= %d vertices, <= %d triangles), %.1f vertices and %.1f triangles on average, built in %.3f ms\n",
+        set->count, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES,
+        set->count ? vertex_sum / set->count : 0.0, set->count ? (double)triangle_count / set->count : 0.0,
+        (platform_time_seconds() - start_time) * 1000.0);
+    return 1;
+}
+
+void meshlets_free(MeshletSet* set) {
+    free(set->meshlets);
+    for (int k = 0; k < 3; k++) free(set->center[k]);
+    free(set->radius);
+    memset(set, 0, sizeof(*set));
+}
+
+//-------------------------------------------------------------//
+//                           Culling                            //
+//-------------------------------------------------------------//
+int meshlet_culler_create(MeshletCuller* culler, const MeshletSet* set) {
+    memset(culler, 0, sizeof(*culler));
+    int capacity = set->count ? (int)set->count : 1;
+    culler->visible_indices = malloc(sizeof(int) * (size_t)capacity);
+    culler->counts = malloc(sizeof(GLsizei) * (size_t)capacity);
+    culler->offsets = malloc(sizeof(void*) * (size_t)capacity);
+    if (!culler->visible_indices || !culler->counts || !culler->offsets) {
+        meshlet_culler_destroy(culler);
+        return 0;
+    }
+    culler->capacity = capacity;
+    return 1;
+}
+
+void meshlet_culler_destroy(MeshletCuller* culler) {
+    free(culler->visible_indices);
+    free(culler->counts);
+    free(culler->offsets);
+    memset(culler, 0, sizeof(*culler));
+}
+
+int meshlet_culler_run(MeshletCuller* culler, const MeshletSet* set, const float* model,
+    const float* view_projection, Vec3 camera_position, unsigned int index_size) {
+    if ((int)set->count > culler->capacity) return 0;
+    double start = platform_time_seconds();
+
+    // Frustum planes and camera in object space, so neither the spheres
+    // nor the cones need transforming. Both tests are unchanged by any
+    // invertible affine model matrix.
+    float model_view_projection[16], inverse_model[16];
+    mat4_multiply(model_view_projection, view_projection, model);
+    Frustum frustum;
+    frustum_from_matrix(&frustum, model_view_projection);
+
+    Vec3 camera = camera_position;
+    if (mat4_inverse(inverse_model, model)) {
+        camera.x = inverse_model[0] * camera_position.x + inverse_model[4] * camera_position.y + inverse_model[8] * camera_position.z + inverse_model[12];
+        camera.y = inverse_model[1] * camera_position.x + inverse_model[5] * camera_position.y + inverse_model[9] * camera_position.z + inverse_model[13];
+        camera.z = inverse_model[2] * camera_position.x + inverse_model[6] * camera_position.y + inverse_model[10] * camera_position.z + inverse_model[14];
+    }
+
+    const float* center[3] = { set->center[0], set->center[1], set->center[2] };
+    int in_frustum = frustum_cull_spheres(&frustum, center, set->radius, (int)set->count, culler->visible_indices);
+
+    unsigned long long frustum_triangles = 0, cone_culled = 0;
+    int ranges = 0;
+    unsigned int range_end = UINT_MAX;
+    for (int v = 0; v < in_frustum; v++) {
+        int m = culler->visible_indices[v];
+        const Meshlet* meshlet = &set->meshlets[m];
+        unsigned int triangles = meshlet->index_count / 3;
+        frustum_triangles += triangles;
+
+        // Back-facing when the camera sees every normal in the cone from
+        // behind, from any point of the bounding sphere
+        if (meshlet->cone_cutoff < 1.0f) {
+            float dx = set->center[0][m] - camera.x;
+            float dy = set->center[1][m] - camera.y;
+            float dz = set->center[2][m] - camera.z;
+            float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+            float along = dx * meshlet->cone_axis[0] + dy * meshlet->cone_axis[1] + dz * meshlet->cone_axis[2];
+            if (along >= meshlet->cone_cutoff * distance + set->radius[m]) {
+                cone_culled += triangles;
+                continue;
+            }
+        }
+
+        if (meshlet->first_index == range_end) {
+            culler->counts[ranges - 1] += (GLsizei)meshlet->index_count;
+        }
+        else {
+            culler->counts[ranges] = (GLsizei)meshlet->index_count;
+            culler->offsets[ranges] = (const void*)((size_t)meshlet->first_index * index_size);
+            ranges++;
+        }
+        range_end = meshlet->first_index + meshlet->index_count;
+    }
+
+    unsigned long long total = set->triangle_count;
+    culler->seconds += platform_time_seconds() - start;
+    culler->objects++;
+    culler->ranges_total += (unsigned long long)ranges;
+    culler->triangles_total += total;
+    culler->triangles_frustum_culled += total - frustum_triangles;
+    culler->triangles_cone_culled += cone_culled;
+    return ranges;
+}
+
+void meshlet_culler_end_frame(MeshletCuller* culler) {
+    culler->frames++;
+}
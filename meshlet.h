@@ -0,0 +1,84 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glad/glad.h>
+
+#include "math3d.h"
+#include "mesh_index.h"
+
+//-------------------------------------------------------------//
+//                          Meshlets                            //
+//-------------------------------------------------------------//
+// Runs of consecutive triangles in the index buffer, cut so that each
+// one touches at most MESHLET_MAX_VERTICES distinct vertices. The index
+// buffer itself is not changed: a meshlet is a (first index, count)
+// range, so any subset of them can be drawn with one
+// glMultiDrawElements. Triangle order decides how compact the clusters
+// are; the vertex cache order from --optimize gives tight ones.
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+typedef struct {
+    unsigned int first_index;
+    unsigned int index_count;
+    unsigned int vertex_count;  // distinct vertices
+
+    // Every triangle normal is within the cone around cone_axis.
+    // cone_cutoff is the sine of its half angle, 1 when the cone is too
+    // wide to ever be back-facing.
+    float cone_axis[3];
+    float cone_cutoff;
+} Meshlet;
+
+typedef struct {
+    Meshlet* meshlets;
+    unsigned int count;
+    unsigned int triangle_count;
+
+    // Object-space bounding spheres, laid out for frustum_cull_spheres
+    float* center[3];
+    float* radius;
+} MeshletSet;
+
+// Partitions the level 0 triangles of `buffers` (float or packed vertices, 16
+// or 32-bit indices). Returns 1 on success, 0 when out of memory.
+int meshlets_build(const MeshBuffers* buffers, MeshletSet* set);
+void meshlets_free(MeshletSet* set);
+
+//-------------------------------------------------------------//
+//                       Cluster culling                        //
+//-------------------------------------------------------------//
+// Per object and frame: the meshlet spheres against the frustum, then
+// the survivors' normal cones against the camera position, both in the
+// object's own space. Neighbouring survivors are merged, and what is
+// left becomes the count/offset arrays of one glMultiDrawElements.
+
+typedef struct {
+    int* visible_indices;
+    GLsizei* counts;          // glMultiDrawElements arguments
+    const void** offsets;
+    int capacity;
+
+    // Totals over every cull call
+    unsigned long long objects;
+    unsigned long long frames;
+    unsigned long long ranges_total;
+    unsigned long long triangles_total;
+    unsigned long long triangles_frustum_culled;
+    unsigned long long triangles_cone_culled;
+    double seconds;
+} MeshletCuller;
+
+int meshlet_culler_create(MeshletCuller* culler, const MeshletSet* set);
+void meshlet_culler_destroy(MeshletCuller* culler);
+
+// Culls `set` for one object drawn with `model`. Returns the number of
+// draw ranges now in counts/offsets. index_size is 2 or 4 bytes.
+int meshlet_culler_run(MeshletCuller* culler, const MeshletSet* set, const float* model,
+    const float* view_projection, Vec3 camera_position, unsigned int index_size);
+
+// Counts the frame in the per-frame averages
+void meshlet_culler_end_frame(MeshletCuller* culler);
+
+#endif
@@ -0,0 +1,125 @@
+#include "model.h"
+#include "obj_loader.h"
+#include "mesh_optimize.h"
+#include "mesh_quantize.h"
+#include "mesh_simplify.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int cache_flags(unsigned int options) {
+    unsigned int flags = 0;
+    if (options & MODEL_OPTIMIZE) flags |= MESH_CACHE_OPTIMIZED;
+    if (options & MODEL_QUANTIZE) flags |= MESH_CACHE_QUANTIZED;
+    if (options & MODEL_LOD) flags |= MESH_CACHE_LOD;
+    return flags;
+}
+
+static int build_from_obj(const char* obj_path, unsigned int options, Model* model) {
+    Mesh mesh;
+    mesh_init(&mesh);
+    if (!load_obj_parallel(obj_path, &mesh)) {
+        mesh_free(&mesh);
+        return 0;
+    }
+
+    int indexed_ok = mesh_build_indexed(&mesh, &model->indexed);
+    Bounds bounds = mesh.bounds;
+    mesh_free(&mesh);
+    if (!indexed_ok) return 0;
+
+    // Optional: triangle order for post-transform cache reuse, then vertex order for fetch locality
+    if ((options & MODEL_OPTIMIZE) && mesh_optimize_vertex_cache(&model->indexed)) {
+        mesh_optimize_vertex_fetch(&model->indexed);
+    }
+
+    // Optional: coarser levels appended to the (already ordered) full mesh
+    MeshLod lods[MESH_MAX_LODS];
+    unsigned int lod_count = 0;
+    if (options & MODEL_LOD) lod_count = mesh_build_lods(&model->indexed, lods);
+
+    // 16-bit indices halve the index buffer whenever the vertex count allows it
+    model->indices16 = indexed_mesh_indices16(&model->indexed);
+    mesh_buffers_from_indexed(&model->indexed, model->indices16, &model->buffers);
+    model->buffers.bounds = bounds;
+    if (lod_count > 1) {
+        memcpy(model->buffers.lods, lods, sizeof(lods));
+        model->buffers.lod_count = lod_count;
+    }
+
+    // Falls back to the float layout if packing fails
+    if (options & MODEL_QUANTIZE) {
+        QuantizeStats stats;
+        model->packed_vertices = mesh_quantize_vertices(&model->indexed, &model->buffers, &stats);
+    }
+
+    if (!(options & MODEL_NO_CACHE)) mesh_cache_write(obj_path, cache_flags(options), &model->buffers);
+    return 1;
+}
+
+int model_load(const char* obj_path, unsigned int options, Model* model) {
+    memset(model, 0, sizeof(*model));
+    double start_time = platform_time_seconds();
+
+    if (!(options & MODEL_NO_CACHE) && mesh_cache_open(obj_path, cache_flags(options), &model->cache)) {
+        model->from_cache = 1;
+        model->buffers = model->cache.buffers;
+    }
+    else if (!build_from_obj(obj_path, options, model)) {
+        model_free(model);
+        return 0;
+    }
+
+    model->load_seconds = platform_time_seconds() - start_time;
+    printf("Model %s: %u vertices, %u indices from %s in %.3f ms\n", obj_path, model->buffers.vertex_count,
+        model->buffers.index_count, model->from_cache ? "mesh cache" : "OBJ", model->load_seconds * 1000.0);
+    return 1;
+}
+
+void model_free(Model* model) {
+    if (model->from_cache) mesh_cache_close(&model->cache);
+    indexed_mesh_free(&model->indexed);
+    free(model->indices16);
+    free(model->packed_vertices);
+    memset(model, 0, sizeof(*model));
+}
+
+//-------------------------------------------------------------//
+//                     Background loading                       //
+//-------------------------------------------------------------//
+static void loader_main(void* user) {
+    ModelLoader* loader = user;
+    double start_time = platform_time_seconds();
+    loader->ok = model_load(loader->path, loader->options, &loader->model);
+    loader->seconds = platform_time_seconds() - start_time;
+    platform_atomic_store(&loader->finished, 1); // publishes the model
+}
+
+void model_loader_start(ModelLoader* loader, const char* obj_path, unsigned int options) {
+    memset(loader, 0, sizeof(*loader));
+    snprintf(loader->path, sizeof(loader->path), "%s", obj_path);
+    loader->options = options;
+    loader->thread = platform_thread_create(loader_main, loader);
+    if (!loader->thread) {
+        printf("WARNING: Could not start the loader thread, loading before the first frame\n");
+        loader_main(loader);
+    }
+}
+
+int model_loader_poll(ModelLoader* loader) {
+    if (!platform_atomic_load(&loader->finished)) return 0;
+    if (loader->thread) {
+        platform_thread_join(loader->thread);
+        loader->thread = NULL;
+    }
+    return 1;
+}
+
+void model_loader_wait(ModelLoader* loader) {
+    if (loader->thread) {
+        platform_thread_join(loader->thread);
+        loader->thread = NULL;
+    }
+}
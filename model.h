@@ -0,0 +1,66 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include "mesh_cache.h"
+#include "mesh_index.h"
+
+//-------------------------------------------------------------//
+//                    GPU-ready model buffers                   //
+//-------------------------------------------------------------//
+// Final vertex and index buffers of a model, either mapped straight
+// from its mesh cache or built from the OBJ (load, index, optionally
+// optimize) and written back to the cache.
+
+// Load options
+#define MODEL_OPTIMIZE 0x1u // vertex cache + fetch reordering
+#define MODEL_NO_CACHE 0x2u // neither read nor write the mesh cache
+#define MODEL_QUANTIZE 0x4u // VERTEX_FORMAT_PACKED vertices
+#define MODEL_LOD 0x8u      // simplified levels after the full mesh
+
+typedef struct {
+    MeshBuffers buffers;
+
+    int from_cache;
+    double load_seconds;
+
+    // Owners of the buffers
+    MeshCache cache;
+    IndexedMesh indexed;
+    unsigned short* indices16;
+    void* packed_vertices;
+} Model;
+
+// Returns 1 on success. On failure the model owns nothing.
+int model_load(const char* obj_path, unsigned int options, Model* model);
+void model_free(Model* model);
+
+//-------------------------------------------------------------//
+//                     Background loading                       //
+//-------------------------------------------------------------//
+// model_load on a thread of its own, so the render loop keeps
+// presenting frames meanwhile. Until `finished` is set only the loader
+// thread touches `model`; after it, the polling thread owns it.
+
+typedef struct {
+    Model model;
+    int ok;                 // valid once finished
+    volatile int finished;
+
+    char path[1024];
+    unsigned int options;
+    PlatformThread* thread;
+    double seconds;         // spent loading, on the loader thread
+} ModelLoader;
+
+// Starts loading `obj_path`. Loads on the calling thread instead when
+// no thread can be started.
+void model_loader_start(ModelLoader* loader, const char* obj_path, unsigned int options);
+
+// Never blocks. Returns 1 once the load has finished, successfully or
+// not (see loader->ok), and the thread has been joined.
+int model_loader_poll(ModelLoader* loader);
+
+// Blocks until the load has finished, e.g. when quitting mid-load
+void model_loader_wait(ModelLoader* loader);
+
+#endif
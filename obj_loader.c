@@ -0,0 +1,620 @@
+#include "obj_loader.h"
+#include "parallel.h"
+#include "platform.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------//
+//                  In-place number tokenizer                   //
+//-------------------------------------------------------------//
+// The tokenizer works directly on the mapped file. Every parse
+// function takes a cursor and the end of the buffer, advances the
+// cursor past what it consumed and returns 0 when nothing valid was
+// found. It never looks at the C locale, unlike scanf/strtof.
+
+static const double pow10_table[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static const char* skip_spaces(const char* p, const char* end) {
+    while (p < end && is_space(*p)) p++;
+    return p;
+}
+
+static const char* skip_line(const char* p, const char* end) {
+    while (p < end && *p != '\n') p++;
+    return p < end ? p + 1 : end;
+}
+
+// Length of a line without its line terminator, for warnings
+static int line_length(const char* line, const char* next) {
+    while (next > line && (next[-1] == '\n' || next[-1] == '\r')) next--;
+    return (int)(next - line);
+}
+
+static double pow10_double(int exponent) {
+    double result = 1.0;
+    int negative = exponent < 0;
+    if (negative) exponent = -exponent;
+    while (exponent > 22) {
+        result *= 1e22;
+        exponent -= 22;
+    }
+    result *= pow10_table[exponent];
+    return negative ? 1.0 / result : result;
+}
+
+static int parse_float(const char** cursor, const char* end, float* out) {
+    const char* p = skip_spaces(*cursor, end);
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    // Up to 19 significant digits fit in the 64-bit mantissa, the rest only shift the exponent
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    int seen_digit = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+            if (mantissa) digits++;
+        }
+        else {
+            exponent++;
+        }
+        seen_digit = 1;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+            seen_digit = 1;
+            p++;
+        }
+    }
+    if (!seen_digit) return 0;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        int exp_negative = 0;
+        if (e < end && (*e == '-' || *e == '+')) {
+            exp_negative = *e == '-';
+            e++;
+        }
+        if (e < end && *e >= '0' && *e <= '9') {
+            int exp_value = 0;
+            while (e < end && *e >= '0' && *e <= '9') {
+                if (exp_value < 10000) exp_value = exp_value * 10 + (*e - '0');
+                e++;
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+            p = e;
+        }
+    }
+
+    // Exact for the common case: mantissa < 2^53 and |exponent| <= 22
+    double value = (double)mantissa;
+    if (exponent < 0 && exponent >= -22) value /= pow10_table[-exponent];
+    else if (exponent != 0) value *= pow10_double(exponent);
+
+    *out = (float)(negative ? -value : value);
+    *cursor = p;
+    return 1;
+}
+
+static int parse_int(const char** cursor, const char* end, long long* out) {
+    const char* p = *cursor;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9') return 0;
+
+    long long value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (value < 0x7fffffffffffLL) value = value * 10 + (*p - '0');
+        p++;
+    }
+    *out = negative ? -value : value;
+    *cursor = p;
+    return 1;
+}
+
+static int parse_vec3(const char** cursor, const char* end, Vec3* out) {
+    return parse_float(cursor, end, &out->x) &&
+           parse_float(cursor, end, &out->y) &&
+           parse_float(cursor, end, &out->z);
+}
+
+// OBJ indices are 1-based, negative values count back from the current element.
+// Positive ones may point forward and are checked by validate_faces, but
+// anything past INT_MAX can never exist and would wrap in the cast.
+static int resolve_index(long long raw, int count, unsigned int* out) {
+    if (raw > 0 && raw <= INT_MAX) {
+        *out = (unsigned int)(raw - 1);
+        return 1;
+    }
+    if (raw < 0 && -raw <= count) {
+        *out = (unsigned int)(count + raw);
+        return 1;
+    }
+    return 0;
+}
+
+// Parses one face corner: v, v/t, v//n or v/t/n.
+// Relative indices resolve against the element counts at this line.
+static int parse_face_corner(const char** cursor, const char* end, int vertex_total, int normal_total,
+    unsigned int* v, unsigned int* n) {
+    const char* p = skip_spaces(*cursor, end);
+    long long raw;
+    if (!parse_int(&p, end, &raw) || !resolve_index(raw, vertex_total, v)) return 0;
+
+    *n = 0;
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/') {
+            long long unused;
+            if (!parse_int(&p, end, &unused)) return 0; // texcoord index, not used yet
+        }
+        if (p < end && *p == '/') {
+            p++;
+            if (!parse_int(&p, end, &raw) || !resolve_index(raw, normal_total, n)) return 0;
+        }
+    }
+    if (p < end && !is_space(*p) && *p != '\r' && *p != '\n') return 0;
+
+    *cursor = p;
+    return 1;
+}
+
+// Returns 1 if the line parsed, 0 if it was malformed, -1 when out of memory
+static int parse_face(const char* p, const char* end, int vertex_total, int normal_total, Mesh* mesh) {
+    Face face;
+    int corners = 0;
+    int first_face = mesh->face_count;
+
+    for (;;) {
+        p = skip_spaces(p, end);
+        if (p >= end || *p == '\r' || *p == '\n' || *p == '#') break;
+
+        unsigned int vi, ni;
+        if (!parse_face_corner(&p, end, vertex_total, normal_total, &vi, &ni)) {
+            mesh->face_count = first_face; // drop the part of the polygon already emitted
+            return 0;
+        }
+
+        // Polygons are triangulated as a fan around the first corner
+        if (corners < 3) {
+            face.v_idx[corners] = vi;
+            face.n_idx[corners] = ni;
+        }
+        else {
+            face.v_idx[1] = face.v_idx[2];
+            face.n_idx[1] = face.n_idx[2];
+            face.v_idx[2] = vi;
+            face.n_idx[2] = ni;
+        }
+        corners++;
+
+        if (corners >= 3 && !mesh_push_face(mesh, &face)) return -1;
+    }
+    return corners >= 3;
+}
+
+//-------------------------------------------------------------//
+//                        Line classes                          //
+//-------------------------------------------------------------//
+enum {
+    LINE_OTHER,
+    LINE_VERTEX,
+    LINE_NORMAL,
+    LINE_FACE
+};
+
+// Classifies a line that starts at the first non-blank character
+static int line_kind(const char* line, const char* end) {
+    if (end - line >= 2 && line[0] == 'v' && is_space(line[1])) return LINE_VERTEX;
+    if (end - line >= 3 && line[0] == 'v' && line[1] == 'n' && is_space(line[2])) return LINE_NORMAL;
+    if (end - line >= 2 && line[0] == 'f' && is_space(line[1])) return LINE_FACE;
+    return LINE_OTHER;
+}
+
+static void print_parse_warning(int kind, const char* line, const char* next) {
+    const char* name = kind == LINE_VERTEX ? "vertex" : kind == LINE_NORMAL ? "normal" : "face";
+    printf("WARNING: Failed to parse %s line: %.*s\n", name, line_length(line, next), line);
+}
+
+// Positive indices are not checked while parsing (they may point forward),
+// so every face is validated once the element counts are final.
+static int validate_faces(const Mesh* mesh) {
+    unsigned int vertex_total = (unsigned int)mesh->vertex_count;
+    unsigned int normal_total = (unsigned int)mesh->normal_count;
+    for (int i = 0; i < mesh->face_count; i++) {
+        const Face* face = &mesh->faces[i];
+        for (int j = 0; j < 3; j++) {
+            if (face->v_idx[j] >= vertex_total || face->n_idx[j] >= normal_total) {
+                printf("FATAL ERROR: OBJ face %d references a vertex or normal that does not exist\n", i + 1);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static int finish_load(Mesh* mesh, size_t file_size, double elapsed, int threads) {
+    if (mesh->normal_count == 0) {
+        Vec3 up = { 0.0f, 0.0f, 1.0f };
+        if (!mesh_push_normal(mesh, up)) {
+            printf("FATAL ERROR: Out of memory while loading OBJ\n");
+            return 0;
+        }
+    }
+    if (!validate_faces(mesh)) return 0;
+    mesh_shrink_to_fit(mesh);
+    bounds_from_points(&mesh->bounds, mesh->vertices, mesh->vertex_count);
+
+    double megabytes = (double)file_size / (1024.0 * 1024.0);
+    printf("OBJ loaded: %d vertices, %d normals, %d faces (%.2f MB)\n", mesh->vertex_count, mesh->normal_count,
+        mesh->face_count, (double)mesh_memory_bytes(mesh) / (1024.0 * 1024.0));
+    printf("OBJ parse: %.2f MB in %.3f ms (%.1f MB/s, %d thread%s)\n", megabytes, elapsed * 1000.0,
+        elapsed > 0.0 ? megabytes / elapsed : 0.0, threads, threads == 1 ? "" : "s");
+    return 1;
+}
+
+//-------------------------------------------------------------//
+//                      OBJ loader function                     //
+//-------------------------------------------------------------//
+int load_obj(const char* filename, Mesh* mesh) {
+    MappedFile file;
+    if (!platform_map_file(filename, &file)) {
+        printf("FATAL ERROR: Cannot open OBJ file: %s\n", filename);
+        return 0;
+    }
+
+    double start_time = platform_time_seconds();
+
+    mesh_clear(mesh);
+
+    const char* p = file.data;
+    const char* end = file.data + file.size;
+    int ok = 1;
+    while (p < end && ok) {
+        const char* line = skip_spaces(p, end);
+        const char* next = skip_line(line, end);
+        int kind = line_kind(line, end);
+
+        if (kind == LINE_VERTEX || kind == LINE_NORMAL) {
+            const char* cursor = line + (kind == LINE_VERTEX ? 2 : 3);
+            Vec3 value;
+            if (!parse_vec3(&cursor, end, &value)) print_parse_warning(kind, line, next);
+            else if (kind == LINE_VERTEX) ok = mesh_push_vertex(mesh, value);
+            else ok = mesh_push_normal(mesh, value);
+        }
+        else if (kind == LINE_FACE) {
+            int result = parse_face(line + 2, end, mesh->vertex_count, mesh->normal_count, mesh);
+            if (result < 0) ok = 0;
+            else if (result == 0) print_parse_warning(kind, line, next);
+        }
+        p = next;
+    }
+
+    double elapsed = platform_time_seconds() - start_time;
+    size_t file_size = file.size;
+    platform_unmap_file(&file);
+    if (!ok) {
+        printf("FATAL ERROR: Out of memory while loading %s\n", filename);
+        return 0;
+    }
+
+    return finish_load(mesh, file_size, elapsed, 1);
+}
+
+//-------------------------------------------------------------//
+//                       Streaming reader                       //
+//-------------------------------------------------------------//
+int obj_stream(const char* filename, const ObjStreamCallbacks* callbacks) {
+    MappedFile file;
+    if (!platform_map_file(filename, &file)) {
+        printf("FATAL ERROR: Cannot open OBJ file: %s\n", filename);
+        return 0;
+    }
+
+    // One face line at a time goes through a scratch mesh, so polygons
+    // are triangulated exactly like load_obj does
+    Mesh scratch;
+    mesh_init(&scratch);
+    int vertex_total = 0;
+    int normal_total = 0;
+    const char* p = file.data;
+    const char* end = file.data + file.size;
+    int ok = 1;
+    while (p < end && ok) {
+        const char* line = skip_spaces(p, end);
+        const char* next = skip_line(line, end);
+        int kind = line_kind(line, end);
+
+        if (kind == LINE_VERTEX || kind == LINE_NORMAL) {
+            const char* cursor = line + (kind == LINE_VERTEX ? 2 : 3);
+            Vec3 value;
+            if (!parse_vec3(&cursor, end, &value)) print_parse_warning(kind, line, next);
+            else if (kind == LINE_VERTEX) {
+                ok = vertex_total < INT_MAX && callbacks->vertex(callbacks->user, value);
+                vertex_total++;
+            }
+            else {
+                ok = normal_total < INT_MAX && callbacks->normal(callbacks->user, value);
+                normal_total++;
+            }
+        }
+        else if (kind == LINE_FACE) {
+            scratch.face_count = 0;
+            int result = parse_face(line + 2, end, vertex_total, normal_total, &scratch);
+            if (result < 0) ok = 0;
+            else if (result == 0) print_parse_warning(kind, line, next);
+            for (int i = 0; ok && i < scratch.face_count; i++) ok = callbacks->face(callbacks->user, &scratch.faces[i]);
+        }
+        p = next;
+    }
+
+    mesh_free(&scratch);
+    platform_unmap_file(&file);
+    if (!ok) printf("FATAL ERROR: Could not stream %s\n", filename);
+    return ok;
+}
+
+//-------------------------------------------------------------//
+//                   Parallel chunked loader                    //
+//-------------------------------------------------------------//
+// The file is cut into newline-aligned chunks that are parsed in two
+// passes on the thread pool:
+//   1. v / vn records into per-chunk meshes
+//   2. f records, once prefix sums over pass 1 give every chunk the
+//      number of vertices and normals that precede it. That is what
+//      relative (negative) indices resolve against, so the result is
+//      identical to the serial loop.
+// The output mesh is then sized exactly and the chunks are copied in
+// file order.
+
+#define CHUNK_MIN_BYTES (1 << 20)
+#define CHUNKS_PER_THREAD 4
+
+typedef struct {
+    const char* line;
+    const char* next;
+    int kind;
+} ParseWarning;
+
+typedef struct {
+    const char* begin;
+    const char* end;
+    Mesh part;
+
+    // Elements in all earlier chunks, filled in between the passes
+    int vertex_base;
+    int normal_base;
+    int face_base;
+
+    // Malformed lines in file order, per pass
+    ParseWarning* warnings[2];
+    int warning_count[2];
+    int warning_capacity[2];
+
+    int out_of_memory;
+} ObjChunk;
+
+typedef struct {
+    const char* file_end;
+    ObjChunk* chunks;
+    Mesh* mesh;
+} ObjJob;
+
+static int add_warning(ObjChunk* chunk, int pass, int kind, const char* line, const char* next) {
+    if (chunk->warning_count[pass] >= chunk->warning_capacity[pass]) {
+        int capacity = chunk->warning_capacity[pass] ? chunk->warning_capacity[pass] * 2 : 16;
+        ParseWarning* grown = realloc(chunk->warnings[pass], sizeof(ParseWarning) * (size_t)capacity);
+        if (!grown) return 0;
+        chunk->warnings[pass] = grown;
+        chunk->warning_capacity[pass] = capacity;
+    }
+    ParseWarning* warning = &chunk->warnings[pass][chunk->warning_count[pass]++];
+    warning->line = line;
+    warning->next = next;
+    warning->kind = kind;
+    return 1;
+}
+
+static void parse_chunk_vectors(void* user, int index) {
+    ObjJob* job = (ObjJob*)user;
+    ObjChunk* chunk = &job->chunks[index];
+    const char* p = chunk->begin;
+    const char* end = job->file_end; // a record may not run past the file, never past its line
+
+    while (p < chunk->end && !chunk->out_of_memory) {
+        const char* line = skip_spaces(p, end);
+        const char* next = skip_line(line, end);
+        int kind = line_kind(line, end);
+
+        if (kind == LINE_VERTEX || kind == LINE_NORMAL) {
+            const char* cursor = line + (kind == LINE_VERTEX ? 2 : 3);
+            Vec3 value;
+            int pushed;
+            if (!parse_vec3(&cursor, end, &value)) pushed = add_warning(chunk, 0, kind, line, next);
+            else if (kind == LINE_VERTEX) pushed = mesh_push_vertex(&chunk->part, value);
+            else pushed = mesh_push_normal(&chunk->part, value);
+            if (!pushed) chunk->out_of_memory = 1;
+        }
+        p = next;
+    }
+}
+
+static void parse_chunk_faces(void* user, int index) {
+    ObjJob* job = (ObjJob*)user;
+    ObjChunk* chunk = &job->chunks[index];
+    const char* p = chunk->begin;
+    const char* end = job->file_end;
+
+    // Replays the pass 1 counts line by line; lines that failed there did not count
+    int vertex_total = chunk->vertex_base;
+    int normal_total = chunk->normal_base;
+    const ParseWarning* skipped = chunk->warnings[0];
+    const ParseWarning* skipped_end = skipped + chunk->warning_count[0];
+
+    while (p < chunk->end && !chunk->out_of_memory) {
+        const char* line = skip_spaces(p, end);
+        const char* next = skip_line(line, end);
+        int kind = line_kind(line, end);
+
+        if (kind == LINE_VERTEX || kind == LINE_NORMAL) {
+            if (skipped < skipped_end && skipped->line == line) skipped++;
+            else if (kind == LINE_VERTEX) vertex_total++;
+            else normal_total++;
+        }
+        else if (kind == LINE_FACE) {
+            int result = parse_face(line + 2, end, vertex_total, normal_total, &chunk->part);
+            if (result < 0 || (result == 0 && !add_warning(chunk, 1, kind, line, next))) chunk->out_of_memory = 1;
+        }
+        p = next;
+    }
+}
+
+static void copy_chunk_output(void* user, int index) {
+    ObjJob* job = (ObjJob*)user;
+    const ObjChunk* chunk = &job->chunks[index];
+    const Mesh* part = &chunk->part;
+    Mesh* mesh = job->mesh;
+    if (part->vertex_count) memcpy(&mesh->vertices[chunk->vertex_base], part->vertices, sizeof(Vec3) * (size_t)part->vertex_count);
+    if (part->normal_count) memcpy(&mesh->normals[chunk->normal_base], part->normals, sizeof(Vec3) * (size_t)part->normal_count);
+    if (part->face_count) memcpy(&mesh->faces[chunk->face_base], part->faces, sizeof(Face) * (size_t)part->face_count);
+}
+
+// Prints both passes' warnings of a chunk interleaved back into line order
+static void print_chunk_warnings(const ObjChunk* chunk) {
+    int a = 0, b = 0;
+    while (a < chunk->warning_count[0] || b < chunk->warning_count[1]) {
+        const ParseWarning* warning;
+        if (b >= chunk->warning_count[1] ||
+            (a < chunk->warning_count[0] && chunk->warnings[0][a].line < chunk->warnings[1][b].line)) {
+            warning = &chunk->warnings[0][a++];
+        }
+        else {
+            warning = &chunk->warnings[1][b++];
+        }
+        print_parse_warning(warning->kind, warning->line, warning->next);
+    }
+}
+
+static void free_chunks(ObjChunk* chunks, int chunk_count) {
+    for (int i = 0; i < chunk_count; i++) {
+        mesh_free(&chunks[i].part);
+        free(chunks[i].warnings[0]);
+        free(chunks[i].warnings[1]);
+    }
+    free(chunks);
+}
+
+int load_obj_parallel(const char* filename, Mesh* mesh) {
+    MappedFile file;
+    if (!platform_map_file(filename, &file)) {
+        printf("FATAL ERROR: Cannot open OBJ file: %s\n", filename);
+        return 0;
+    }
+
+    double start_time = platform_time_seconds();
+
+    mesh_clear(mesh);
+
+    int threads = parallel_thread_count();
+    size_t max_chunks = file.size / CHUNK_MIN_BYTES + 1;
+    int chunk_count = threads * CHUNKS_PER_THREAD;
+    if ((size_t)chunk_count > max_chunks) chunk_count = (int)max_chunks;
+
+    ObjChunk* chunks = calloc((size_t)chunk_count, sizeof(ObjChunk));
+    if (!chunks) {
+        printf("FATAL ERROR: Out of memory while loading %s\n", filename);
+        platform_unmap_file(&file);
+        return 0;
+    }
+
+    // Cut at the first newline after each even split point. Chunks can
+    // come out empty on files with very long lines, which is harmless.
+    const char* end = file.data + file.size;
+    const char* cut = file.data;
+    for (int i = 0; i < chunk_count; i++) {
+        chunks[i].begin = cut;
+        mesh_init(&chunks[i].part);
+        if (i == chunk_count - 1) {
+            cut = end;
+        }
+        else {
+            const char* target = file.data + file.size / (size_t)chunk_count * (size_t)(i + 1);
+            if (target < cut) target = cut;
+            const char* newline = target < end ? memchr(target, '\n', (size_t)(end - target)) : NULL;
+            cut = newline ? newline + 1 : end;
+        }
+        chunks[i].end = cut;
+    }
+
+    ObjJob job = { end, chunks, mesh };
+    parallel_for(chunk_count, parse_chunk_vectors, &job);
+
+    int ok = 1;
+    long long vertex_total = 0, normal_total = 0, face_total = 0;
+    for (int i = 0; i < chunk_count; i++) {
+        if (chunks[i].out_of_memory) ok = 0;
+        chunks[i].vertex_base = (int)vertex_total;
+        chunks[i].normal_base = (int)normal_total;
+        vertex_total += chunks[i].part.vertex_count;
+        normal_total += chunks[i].part.normal_count;
+    }
+    if (vertex_total > INT_MAX || normal_total > INT_MAX) ok = 0;
+
+    if (ok) {
+        parallel_for(chunk_count, parse_chunk_faces, &job);
+        for (int i = 0; i < chunk_count; i++) {
+            if (chunks[i].out_of_memory) ok = 0;
+            chunks[i].face_base = (int)face_total;
+            face_total += chunks[i].part.face_count;
+        }
+        if (face_total > INT_MAX) ok = 0;
+    }
+
+    // Sized exactly, plus one spare normal in case the default has to be added
+    if (ok) ok = mesh_reserve(mesh, (int)vertex_total, normal_total ? (int)normal_total : 1, (int)face_total);
+
+    if (ok) {
+        for (int i = 0; i < chunk_count; i++) print_chunk_warnings(&chunks[i]);
+        parallel_for(chunk_count, copy_chunk_output, &job);
+        mesh->vertex_count = (int)vertex_total;
+        mesh->normal_count = (int)normal_total;
+        mesh->face_count = (int)face_total;
+    }
+
+    double elapsed = platform_time_seconds() - start_time;
+    size_t file_size = file.size;
+    free_chunks(chunks, chunk_count);
+    platform_unmap_file(&file);
+    if (!ok) {
+        printf("FATAL ERROR: Out of memory while loading %s\n", filename);
+        return 0;
+    }
+
+    return finish_load(mesh, file_size, elapsed, threads < chunk_count ? threads : chunk_count);
+}
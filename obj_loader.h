@@ -0,0 +1,27 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "mesh.h"
+
+// Memory maps the file and parses v / vn / f records in place into
+// `mesh`, replacing its contents. Returns 1 on success, 0 on failure.
+int load_obj(const char* filename, Mesh* mesh);
+
+// Same result as load_obj, but the file is split into newline-aligned
+// chunks that are parsed on the thread pool (see parallel.h).
+int load_obj_parallel(const char* filename, Mesh* mesh);
+
+// Calls back once per v / vn record and once per triangle, in file order,
+// without keeping any of them, for files larger than memory. Relative
+// indices are resolved; positive ones are not checked, since they may
+// point forward. A callback returns 0 to stop. Returns 1 on success.
+typedef struct {
+    void* user;
+    int (*vertex)(void* user, Vec3 position);
+    int (*normal)(void* user, Vec3 normal);
+    int (*face)(void* user, const Face* face);
+} ObjStreamCallbacks;
+
+int obj_stream(const char* filename, const ObjStreamCallbacks* callbacks);
+
+#endif
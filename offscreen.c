@@ -0,0 +1,92 @@
+#include "offscreen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+
+int offscreen_create(Offscreen* offscreen, int width, int height) {
+    memset(offscreen, 0, sizeof(*offscreen));
+
+    glGenRenderbuffers(1, &offscreen->color);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreen->color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &offscreen->depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreen->depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &offscreen->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreen->framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreen->color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreen->depth);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("FATAL ERROR: Offscreen framebuffer %dx%d is incomplete (0x%x)\n", width, height, status);
+        offscreen_destroy(offscreen);
+        return 0;
+    }
+
+    offscreen->width = width;
+    offscreen->height = height;
+    return 1;
+}
+
+void offscreen_destroy(Offscreen* offscreen) {
+    if (offscreen->framebuffer) glDeleteFramebuffers(1, &offscreen->framebuffer);
+    if (offscreen->color) glDeleteRenderbuffers(1, &offscreen->color);
+    if (offscreen->depth) glDeleteRenderbuffers(1, &offscreen->depth);
+    memset(offscreen, 0, sizeof(*offscreen));
+}
+
+void offscreen_bind(const Offscreen* offscreen) {
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreen ? offscreen->framebuffer : 0);
+}
+
+//-------------------------------------------------------------//
+//                          Frame dumps                         //
+//-------------------------------------------------------------//
+void framebuffer_read_rgb(int width, int height, unsigned char* rgb) {
+    // Rows of 3-byte pixels are not 4-byte aligned in general
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rgb);
+}
+
+int image_write_ppm(const char* path, const unsigned char* pixels, int width, int height, int channels) {
+    size_t row_bytes = (size_t)width * 3;
+    unsigned char* row = NULL;
+    if (channels == 4) {
+        row = malloc(row_bytes);
+        if (!row) {
+            printf("WARNING: Out of memory writing %s\n", path);
+            return 0;
+        }
+    }
+
+    FILE* file = platform_fopen(path, "wb");
+    if (!file) {
+        printf("WARNING: Could not open %s for writing\n", path);
+        free(row);
+        return 0;
+    }
+
+    int ok = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+    for (int y = height - 1; y >= 0 && ok; y--) {
+        const unsigned char* src = pixels + (size_t)y * width * channels;
+        if (row) {
+            for (int x = 0; x < width; x++) {
+                row[x * 3 + 0] = src[x * 4 + 0];
+                row[x * 3 + 1] = src[x * 4 + 1];
+                row[x * 3 + 2] = src[x * 4 + 2];
+            }
+            src = row;
+        }
+        ok = fwrite(src, 1, row_bytes, file) == row_bytes;
+    }
+    free(row);
+    if (fclose(file) != 0) ok = 0;
+    if (!ok) printf("WARNING: Could not write %s\n", path);
+    return ok;
+}
@@ -0,0 +1,41 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <glad/glad.h>
+
+//-------------------------------------------------------------//
+//                     Offscreen framebuffer                    //
+//-------------------------------------------------------------//
+// Color and depth renderbuffers behind an FBO, so headless runs render
+// the same image at the same size whatever context they got: a
+// surfaceless EGL or OSMesa one on GLFW's null platform, whose default
+// framebuffer may be incomplete, or a hidden window.
+
+typedef struct {
+    GLuint framebuffer;
+    GLuint color;
+    GLuint depth;
+    int width;
+    int height;
+} Offscreen;
+
+// Returns 1 on success; on failure the offscreen owns nothing
+int offscreen_create(Offscreen* offscreen, int width, int height);
+void offscreen_destroy(Offscreen* offscreen);
+
+// Directs rendering into the offscreen, or back to the window with NULL
+void offscreen_bind(const Offscreen* offscreen);
+
+//-------------------------------------------------------------//
+//                          Frame dumps                         //
+//-------------------------------------------------------------//
+
+// Reads the bound framebuffer with glReadPixels, synchronously, into
+// `rgb` (width * height * 3 bytes, bottom row first as GL returns it)
+void framebuffer_read_rgb(int width, int height, unsigned char* rgb);
+
+// Writes a binary PPM from 3 (RGB) or 4 (RGBA, alpha dropped) bytes per
+// pixel, flipping GL's bottom-up rows. Returns 1 on success.
+int image_write_ppm(const char* path, const unsigned char* pixels, int width, int height, int channels);
+
+#endif
@@ -0,0 +1,140 @@
+#include "parallel.h"
+#include "platform.h"
+
+#include <stdlib.h>
+
+//-------------------------------------------------------------//
+//                         Pool state                           //
+//-------------------------------------------------------------//
+static PlatformThread** workers = NULL;
+static int worker_count = 0;
+
+static PlatformMutex* submit_mutex = NULL; // held for the whole parallel_for
+static PlatformMutex* state_mutex = NULL;  // guards everything below
+static PlatformCond* work_cond = NULL;
+static PlatformCond* done_cond = NULL;
+
+static unsigned int generation = 0;
+static int shutting_down = 0;
+static int active_workers = 0;
+
+static ParallelTask job_task = NULL;
+static void* job_user = NULL;
+static int job_count = 0;
+static volatile int job_next = 0;
+
+static void run_tasks(void) {
+    for (;;) {
+        int index = platform_atomic_add(&job_next, 1) - 1;
+        if (index >= job_count) break;
+        job_task(job_user, index);
+    }
+}
+
+static void worker_main(void* user) {
+    (void)user;
+    unsigned int seen = 0;
+
+    platform_mutex_lock(state_mutex);
+    for (;;) {
+        while (generation == seen && !shutting_down) platform_cond_wait(work_cond, state_mutex);
+        if (shutting_down) break;
+        seen = generation;
+        platform_mutex_unlock(state_mutex);
+
+        run_tasks();
+
+        platform_mutex_lock(state_mutex);
+        if (--active_workers == 0) platform_cond_signal(done_cond);
+    }
+    platform_mutex_unlock(state_mutex);
+}
+
+//-------------------------------------------------------------//
+//                         Public API                           //
+//-------------------------------------------------------------//
+int parallel_init(int thread_count) {
+    if (submit_mutex) return 1;
+
+    if (thread_count <= 0) thread_count = platform_cpu_count();
+
+    submit_mutex = platform_mutex_create();
+    state_mutex = platform_mutex_create();
+    work_cond = platform_cond_create();
+    done_cond = platform_cond_create();
+    if (!submit_mutex || !state_mutex || !work_cond || !done_cond) {
+        parallel_shutdown();
+        return 0;
+    }
+
+    shutting_down = 0;
+    generation = 0;
+    worker_count = 0;
+    if (thread_count > 1) {
+        workers = malloc(sizeof(PlatformThread*) * (size_t)(thread_count - 1));
+        if (!workers) {
+            parallel_shutdown();
+            return 0;
+        }
+        for (int i = 0; i < thread_count - 1; i++) {
+            workers[i] = platform_thread_create(worker_main, NULL);
+            if (!workers[i]) break; // run with what we got
+            worker_count++;
+        }
+    }
+    return 1;
+}
+
+void parallel_shutdown(void) {
+    if (state_mutex) {
+        platform_mutex_lock(state_mutex);
+        shutting_down = 1;
+        if (work_cond) platform_cond_broadcast(work_cond);
+        platform_mutex_unlock(state_mutex);
+    }
+    for (int i = 0; i < worker_count; i++) platform_thread_join(workers[i]);
+    free(workers);
+    workers = NULL;
+    worker_count = 0;
+
+    if (done_cond) platform_cond_destroy(done_cond);
+    if (work_cond) platform_cond_destroy(work_cond);
+    if (state_mutex) platform_mutex_destroy(state_mutex);
+    if (submit_mutex) platform_mutex_destroy(submit_mutex);
+    done_cond = NULL;
+    work_cond = NULL;
+    state_mutex = NULL;
+    submit_mutex = NULL;
+}
+
+int parallel_thread_count(void) {
+    return worker_count + 1;
+}
+
+void parallel_for(int task_count, ParallelTask task, void* user) {
+    if (task_count <= 0) return;
+    if (!submit_mutex) parallel_init(0);
+
+    if (task_count == 1 || worker_count == 0 || !submit_mutex || !platform_mutex_trylock(submit_mutex)) {
+        for (int i = 0; i < task_count; i++) task(user, i);
+        return;
+    }
+
+    platform_mutex_lock(state_mutex);
+    job_task = task;
+    job_user = user;
+    job_count = task_count;
+    platform_atomic_store(&job_next, 0);
+    active_workers = worker_count;
+    generation++;
+    platform_cond_broadcast(work_cond);
+    platform_mutex_unlock(state_mutex);
+
+    run_tasks();
+
+    platform_mutex_lock(state_mutex);
+    while (active_workers > 0) platform_cond_wait(done_cond, state_mutex);
+    platform_mutex_unlock(state_mutex);
+
+    platform_mutex_unlock(submit_mutex);
+}
@@ -0,0 +1,27 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+//-------------------------------------------------------------//
+//                        Thread pool                           //
+//-------------------------------------------------------------//
+// A fixed set of worker threads that run indexed tasks. The thread
+// calling parallel_for works on the tasks too and returns once all
+// of them have finished.
+
+typedef void (*ParallelTask)(void* user, int index);
+
+// Starts the pool. thread_count counts the calling thread, 0 picks
+// one per logical processor. Returns 1 on success. Calling it again
+// without parallel_shutdown is a no-op.
+int parallel_init(int thread_count);
+void parallel_shutdown(void);
+
+// Threads that run tasks, including the caller. 1 before parallel_init.
+int parallel_thread_count(void);
+
+// Runs task(user, i) for every i in [0, task_count). Starts the pool on
+// first use. If the pool is already busy (nested call or a second
+// thread submitting) the tasks run serially on the calling thread.
+void parallel_for(int task_count, ParallelTask task, void* user);
+
+#endif
@@ -0,0 +1,375 @@
+#include "platform.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+//-------------------------------------------------------------//
+//                    Memory mapped files                       //
+//-------------------------------------------------------------//
+#ifdef _WIN32
+
+int platform_map_file(const char* path, MappedFile* file) {
+    file->data = NULL;
+    file->size = 0;
+    file->file_handle = NULL;
+    file->map_handle = NULL;
+
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return 0;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        CloseHandle(handle);
+        return 0;
+    }
+    file->file_handle = handle;
+    if (size.QuadPart == 0) return 1; // CreateFileMapping rejects empty files
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(handle);
+        file->file_handle = NULL;
+        return 0;
+    }
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(handle);
+        file->file_handle = NULL;
+        return 0;
+    }
+
+    file->data = (const char*)view;
+    file->size = (size_t)size.QuadPart;
+    file->map_handle = mapping;
+    return 1;
+}
+
+void platform_unmap_file(MappedFile* file) {
+    if (file->data) UnmapViewOfFile(file->data);
+    if (file->map_handle) CloseHandle((HANDLE)file->map_handle);
+    if (file->file_handle) CloseHandle((HANDLE)file->file_handle);
+    file->data = NULL;
+    file->size = 0;
+    file->file_handle = NULL;
+    file->map_handle = NULL;
+}
+
+int platform_file_info(const char* path, unsigned long long* size, long long* mtime) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) return 0;
+    *size = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    // FILETIME counts 100 ns ticks
+    *mtime = (long long)(((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) |
+        data.ftLastWriteTime.dwLowDateTime) * 100;
+    return 1;
+}
+
+FILE* platform_fopen(const char* path, const char* mode) {
+    FILE* file = NULL;
+    if (fopen_s(&file, path, mode) != 0) return NULL;
+    return file;
+}
+
+int platform_replace_file(const char* from, const char* to) {
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 1 : 0;
+}
+
+double platform_time_seconds(void) {
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+//-------------------------------------------------------------//
+//                          Threads                             //
+//-------------------------------------------------------------//
+struct PlatformThread {
+    HANDLE handle;
+    PlatformThreadFunc func;
+    void* user;
+};
+
+struct PlatformMutex {
+    SRWLOCK lock;
+};
+
+struct PlatformCond {
+    CONDITION_VARIABLE cond;
+};
+
+int platform_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+static DWORD WINAPI thread_entry(LPVOID param) {
+    PlatformThread* thread = (PlatformThread*)param;
+    thread->func(thread->user);
+    return 0;
+}
+
+PlatformThread* platform_thread_create(PlatformThreadFunc func, void* user) {
+    PlatformThread* thread = malloc(sizeof(PlatformThread));
+    if (!thread) return NULL;
+    thread->func = func;
+    thread->user = user;
+    thread->handle = CreateThread(NULL, 0, thread_entry, thread, 0, NULL);
+    if (!thread->handle) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void platform_thread_join(PlatformThread* thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    free(thread);
+}
+
+PlatformMutex* platform_mutex_create(void) {
+    PlatformMutex* mutex = malloc(sizeof(PlatformMutex));
+    if (mutex) InitializeSRWLock(&mutex->lock);
+    return mutex;
+}
+
+void platform_mutex_destroy(PlatformMutex* mutex) {
+    free(mutex);
+}
+
+void platform_mutex_lock(PlatformMutex* mutex) {
+    AcquireSRWLockExclusive(&mutex->lock);
+}
+
+int platform_mutex_trylock(PlatformMutex* mutex) {
+    return TryAcquireSRWLockExclusive(&mutex->lock) ? 1 : 0;
+}
+
+void platform_mutex_unlock(PlatformMutex* mutex) {
+    ReleaseSRWLockExclusive(&mutex->lock);
+}
+
+PlatformCond* platform_cond_create(void) {
+    PlatformCond* cond = malloc(sizeof(PlatformCond));
+    if (cond) InitializeConditionVariable(&cond->cond);
+    return cond;
+}
+
+void platform_cond_destroy(PlatformCond* cond) {
+    free(cond);
+}
+
+void platform_cond_wait(PlatformCond* cond, PlatformMutex* mutex) {
+    SleepConditionVariableSRW(&cond->cond, &mutex->lock, INFINITE, 0);
+}
+
+void platform_cond_signal(PlatformCond* cond) {
+    WakeConditionVariable(&cond->cond);
+}
+
+void platform_cond_broadcast(PlatformCond* cond) {
+    WakeAllConditionVariable(&cond->cond);
+}
+
+int platform_atomic_add(volatile int* value, int amount) {
+    return (int)InterlockedExchangeAdd((volatile LONG*)value, amount) + amount;
+}
+
+int platform_atomic_load(volatile int* value) {
+    return (int)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+void platform_atomic_store(volatile int* value, int new_value) {
+    InterlockedExchange((volatile LONG*)value, new_value);
+}
+
+#else
+
+int platform_map_file(const char* path, MappedFile* file) {
+    file->data = NULL;
+    file->size = 0;
+    file->file_handle = NULL;
+    file->map_handle = NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    file->file_handle = (void*)(size_t)(fd + 1); // +1 so fd 0 is not mistaken for "no file"
+    if (st.st_size == 0) return 1;
+
+    void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED) {
+        close(fd);
+        file->file_handle = NULL;
+        return 0;
+    }
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    file->data = (const char*)view;
+    file->size = (size_t)st.st_size;
+    return 1;
+}
+
+void platform_unmap_file(MappedFile* file) {
+    if (file->data) munmap((void*)file->data, file->size);
+    if (file->file_handle) close((int)((size_t)file->file_handle - 1));
+    file->data = NULL;
+    file->size = 0;
+    file->file_handle = NULL;
+    file->map_handle = NULL;
+}
+
+int platform_file_info(const char* path, unsigned long long* size, long long* mtime) {
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    *size = (unsigned long long)st.st_size;
+    *mtime = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    return 1;
+}
+
+FILE* platform_fopen(const char* path, const char* mode) {
+    return fopen(path, mode);
+}
+
+int platform_replace_file(const char* from, const char* to) {
+    return rename(from, to) == 0;
+}
+
+double platform_time_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+//-------------------------------------------------------------//
+//                          Threads                             //
+//-------------------------------------------------------------//
+struct PlatformThread {
+    pthread_t handle;
+    PlatformThreadFunc func;
+    void* user;
+};
+
+struct PlatformMutex {
+    pthread_mutex_t lock;
+};
+
+struct PlatformCond {
+    pthread_cond_t cond;
+};
+
+int platform_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+static void* thread_entry(void* param) {
+    PlatformThread* thread = (PlatformThread*)param;
+    thread->func(thread->user);
+    return NULL;
+}
+
+PlatformThread* platform_thread_create(PlatformThreadFunc func, void* user) {
+    PlatformThread* thread = malloc(sizeof(PlatformThread));
+    if (!thread) return NULL;
+    thread->func = func;
+    thread->user = user;
+    if (pthread_create(&thread->handle, NULL, thread_entry, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void platform_thread_join(PlatformThread* thread) {
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
+
+PlatformMutex* platform_mutex_create(void) {
+    PlatformMutex* mutex = malloc(sizeof(PlatformMutex));
+    if (mutex && pthread_mutex_init(&mutex->lock, NULL) != 0) {
+        free(mutex);
+        return NULL;
+    }
+    return mutex;
+}
+
+void platform_mutex_destroy(PlatformMutex* mutex) {
+    pthread_mutex_destroy(&mutex->lock);
+    free(mutex);
+}
+
+void platform_mutex_lock(PlatformMutex* mutex) {
+    pthread_mutex_lock(&mutex->lock);
+}
+
+int platform_mutex_trylock(PlatformMutex* mutex) {
+    return pthread_mutex_trylock(&mutex->lock) == 0;
+}
+
+void platform_mutex_unlock(PlatformMutex* mutex) {
+    pthread_mutex_unlock(&mutex->lock);
+}
+
+PlatformCond* platform_cond_create(void) {
+    PlatformCond* cond = malloc(sizeof(PlatformCond));
+    if (cond && pthread_cond_init(&cond->cond, NULL) != 0) {
+        free(cond);
+        return NULL;
+    }
+    return cond;
+}
+
+void platform_cond_destroy(PlatformCond* cond) {
+    pthread_cond_destroy(&cond->cond);
+    free(cond);
+}
+
+void platform_cond_wait(PlatformCond* cond, PlatformMutex* mutex) {
+    pthread_cond_wait(&cond->cond, &mutex->lock);
+}
+
+void platform_cond_signal(PlatformCond* cond) {
+    pthread_cond_signal(&cond->cond);
+}
+
+void platform_cond_broadcast(PlatformCond* cond) {
+    pthread_cond_broadcast(&cond->cond);
+}
+
+int platform_atomic_add(volatile int* value, int amount) {
+    return __atomic_add_fetch(value, amount, __ATOMIC_SEQ_CST);
+}
+
+int platform_atomic_load(volatile int* value) {
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+void platform_atomic_store(volatile int* value, int new_value) {
+    __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST);
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+//-------------------------------------------------------------//
+//                    Memory mapped files                       //
+//-------------------------------------------------------------//
+typedef struct {
+    const char* data;   // read-only view of the whole file
+    size_t size;        // file size in bytes
+    void* file_handle;  // HANDLE on Windows, fd on POSIX
+    void* map_handle;   // mapping HANDLE on Windows, unused on POSIX
+} MappedFile;
+
+// Maps a whole file read-only. Returns 1 on success, 0 on failure.
+// An empty file maps successfully with data == NULL and size == 0.
+int platform_map_file(const char* path, MappedFile* file);
+void platform_unmap_file(MappedFile* file);
+
+//-------------------------------------------------------------//
+//                        File helpers                          //
+//-------------------------------------------------------------//
+
+// Size in bytes and last write time (nanoseconds, only compared for
+// equality). Returns 1 on success, 0 if the file does not exist.
+int platform_file_info(const char* path, unsigned long long* size, long long* mtime);
+
+// fopen that does not trip MSVC's deprecation checks. NULL on failure.
+FILE* platform_fopen(const char* path, const char* mode);
+
+// Renames `from` over `to`, replacing it if it exists. Returns 1 on success.
+int platform_replace_file(const char* from, const char* to);
+
+//-------------------------------------------------------------//
+//                           Timing                             //
+//-------------------------------------------------------------//
+
+// Monotonic time in seconds, only meaningful as a difference
+double platform_time_seconds(void);
+
+//-------------------------------------------------------------//
+//                          Threads                             //
+//-------------------------------------------------------------//
+typedef struct PlatformThread PlatformThread;
+typedef struct PlatformMutex PlatformMutex;
+typedef struct PlatformCond PlatformCond;
+
+typedef void (*PlatformThreadFunc)(void* user);
+
+// Number of logical processors, at least 1
+int platform_cpu_count(void);
+
+// Starts a thread running func(user). Returns NULL on failure.
+PlatformThread* platform_thread_create(PlatformThreadFunc func, void* user);
+// Waits for the thread to finish and frees it
+void platform_thread_join(PlatformThread* thread);
+
+PlatformMutex* platform_mutex_create(void);
+void platform_mutex_destroy(PlatformMutex* mutex);
+void platform_mutex_lock(PlatformMutex* mutex);
+// Returns 1 if the mutex was acquired, 0 if another thread holds it
+int platform_mutex_trylock(PlatformMutex* mutex);
+void platform_mutex_unlock(PlatformMutex* mutex);
+
+PlatformCond* platform_cond_create(void);
+void platform_cond_destroy(PlatformCond* cond);
+// Atomically releases the mutex and sleeps until woken, then re-locks it
+void platform_cond_wait(PlatformCond* cond, PlatformMutex* mutex);
+void platform_cond_signal(PlatformCond* cond);
+void platform_cond_broadcast(PlatformCond* cond);
+
+// Sequentially consistent atomics on a 32-bit int
+int platform_atomic_add(volatile int* value, int amount); // returns the new value
+int platform_atomic_load(volatile int* value);
+void platform_atomic_store(volatile int* value, int new_value);
+
+#endif
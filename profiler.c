@@ -0,0 +1,232 @@
+#include "profiler.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+
+//-------------------------------------------------------------//
+//                            Series                            //
+//-------------------------------------------------------------//
+static void series_push(ProfilerSeries* series, double ms) {
+    if (series->count == series->capacity) {
+        if (series->capacity >= PROFILER_MAX_SAMPLES) return; // keeps the first hours
+        unsigned int capacity = series->capacity ? series->capacity * 2 : 1024;
+        float* values = realloc(series->values, (size_t)capacity * sizeof(float));
+        if (!values) return;
+        series->values = values;
+        series->capacity = capacity;
+    }
+    series->values[series->count++] = (float)ms;
+}
+
+static int compare_float(const void* a, const void* b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentiles of p[count] into out[count], then the max.
+// Returns 0 for an empty series or out of memory.
+static int series_percentiles(const ProfilerSeries* series, const double* p, int count, double* out) {
+    if (series->count == 0) return 0;
+    float* sorted = malloc((size_t)series->count * sizeof(float));
+    if (!sorted) return 0;
+    memcpy(sorted, series->values, (size_t)series->count * sizeof(float));
+    qsort(sorted, series->count, sizeof(float), compare_float);
+    for (int i = 0; i < count; i++) {
+        double rank = ceil(p[i] * (double)series->count);
+        unsigned int index = rank < 1.0 ? 0 : (unsigned int)rank - 1;
+        out[i] = sorted[index];
+    }
+    out[count] = sorted[series->count - 1];
+    free(sorted);
+    return 1;
+}
+
+//-------------------------------------------------------------//
+//                          Lifetime                            //
+//-------------------------------------------------------------//
+int profiler_create(Profiler* profiler, const char* csv_path) {
+    memset(profiler, 0, sizeof(*profiler));
+    profiler->active_gpu = -1;
+    profiler->last_frame_end = platform_time_seconds();
+    if (csv_path) {
+        profiler->csv = platform_fopen(csv_path, "w");
+        if (!profiler->csv) {
+            printf("WARNING: Could not open %s, frame times are not written\n", csv_path);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void profiler_write_header(Profiler* profiler) {
+    fprintf(profiler->csv, "frame,frame_ms");
+    for (int i = 0; i < profiler->scope_count; i++) {
+        const ProfilerScope* scope = &profiler->scopes[i];
+        fprintf(profiler->csv, ",%s_cpu_ms", scope->name);
+        if (scope->gpu) fprintf(profiler->csv, ",%s_gpu_ms", scope->name);
+    }
+    fprintf(profiler->csv, "\n");
+}
+
+// Turns the frame recorded in `slot` into samples; its queries were
+// issued PROFILER_QUERY_FRAMES - 1 frames ago
+static void profiler_resolve(Profiler* profiler, int slot) {
+    if (profiler->csv) {
+        if (!profiler->csv_header) profiler_write_header(profiler);
+        profiler->csv_header = 1;
+        fprintf(profiler->csv, "%llu,%.4f", profiler->slot_frame[slot], profiler->frame_seconds[slot] * 1000.0);
+    }
+    series_push(&profiler->frame_ms, profiler->frame_seconds[slot] * 1000.0);
+
+    for (int i = 0; i < profiler->scope_count; i++) {
+        ProfilerScope* scope = &profiler->scopes[i];
+        double cpu = scope->cpu_seconds[slot];
+        if (cpu >= 0.0) series_push(&scope->cpu_ms, cpu * 1000.0);
+        if (profiler->csv) {
+            if (cpu >= 0.0) fprintf(profiler->csv, ",%.4f", cpu * 1000.0);
+            else fprintf(profiler->csv, ",");
+        }
+        scope->cpu_seconds[slot] = -1.0;
+
+        if (!scope->gpu) continue;
+        double gpu = -1.0;
+        if (scope->query_issued[slot]) {
+            // Waiting for a late result would stall the frame, so it is dropped
+            GLuint available = 0;
+            glGetQueryObjectuiv(scope->queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(scope->queries[slot], GL_QUERY_RESULT, &nanoseconds);
+                gpu = (double)nanoseconds * 1e-6;
+                series_push(&scope->gpu_ms, gpu);
+            }
+            else {
+                profiler->gpu_dropped++;
+            }
+            scope->query_issued[slot] = 0;
+        }
+        if (profiler->csv) {
+            if (gpu >= 0.0) fprintf(profiler->csv, ",%.4f", gpu);
+            else fprintf(profiler->csv, ",");
+        }
+    }
+    if (profiler->csv) fprintf(profiler->csv, "\n");
+    profiler->slot_frame[slot] = 0;
+}
+
+void profiler_destroy(Profiler* profiler) {
+    if (profiler->csv) fclose(profiler->csv);
+    for (int i = 0; i < profiler->scope_count; i++) {
+        ProfilerScope* scope = &profiler->scopes[i];
+        if (scope->gpu) glDeleteQueries(PROFILER_QUERY_FRAMES, scope->queries);
+        free(scope->cpu_ms.values);
+        free(scope->gpu_ms.values);
+    }
+    free(profiler->frame_ms.values);
+    memset(profiler, 0, sizeof(*profiler));
+}
+
+void profiler_finish(Profiler* profiler) {
+    if (profiler->active_gpu >= 0) {
+        glEndQuery(GL_TIME_ELAPSED);
+        profiler->active_gpu = -1;
+    }
+    // The last frames were queried only just now; once, at exit, waiting is fine
+    glFinish();
+    // Oldest first, so the CSV stays in frame order
+    for (int i = 0; i < PROFILER_QUERY_FRAMES; i++) {
+        int slot = (profiler->slot + i) % PROFILER_QUERY_FRAMES;
+        if (profiler->slot_frame[slot]) profiler_resolve(profiler, slot);
+    }
+    if (profiler->csv) fclose(profiler->csv);
+    profiler->csv = NULL;
+}
+
+int profiler_scope(Profiler* profiler, const char* name, int gpu) {
+    if (profiler->scope_count == PROFILER_MAX_SCOPES) return -1;
+    int id = profiler->scope_count++;
+    ProfilerScope* scope = &profiler->scopes[id];
+    scope->name = name;
+    scope->gpu = gpu;
+    for (int i = 0; i < PROFILER_QUERY_FRAMES; i++) scope->cpu_seconds[i] = -1.0;
+    if (gpu) glGenQueries(PROFILER_QUERY_FRAMES, scope->queries);
+    return id;
+}
+
+//-------------------------------------------------------------//
+//                           Timing                             //
+//-------------------------------------------------------------//
+void profiler_begin(Profiler* profiler, int scope_id) {
+    if (scope_id < 0) return;
+    ProfilerScope* scope = &profiler->scopes[scope_id];
+    // Runs of the same scope within a frame add up; the GPU side only
+    // times the first run, since queries cannot be restarted into one result
+    if (scope->gpu && profiler->active_gpu < 0 && !scope->query_issued[profiler->slot]) {
+        glBeginQuery(GL_TIME_ELAPSED, scope->queries[profiler->slot]);
+        scope->query_issued[profiler->slot] = 1;
+        profiler->active_gpu = scope_id;
+    }
+    scope->start = platform_time_seconds();
+}
+
+void profiler_end(Profiler* profiler, int scope_id) {
+    if (scope_id < 0) return;
+    ProfilerScope* scope = &profiler->scopes[scope_id];
+    double elapsed = platform_time_seconds() - scope->start;
+    double* cpu = &scope->cpu_seconds[profiler->slot];
+    *cpu = (*cpu < 0.0 ? 0.0 : *cpu) + elapsed;
+    if (profiler->active_gpu == scope_id) {
+        glEndQuery(GL_TIME_ELAPSED);
+        profiler->active_gpu = -1;
+    }
+}
+
+void profiler_event(Profiler* profiler, const char* name, double seconds) {
+    if (profiler->event_count == PROFILER_MAX_EVENTS) return;
+    profiler->event_names[profiler->event_count] = name;
+    profiler->event_seconds[profiler->event_count] = seconds;
+    profiler->event_count++;
+}
+
+void profiler_end_frame(Profiler* profiler) {
+    double now = platform_time_seconds();
+    int slot = profiler->slot;
+    profiler->frame_seconds[slot] = now - profiler->last_frame_end;
+    profiler->last_frame_end = now;
+    profiler->slot_frame[slot] = ++profiler->frame;
+
+    // The slot to record next was last used PROFILER_QUERY_FRAMES - 1 frames ago
+    profiler->slot = (slot + 1) % PROFILER_QUERY_FRAMES;
+    if (profiler->slot_frame[profiler->slot]) profiler_resolve(profiler, profiler->slot);
+}
+
+//-------------------------------------------------------------//
+//                            Report                            //
+//-------------------------------------------------------------//
+static void print_series(const char* name, const char* kind, const ProfilerSeries* series) {
+    static const double p[3] = { 0.50, 0.95, 0.99 };
+    double values[4];
+    if (!series_percentiles(series, p, 3, values)) return;
+    printf("  %-12s %-4s %9.3f %9.3f %9.3f %9.3f %9u\n", name, kind, values[0], values[1], values[2], values[3], series->count);
+}
+
+void profiler_print(const Profiler* profiler) {
+    if (profiler->frame_ms.count == 0) return;
+    printf("Frame profile (ms):         p50       p95       p99       max   samples\n");
+    print_series("frame", "", &profiler->frame_ms);
+    for (int i = 0; i < profiler->scope_count; i++) {
+        const ProfilerScope* scope = &profiler->scopes[i];
+        print_series(scope->name, "CPU", &scope->cpu_ms);
+        if (scope->gpu) print_series(scope->name, "GPU", &scope->gpu_ms);
+    }
+    if (profiler->gpu_dropped > 0) {
+        printf("  %llu GPU timer results were not ready %d frames later and were dropped\n", profiler->gpu_dropped,
+            PROFILER_QUERY_FRAMES - 1);
+    }
+    for (int i = 0; i < profiler->event_count; i++) {
+        printf("  %-12s %.3f ms\n", profiler->event_names[i], profiler->event_seconds[i] * 1000.0);
+    }
+}
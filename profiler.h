@@ -0,0 +1,92 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+
+#include <glad/glad.h>
+
+//-------------------------------------------------------------//
+//                           Profiler                           //
+//-------------------------------------------------------------//
+// Named scopes timed on the CPU every frame and, for GPU scopes, with
+// GL_TIME_ELAPSED queries. Query results are read PROFILER_QUERY_FRAMES - 1
+// frames later, when the GPU has normally finished them; a result that
+// is still not available is dropped and counted instead of waited for,
+// so reading never stalls. Every frame keeps one sample per scope that
+// ran, and the p50/p95/p99 are printed at exit. With a CSV path, each
+// frame is also written as a row once its GPU times are known.
+//
+// GL_TIME_ELAPSED queries cannot overlap, so GPU scopes must not nest.
+
+#define PROFILER_MAX_SCOPES 8
+#define PROFILER_MAX_EVENTS 8
+#define PROFILER_QUERY_FRAMES 4
+#define PROFILER_MAX_SAMPLES (1u << 20) // per series, about 4 hours at 60 Hz
+
+typedef struct {
+    float* values; // milliseconds
+    unsigned int count;
+    unsigned int capacity;
+} ProfilerSeries;
+
+typedef struct {
+    const char* name;
+    int gpu;
+    double start;
+    double cpu_seconds[PROFILER_QUERY_FRAMES]; // per frame in flight, < 0 if the scope did not run
+    GLuint queries[PROFILER_QUERY_FRAMES];
+    int query_issued[PROFILER_QUERY_FRAMES];
+    ProfilerSeries cpu_ms;
+    ProfilerSeries gpu_ms;
+} ProfilerScope;
+
+typedef struct {
+    ProfilerScope scopes[PROFILER_MAX_SCOPES];
+    int scope_count;
+    int active_gpu;                // scope with a running query, -1 if none
+
+    const char* event_names[PROFILER_MAX_EVENTS];
+    double event_seconds[PROFILER_MAX_EVENTS];
+    int event_count;
+
+    int slot;                      // frame in flight being recorded
+    unsigned long long frame;      // frames ended so far
+    unsigned long long slot_frame[PROFILER_QUERY_FRAMES]; // 0 when the slot holds nothing
+    double frame_seconds[PROFILER_QUERY_FRAMES];
+    double last_frame_end;
+    ProfilerSeries frame_ms;
+
+    FILE* csv;
+    int csv_header;                // written once the scopes are known
+    unsigned long long gpu_dropped; // results that were not ready in time
+} Profiler;
+
+// csv_path may be NULL. Returns 0 if the CSV file could not be
+// opened; the profiler still runs without it.
+int profiler_create(Profiler* profiler, const char* csv_path);
+// Frees the queries and samples. Safe on a zeroed profiler.
+void profiler_destroy(Profiler* profiler);
+
+// After the last frame: waits for the GPU, reads the frames still in
+// flight and closes the CSV
+void profiler_finish(Profiler* profiler);
+
+// Registers a scope before the first frame, with the GL context current
+// for GPU scopes. `name` must outlive the
+// profiler. Returns its id, or -1 when PROFILER_MAX_SCOPES are in use.
+int profiler_scope(Profiler* profiler, const char* name, int gpu);
+
+void profiler_begin(Profiler* profiler, int scope);
+void profiler_end(Profiler* profiler, int scope);
+
+// A one-off duration (load, upload...), listed at exit
+void profiler_event(Profiler* profiler, const char* name, double seconds);
+
+// Call once per frame after the swap: the frame time runs from one call
+// to the next
+void profiler_end_frame(Profiler* profiler);
+
+// Percentiles per scope and the events, after profiler_finish
+void profiler_print(const Profiler* profiler);
+
+#endif
@@ -0,0 +1,154 @@
+#include "ring_buffer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gl_extensions.h"
+#include "platform.h"
+
+int ring_buffer_create(RingBuffer* ring, GLenum target, GLsizeiptr region_size, int allow_persistent) {
+    memset(ring, 0, sizeof(*ring));
+    if (region_size < 1) region_size = 1;
+    region_size = (region_size + 255) & ~(GLsizeiptr)255; // every region starts suitably aligned
+    GLsizeiptr total = region_size * RING_BUFFER_FRAMES;
+
+    while (glGetError() != GL_NO_ERROR) {} // only report errors from the allocation
+    glGenBuffers(1, &ring->buffer);
+    glBindBuffer(target, ring->buffer);
+    if (allow_persistent && gl_extensions.buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl_extensions.BufferStorage(target, total, NULL, flags);
+        ring->mapped = glMapBufferRange(target, 0, total, flags);
+        ring->persistent = ring->mapped != NULL;
+        if (!ring->persistent) {
+            // Immutable storage cannot be respecified, so start over on a new buffer
+            printf("WARNING: Could not map a persistent ring buffer, using the orphaning path\n");
+            glBindBuffer(target, 0);
+            glDeleteBuffers(1, &ring->buffer);
+            while (glGetError() != GL_NO_ERROR) {}
+            glGenBuffers(1, &ring->buffer);
+            glBindBuffer(target, ring->buffer);
+        }
+    }
+    if (!ring->persistent) {
+        glBufferData(target, total, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(target, 0);
+    if (glGetError() != GL_NO_ERROR || !ring->buffer) {
+        printf("FATAL ERROR: Could not allocate a %lld byte ring buffer\n", (long long)total);
+        ring_buffer_destroy(ring);
+        return 0;
+    }
+
+    ring->target = target;
+    ring->region_size = region_size;
+    return 1;
+}
+
+void ring_buffer_destroy(RingBuffer* ring) {
+    for (int i = 0; i < RING_BUFFER_FRAMES; i++) {
+        if (ring->fences[i]) glDeleteSync(ring->fences[i]);
+    }
+    if (ring->buffer) {
+        if (ring->mapped) {
+            glBindBuffer(ring->target, ring->buffer);
+            glUnmapBuffer(ring->target);
+            glBindBuffer(ring->target, 0);
+        }
+        glDeleteBuffers(1, &ring->buffer);
+    }
+    memset(ring, 0, sizeof(*ring));
+}
+
+// Makes sure the GPU is done with this frame's region, once per frame
+static void ring_buffer_acquire(RingBuffer* ring) {
+    if (ring->waited) return;
+    ring->waited = 1;
+
+    GLsync fence = ring->fences[ring->region];
+    if (!fence) return;
+    ring->fences[ring->region] = NULL;
+
+    // Normally the GPU finished this region frames ago and the check is free
+    if (glClientWaitSync(fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+        glDeleteSync(fence);
+        return;
+    }
+
+    if (ring->persistent) {
+        double start = platform_time_seconds();
+        ring->fence_waits++;
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL);
+        ring->wait_seconds += platform_time_seconds() - start;
+        glDeleteSync(fence);
+        return;
+    }
+
+    // Fresh storage instead of a stall; the pending draws keep the old
+    // one alive, so the other fences guard nothing any more either
+    glDeleteSync(fence);
+    for (int i = 0; i < RING_BUFFER_FRAMES; i++) {
+        if (ring->fences[i]) glDeleteSync(ring->fences[i]);
+        ring->fences[i] = NULL;
+    }
+    glBindBuffer(ring->target, ring->buffer);
+    glBufferData(ring->target, ring->region_size * RING_BUFFER_FRAMES, NULL, GL_STREAM_DRAW);
+    glBindBuffer(ring->target, 0);
+    ring->orphans++;
+}
+
+void* ring_buffer_map(RingBuffer* ring, GLsizeiptr size, GLsizeiptr alignment, GLintptr* offset) {
+    if (alignment < 1) alignment = 1;
+    GLsizeiptr start = (ring->head + alignment - 1) & ~(alignment - 1);
+    if (size <= 0 || start + size > ring->region_size) {
+        ring->overflows++;
+        return NULL;
+    }
+
+    ring_buffer_acquire(ring);
+    GLintptr position = ring->region_size * ring->region + start;
+    void* dst;
+    if (ring->persistent) {
+        dst = ring->mapped + position;
+    }
+    else {
+        glBindBuffer(ring->target, ring->buffer);
+        dst = glMapBufferRange(ring->target, position, size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(ring->target, 0);
+        if (!dst) return NULL;
+    }
+
+    ring->head = start + size;
+    *offset = position;
+    return dst;
+}
+
+void ring_buffer_unmap(RingBuffer* ring) {
+    // Coherent persistent writes are visible to commands issued after them
+    if (ring->persistent) return;
+    glBindBuffer(ring->target, ring->buffer);
+    glUnmapBuffer(ring->target);
+    glBindBuffer(ring->target, 0);
+}
+
+void ring_buffer_end_frame(RingBuffer* ring) {
+    if (ring->head == 0) return;
+
+    ring->frames++;
+    ring->bytes_total += (unsigned long long)ring->head;
+    if ((unsigned long long)ring->head > ring->bytes_frame_max) ring->bytes_frame_max = (unsigned long long)ring->head;
+
+    ring->fences[ring->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ring->region = (ring->region + 1) % RING_BUFFER_FRAMES;
+    ring->head = 0;
+    ring->waited = 0;
+}
+
+void ring_buffer_print_stats(const RingBuffer* ring, const char* name) {
+    if (ring->frames == 0) return;
+    printf("%s ring (%s, %d x %.1f KB): %.1f KB per frame avg, %.1f KB max, %llu fence stalls (%.3f ms), %llu orphans, %llu overflows\n",
+        name, ring->persistent ? "persistent" : "orphaning", RING_BUFFER_FRAMES, (double)ring->region_size / 1024.0,
+        (double)ring->bytes_total / 1024.0 / (double)ring->frames, (double)ring->bytes_frame_max / 1024.0,
+        ring->fence_waits, ring->wait_seconds * 1000.0, ring->orphans, ring->overflows);
+}
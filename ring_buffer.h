@@ -0,0 +1,62 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <glad/glad.h>
+
+//-------------------------------------------------------------//
+//                     Streaming ring buffer                    //
+//-------------------------------------------------------------//
+// One GL buffer cut into RING_BUFFER_FRAMES regions, one per frame in
+// flight. Each frame writes only its own region, which is fenced once
+// the frame's draws are submitted and reused RING_BUFFER_FRAMES frames
+// later, so the CPU writes while the GPU still reads the older regions.
+//
+// With GL_ARB_buffer_storage the buffer is mapped once, persistent and
+// coherent, and a write only waits when the GPU is a whole ring behind.
+// On plain GL 3.3 each write maps its range unsynchronized; if the
+// region's fence has not passed yet the buffer is orphaned instead of
+// waiting, so the driver hands out fresh storage.
+
+#define RING_BUFFER_FRAMES 3
+
+typedef struct {
+    GLuint buffer;
+    GLenum target;
+    GLsizeiptr region_size;
+    int region;                // region written this frame
+    GLsizeiptr head;           // bytes used in it
+    int persistent;            // mapped once with GL_MAP_PERSISTENT_BIT
+    unsigned char* mapped;     // the whole buffer, persistent mode only
+    GLsync fences[RING_BUFFER_FRAMES];
+    int waited;                // this frame's region is known to be free
+
+    // Totals
+    unsigned long long frames;       // frames that wrote anything
+    unsigned long long fence_waits;  // writes that stalled on the GPU
+    double wait_seconds;
+    unsigned long long orphans;      // fallback only: reallocations instead of stalls
+    unsigned long long overflows;    // writes that did not fit the region
+    unsigned long long bytes_total;
+    unsigned long long bytes_frame_max;
+} RingBuffer;
+
+// Allocates the ring for `target`, persistent when the extension is
+// loaded and allow_persistent is set. Returns 1 on success.
+int ring_buffer_create(RingBuffer* ring, GLenum target, GLsizeiptr region_size, int allow_persistent);
+void ring_buffer_destroy(RingBuffer* ring);
+
+// Reserves `size` bytes of this frame's region, `alignment` a power of
+// two. Returns a write pointer and the buffer offset to bind, or NULL if
+// the region is full or mapping failed. Every successful map must be
+// followed by ring_buffer_unmap before drawing from it.
+void* ring_buffer_map(RingBuffer* ring, GLsizeiptr size, GLsizeiptr alignment, GLintptr* offset);
+void ring_buffer_unmap(RingBuffer* ring);
+
+// Call after the frame's draws: fences the region they read and moves
+// to the next one. Frames that wrote nothing keep their region.
+void ring_buffer_end_frame(RingBuffer* ring);
+
+// Mode, bytes per frame, stalls and orphans
+void ring_buffer_print_stats(const RingBuffer* ring, const char* name);
+
+#endif
@@ -0,0 +1,371 @@
+#include "shader.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gl_extensions.h"
+#include "platform.h"
+
+static GLuint bound_program = 0;
+static ShaderStats frame_stats;
+static ShaderStats total_stats;
+
+//-------------------------------------------------------------//
+//                      Shader check helper                     //
+//-------------------------------------------------------------//
+static int check_compile_errors(unsigned int shader, const char* type) {
+    int success;
+    char infoLog[1024];
+    if (strcmp(type, "PROGRAM") != 0) {
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+            printf("ERROR::SHADER_COMPILATION_ERROR of type: %s\n%s\n", type, infoLog);
+        }
+    }
+    else {
+        glGetProgramiv(shader, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+            printf("ERROR::PROGRAM_LINKING_ERROR of type: %s\n%s\n", type, infoLog);
+        }
+    }
+    return success;
+}
+
+// The defines go right after the #version line, which has to come first
+static GLuint compile_shader(GLenum type, const char* source, const char* defines, const char* label) {
+    GLuint shader = glCreateShader(type);
+    const char* newline = strchr(source, '\n');
+    if (defines && defines[0] && newline) {
+        const char* parts[3] = { source, defines, newline + 1 };
+        GLint lengths[3] = { (GLint)(newline + 1 - source), -1, -1 };
+        glShaderSource(shader, 3, parts, lengths);
+    }
+    else {
+        glShaderSource(shader, 1, &source, NULL);
+    }
+    glCompileShader(shader);
+    if (!check_compile_errors(shader, label)) {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+//-------------------------------------------------------------//
+//                     Program binary cache                     //
+//-------------------------------------------------------------//
+// "shader-<key>.glbin" in the working directory holds the driver's
+// binary of a linked program. The key hashes both sources, the defines
+// and the GL vendor, renderer and version strings, so another variant,
+// an edited shader or a driver update simply misses. A binary the
+// driver still rejects is recompiled and replaced.
+
+#define PROGRAM_CACHE_MAGIC 0x42505347u // "GSPB"
+#define PROGRAM_CACHE_VERSION 1u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;   // GLenum from glGetProgramBinary
+    uint32_t length;   // bytes of binary that follow
+} ProgramCacheHeader;
+
+// FNV-1a, with each part's length folded in so "ab" + "c" != "a" + "bc"
+static uint64_t hash_string(uint64_t hash, const char* text) {
+    size_t length = text ? strlen(text) : 0;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= (uint64_t)length;
+    hash *= 0x100000001b3ULL;
+    return hash;
+}
+
+static uint64_t program_key(const char* vertex_source, const char* fragment_source, const char* defines) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hash_string(hash, vertex_source);
+    hash = hash_string(hash, fragment_source);
+    hash = hash_string(hash, defines);
+    hash = hash_string(hash, (const char*)glGetString(GL_VENDOR));
+    hash = hash_string(hash, (const char*)glGetString(GL_RENDERER));
+    hash = hash_string(hash, (const char*)glGetString(GL_VERSION));
+    return hash;
+}
+
+// Returns a linked program from the cache file, or 0 on a miss or rejection
+static GLuint program_cache_load(const char* path, uint64_t key) {
+    FILE* file = platform_fopen(path, "rb");
+    if (!file) return 0;
+
+    ProgramCacheHeader header;
+    void* binary = NULL;
+    int ok = fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == PROGRAM_CACHE_MAGIC && header.version == PROGRAM_CACHE_VERSION &&
+        header.key == key && header.length > 0;
+    if (ok) {
+        binary = malloc(header.length);
+        ok = binary && fread(binary, 1, header.length, file) == header.length;
+    }
+    fclose(file);
+    if (!ok) {
+        free(binary);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    gl_extensions.ProgramBinary(program, (GLenum)header.format, binary, (GLsizei)header.length);
+    free(binary);
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        printf("WARNING: The driver rejected the program binary in %s, recompiling\n", path);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+static void program_cache_store(const char* path, uint64_t key, GLuint program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    void* binary = malloc((size_t)length);
+    if (!binary) return;
+
+    ProgramCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    GLenum format = 0;
+    GLsizei written = 0;
+    gl_extensions.GetProgramBinary(program, length, &written, &format, binary);
+    header.magic = PROGRAM_CACHE_MAGIC;
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+    header.format = format;
+    header.length = (uint32_t)written;
+
+    // Written to a temporary file first so a crash never leaves a torn binary behind
+    char temp_path[1040];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE* file = written > 0 ? platform_fopen(temp_path, "wb") : NULL;
+    int ok = file != NULL;
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(binary, 1, (size_t)written, file) == (size_t)written;
+    if (file && fclose(file) != 0) ok = 0;
+    free(binary);
+
+    if (ok) ok = platform_replace_file(temp_path, path);
+    if (!ok) {
+        if (file) remove(temp_path);
+        printf("WARNING: Could not write program binary %s\n", path);
+    }
+}
+
+//-------------------------------------------------------------//
+//                     Reflection at link time                  //
+//-------------------------------------------------------------//
+static void copy_name(char* dst, const char* src) {
+    size_t length = strlen(src);
+    if (length >= 3 && strcmp(src + length - 3, "[0]") == 0) length -= 3;
+    if (length >= SHADER_NAME_LENGTH) length = SHADER_NAME_LENGTH - 1;
+    memcpy(dst, src, length);
+    dst[length] = '\0';
+}
+
+static int reflect_program(ShaderProgram* shader) {
+    GLint count = 0;
+    char name[256];
+
+    glGetProgramiv(shader->program, GL_ACTIVE_UNIFORMS, &count);
+    shader->uniforms = calloc(count > 0 ? (size_t)count : 1, sizeof(ShaderUniform));
+    if (!shader->uniforms) return 0;
+    for (GLint i = 0; i < count; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(shader->program, (GLuint)i, sizeof(name), NULL, &size, &type, name);
+        GLint location = glGetUniformLocation(shader->program, name);
+        if (location < 0) continue; // uniform block members have no location
+
+        ShaderUniform* uniform = &shader->uniforms[shader->uniform_count++];
+        copy_name(uniform->name, name);
+        uniform->location = location;
+        uniform->type = type;
+        uniform->size = size;
+    }
+
+    glGetProgramiv(shader->program, GL_ACTIVE_ATTRIBUTES, &count);
+    shader->attributes = calloc(count > 0 ? (size_t)count : 1, sizeof(ShaderAttribute));
+    if (!shader->attributes) return 0;
+    for (GLint i = 0; i < count; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(shader->program, (GLuint)i, sizeof(name), NULL, &size, &type, name);
+        ShaderAttribute* attribute = &shader->attributes[shader->attribute_count++];
+        copy_name(attribute->name, name);
+        attribute->location = glGetAttribLocation(shader->program, name);
+        attribute->type = type;
+    }
+    return 1;
+}
+
+//-------------------------------------------------------------//
+//                          Lifetime                            //
+//-------------------------------------------------------------//
+int shader_program_create(ShaderProgram* shader, const char* vertex_source, const char* fragment_source, const char* defines) {
+    memset(shader, 0, sizeof(*shader));
+    double start = platform_time_seconds();
+
+    char cache_path[64] = "";
+    uint64_t key = 0;
+    if (gl_extensions.program_binary) {
+        key = program_key(vertex_source, fragment_source, defines);
+        snprintf(cache_path, sizeof(cache_path), "shader-%016llx.glbin", (unsigned long long)key);
+        shader->program = program_cache_load(cache_path, key);
+        if (shader->program) {
+            if (!reflect_program(shader)) {
+                shader_program_destroy(shader);
+                return 0;
+            }
+            printf("Shader program: loaded %s in %.3f ms\n", cache_path, (platform_time_seconds() - start) * 1000.0);
+            return 1;
+        }
+    }
+
+    GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source, defines, "VERTEX");
+    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source, defines, "FRAGMENT");
+    if (!vertex_shader || !fragment_shader) {
+        if (vertex_shader) glDeleteShader(vertex_shader);
+        if (fragment_shader) glDeleteShader(fragment_shader);
+        return 0;
+    }
+
+    shader->program = glCreateProgram();
+    glAttachShader(shader->program, vertex_shader);
+    glAttachShader(shader->program, fragment_shader);
+    if (cache_path[0]) gl_extensions.ProgramParameteri(shader->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(shader->program);
+    int linked = check_compile_errors(shader->program, "PROGRAM");
+
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    if (!linked || !reflect_program(shader)) {
+        shader_program_destroy(shader);
+        return 0;
+    }
+    printf("Shader program: compiled and linked in %.3f ms\n", (platform_time_seconds() - start) * 1000.0);
+
+    // Stored after the timing, which is what the next start saves
+    if (cache_path[0]) program_cache_store(cache_path, key, shader->program);
+    return 1;
+}
+
+void shader_program_destroy(ShaderProgram* shader) {
+    if (shader->program) {
+        if (bound_program == shader->program) bound_program = 0;
+        glDeleteProgram(shader->program);
+    }
+    free(shader->uniforms);
+    free(shader->attributes);
+    memset(shader, 0, sizeof(*shader));
+}
+
+void shader_program_use(const ShaderProgram* shader) {
+    if (bound_program == shader->program) {
+        frame_stats.calls_avoided++;
+        return;
+    }
+    glUseProgram(shader->program);
+    bound_program = shader->program;
+    frame_stats.calls_issued++;
+}
+
+int shader_uniform_index(const ShaderProgram* shader, const char* name) {
+    for (int i = 0; i < shader->uniform_count; i++) {
+        if (strcmp(shader->uniforms[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+int shader_attribute_location(const ShaderProgram* shader, const char* name) {
+    for (int i = 0; i < shader->attribute_count; i++) {
+        if (strcmp(shader->attributes[i].name, name) == 0) return shader->attributes[i].location;
+    }
+    return -1;
+}
+
+int shader_bind_uniform_block(const ShaderProgram* shader, const char* block, GLuint binding) {
+    GLuint index = glGetUniformBlockIndex(shader->program, block);
+    if (index == GL_INVALID_INDEX) return 0;
+    glUniformBlockBinding(shader->program, index, binding);
+    return 1;
+}
+
+//-------------------------------------------------------------//
+//                        Typed setters                         //
+//-------------------------------------------------------------//
+
+// Returns the uniform if `count` floats differ from its last upload
+// and records them, NULL when the upload can be skipped
+static ShaderUniform* changed_uniform(ShaderProgram* shader, int uniform, const float* value, int count) {
+    if (uniform < 0 || uniform >= shader->uniform_count) return NULL;
+    ShaderUniform* target = &shader->uniforms[uniform];
+    if (target->has_value && memcmp(target->value, value, sizeof(float) * (size_t)count) == 0) {
+        frame_stats.calls_avoided++;
+        return NULL;
+    }
+    memcpy(target->value, value, sizeof(float) * (size_t)count);
+    target->has_value = 1;
+    frame_stats.calls_issued++;
+    return target;
+}
+
+void shader_set_int(ShaderProgram* shader, int uniform, int value) {
+    float stored;
+    memcpy(&stored, &value, sizeof(stored)); // compared bitwise only
+    ShaderUniform* target = changed_uniform(shader, uniform, &stored, 1);
+    if (target) glUniform1i(target->location, value);
+}
+
+void shader_set_float(ShaderProgram* shader, int uniform, float value) {
+    ShaderUniform* target = changed_uniform(shader, uniform, &value, 1);
+    if (target) glUniform1f(target->location, value);
+}
+
+void shader_set_vec3(ShaderProgram* shader, int uniform, const float* value) {
+    ShaderUniform* target = changed_uniform(shader, uniform, value, 3);
+    if (target) glUniform3fv(target->location, 1, value);
+}
+
+void shader_set_mat3(ShaderProgram* shader, int uniform, const float* value) {
+    ShaderUniform* target = changed_uniform(shader, uniform, value, 9);
+    if (target) glUniformMatrix3fv(target->location, 1, GL_FALSE, value);
+}
+
+void shader_set_mat4(ShaderProgram* shader, int uniform, const float* value) {
+    ShaderUniform* target = changed_uniform(shader, uniform, value, 16);
+    if (target) glUniformMatrix4fv(target->location, 1, GL_FALSE, value);
+}
+
+//-------------------------------------------------------------//
+//                          Statistics                          //
+//-------------------------------------------------------------//
+ShaderStats shader_stats_frame(void) {
+    return frame_stats;
+}
+
+void shader_stats_end_frame(void) {
+    total_stats.calls_issued += frame_stats.calls_issued;
+    total_stats.calls_avoided += frame_stats.calls_avoided;
+    frame_stats.calls_issued = 0;
+    frame_stats.calls_avoided = 0;
+}
+
+ShaderStats shader_stats_total(void) {
+    return total_stats;
+}
@@ -0,0 +1,78 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/glad.h>
+
+//-------------------------------------------------------------//
+//                    Shader program wrapper                    //
+//-------------------------------------------------------------//
+// Compiles and links a program, then resolves every active uniform
+// and attribute once with glGetActiveUniform/glGetActiveAttrib. The
+// typed setters keep a CPU copy of each value and skip the GL call
+// when it has not changed.
+
+#define SHADER_NAME_LENGTH 64
+
+typedef struct {
+    char name[SHADER_NAME_LENGTH]; // array uniforms without the "[0]"
+    GLint location;
+    GLenum type;
+    GLint size;
+    int has_value;
+    float value[16];               // last uploaded value
+} ShaderUniform;
+
+typedef struct {
+    char name[SHADER_NAME_LENGTH];
+    GLint location;
+    GLenum type;
+} ShaderAttribute;
+
+typedef struct {
+    GLuint program;
+    ShaderUniform* uniforms;
+    int uniform_count;
+    ShaderAttribute* attributes;
+    int attribute_count;
+} ShaderProgram;
+
+// Returns 1 on success. Compile and link errors are printed.
+// defines (may be NULL) is inserted after the #version line of both
+// stages, e.g. "#define FOO\n", to select shader variants.
+int shader_program_create(ShaderProgram* shader, const char* vertex_source, const char* fragment_source, const char* defines);
+void shader_program_destroy(ShaderProgram* shader);
+
+// glUseProgram, skipped when the program is already bound
+void shader_program_use(const ShaderProgram* shader);
+
+// Index into shader->uniforms, or -1 when the uniform is not active.
+// Resolve once after creation, not per frame. Setters ignore -1.
+int shader_uniform_index(const ShaderProgram* shader, const char* name);
+int shader_attribute_location(const ShaderProgram* shader, const char* name);
+
+// Points the named uniform block at a binding index. Returns 0 when
+// the program has no such block.
+int shader_bind_uniform_block(const ShaderProgram* shader, const char* block, GLuint binding);
+
+// The program must be bound with shader_program_use
+void shader_set_int(ShaderProgram* shader, int uniform, int value);
+void shader_set_float(ShaderProgram* shader, int uniform, float value);
+void shader_set_vec3(ShaderProgram* shader, int uniform, const float* value);
+void shader_set_mat3(ShaderProgram* shader, int uniform, const float* value);
+void shader_set_mat4(ShaderProgram* shader, int uniform, const float* value);
+
+//-------------------------------------------------------------//
+//                          Statistics                          //
+//-------------------------------------------------------------//
+typedef struct {
+    unsigned long long calls_issued;  // uniform uploads and program binds
+    unsigned long long calls_avoided; // the same, skipped as redundant
+} ShaderStats;
+
+// Counters since the last shader_stats_end_frame
+ShaderStats shader_stats_frame(void);
+// Folds the frame counters into the totals and resets them
+void shader_stats_end_frame(void);
+ShaderStats shader_stats_total(void);
+
+#endif
@@ -0,0 +1,49 @@
+#include "timestep.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void timestep_init(Timestep* timestep, double step, int frame_locked, double now) {
+    memset(timestep, 0, sizeof(*timestep));
+    timestep->step = step;
+    timestep->frame_locked = frame_locked;
+    timestep->last_time = now;
+}
+
+int timestep_advance(Timestep* timestep, double now) {
+    timestep->frames++;
+    if (timestep->frame_locked) {
+        timestep->steps++;
+        return 1;
+    }
+
+    double elapsed = now - timestep->last_time;
+    timestep->last_time = now;
+    if (elapsed < 0.0) elapsed = 0.0;
+    timestep->accumulator += elapsed;
+
+    int steps = (int)(timestep->accumulator / timestep->step);
+    if (steps > TIMESTEP_MAX_STEPS) {
+        timestep->dropped_seconds += (steps - TIMESTEP_MAX_STEPS) * timestep->step;
+        timestep->accumulator -= (steps - TIMESTEP_MAX_STEPS) * timestep->step;
+        steps = TIMESTEP_MAX_STEPS;
+    }
+    timestep->accumulator -= steps * timestep->step;
+    if (timestep->accumulator < 0.0) timestep->accumulator = 0.0; // rounding
+
+    timestep->steps += (unsigned long long)steps;
+    if (steps == 0) timestep->idle_frames++;
+    return steps;
+}
+
+float timestep_alpha(const Timestep* timestep) {
+    float alpha = (float)(timestep->accumulator / timestep->step);
+    return alpha < 1.0f ? alpha : 0.999999f;
+}
+
+void timestep_print_stats(const Timestep* timestep) {
+    if (timestep->frames == 0) return;
+    printf("Simulation (%s): %llu steps of %.3f ms over %llu frames, %.2f steps per frame, %llu frames without a step, %.3f s dropped\n",
+        timestep->frame_locked ? "one step per frame" : "fixed timestep", timestep->steps, timestep->step * 1000.0,
+        timestep->frames, (double)timestep->steps / (double)timestep->frames, timestep->idle_frames, timestep->dropped_seconds);
+}
@@ -0,0 +1,43 @@
+#ifndef TIMESTEP_H
+#define TIMESTEP_H
+
+//-------------------------------------------------------------//
+//                        Fixed timestep                        //
+//-------------------------------------------------------------//
+// The simulation advances in steps of exactly `step` seconds however
+// fast frames come. Each frame adds its elapsed time to an accumulator
+// and runs as many whole steps as fit; the leftover fraction of a step
+// is returned as the blend factor between the last two simulated states,
+// so motion stays smooth at any render rate.
+//
+// Frame-locked timesteps ignore the clock and run exactly one step per
+// frame, so frame N always shows the same state (headless and capture runs).
+
+#define TIMESTEP_MAX_STEPS 8 // after a hitch the simulation drops time instead of spiralling
+
+typedef struct {
+    double step;
+    double accumulator;
+    double last_time;
+    int frame_locked;
+
+    // Totals
+    unsigned long long frames;
+    unsigned long long steps;
+    unsigned long long idle_frames;   // frames that ran no step
+    double dropped_seconds;           // time skipped after hitches
+} Timestep;
+
+// `now` is the clock reading the first frame measures from
+void timestep_init(Timestep* timestep, double step, int frame_locked, double now);
+
+// Adds the time since the last call and returns the number of steps to
+// run this frame
+int timestep_advance(Timestep* timestep, double now);
+
+// Blend factor in [0, 1) from the previous step's state to the current one
+float timestep_alpha(const Timestep* timestep);
+
+void timestep_print_stats(const Timestep* timestep);
+
+#endif
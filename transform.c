@@ -0,0 +1,162 @@
+#include "transform.h"
+#include "parallel.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define TRANSFORMS_MIN_CAPACITY 256
+#define TRANSFORM_COMPONENTS 10
+#define TRANSFORM_TASK_OBJECTS 8192 // objects per parallel task, a multiple of 4
+
+// The ten component arrays in a fixed order, for the loops below
+static void component_arrays(Transforms* transforms, float** arrays[TRANSFORM_COMPONENTS]) {
+    for (int i = 0; i < 3; i++) arrays[i] = &transforms->position[i];
+    for (int i = 0; i < 4; i++) arrays[3 + i] = &transforms->rotation[i];
+    for (int i = 0; i < 3; i++) arrays[7 + i] = &transforms->scale[i];
+}
+
+static void source_arrays(const Transforms* transforms, const float* arrays[TRANSFORM_COMPONENTS]) {
+    for (int i = 0; i < 3; i++) arrays[i] = transforms->position[i];
+    for (int i = 0; i < 4; i++) arrays[3 + i] = transforms->rotation[i];
+    for (int i = 0; i < 3; i++) arrays[7 + i] = transforms->scale[i];
+}
+
+static void trs_arrays(const Transforms* transforms, TrsArrays* trs) {
+    for (int i = 0; i < 3; i++) trs->position[i] = transforms->position[i];
+    for (int i = 0; i < 4; i++) trs->rotation[i] = transforms->rotation[i];
+    for (int i = 0; i < 3; i++) trs->scale[i] = transforms->scale[i];
+}
+
+void transforms_init(Transforms* transforms) {
+    float** arrays[TRANSFORM_COMPONENTS];
+    component_arrays(transforms, arrays);
+    for (int i = 0; i < TRANSFORM_COMPONENTS; i++) *arrays[i] = NULL;
+    transforms->count = 0;
+    transforms->capacity = 0;
+}
+
+void transforms_free(Transforms* transforms) {
+    float** arrays[TRANSFORM_COMPONENTS];
+    component_arrays(transforms, arrays);
+    for (int i = 0; i < TRANSFORM_COMPONENTS; i++) free(*arrays[i]);
+    transforms_init(transforms);
+}
+
+int transforms_reserve(Transforms* transforms, int capacity) {
+    if (capacity <= transforms->capacity) return 1;
+
+    // Arrays that already grew keep their new size if a later one fails,
+    // so the capacity only moves once all of them succeeded
+    float** arrays[TRANSFORM_COMPONENTS];
+    component_arrays(transforms, arrays);
+    for (int i = 0; i < TRANSFORM_COMPONENTS; i++) {
+        float* resized = realloc(*arrays[i], (size_t)capacity * sizeof(float));
+        if (!resized) return 0;
+        *arrays[i] = resized;
+    }
+    transforms->capacity = capacity;
+    return 1;
+}
+
+int transforms_push(Transforms* transforms, Vec3 position, Quat rotation, Vec3 scale) {
+    if (transforms->count >= transforms->capacity) {
+        if (transforms->count == INT_MAX) return -1;
+        long long capacity = transforms->capacity > TRANSFORMS_MIN_CAPACITY ? transforms->capacity : TRANSFORMS_MIN_CAPACITY;
+        while (capacity <= transforms->count) capacity *= 2;
+        if (capacity > INT_MAX) capacity = INT_MAX;
+        if (!transforms_reserve(transforms, (int)capacity)) return -1;
+    }
+    int index = transforms->count++;
+    transforms_set(transforms, index, position, rotation, scale);
+    return index;
+}
+
+void transforms_set(Transforms* transforms, int index, Vec3 position, Quat rotation, Vec3 scale) {
+    transforms->position[0][index] = position.x;
+    transforms->position[1][index] = position.y;
+    transforms->position[2][index] = position.z;
+    transforms->rotation[0][index] = rotation.x;
+    transforms->rotation[1][index] = rotation.y;
+    transforms->rotation[2][index] = rotation.z;
+    transforms->rotation[3][index] = rotation.w;
+    transforms->scale[0][index] = scale.x;
+    transforms->scale[1][index] = scale.y;
+    transforms->scale[2][index] = scale.z;
+}
+
+int transforms_gather(Transforms* dst, const Transforms* src, const int* indices, int count) {
+    if (!transforms_reserve(dst, count)) return 0;
+
+    float** dst_arrays[TRANSFORM_COMPONENTS];
+    const float* src_arrays[TRANSFORM_COMPONENTS];
+    component_arrays(dst, dst_arrays);
+    source_arrays(src, src_arrays);
+    for (int c = 0; c < TRANSFORM_COMPONENTS; c++) {
+        float* to = *dst_arrays[c];
+        const float* from = src_arrays[c];
+        for (int i = 0; i < count; i++) to[i] = from[indices[i]];
+    }
+    dst->count = count;
+    return 1;
+}
+
+void transforms_bounding_spheres(const Transforms* transforms, const Bounds* local, float* const center[3], float* radius) {
+    int centered = local->center.x == 0.0f && local->center.y == 0.0f && local->center.z == 0.0f;
+    for (int i = 0; i < transforms->count; i++) {
+        float sx = transforms->scale[0][i], sy = transforms->scale[1][i], sz = transforms->scale[2][i];
+        Vec3 offset = { 0.0f, 0.0f, 0.0f };
+        if (!centered) {
+            // The model's sphere center moves with the object's rotation
+            Vec3 scaled = { local->center.x * sx, local->center.y * sy, local->center.z * sz };
+            Quat rotation = { transforms->rotation[0][i], transforms->rotation[1][i], transforms->rotation[2][i], transforms->rotation[3][i] };
+            offset = quat_rotate(rotation, scaled);
+        }
+        center[0][i] = transforms->position[0][i] + offset.x;
+        center[1][i] = transforms->position[1][i] + offset.y;
+        center[2][i] = transforms->position[2][i] + offset.z;
+
+        float max_scale = fabsf(sx);
+        if (fabsf(sy) > max_scale) max_scale = fabsf(sy);
+        if (fabsf(sz) > max_scale) max_scale = fabsf(sz);
+        radius[i] = local->radius * max_scale;
+    }
+}
+
+//-------------------------------------------------------------//
+//                         Batch compute                        //
+//-------------------------------------------------------------//
+typedef struct {
+    TrsArrays trs;
+    float* models;
+    float* normals;
+    int count;
+} ComputeJob;
+
+static void compute_task(void* user, int index) {
+    ComputeJob* job = user;
+    int first = index * TRANSFORM_TASK_OBJECTS;
+    int count = job->count - first < TRANSFORM_TASK_OBJECTS ? job->count - first : TRANSFORM_TASK_OBJECTS;
+    mat4_from_trs_batch(job->models, job->normals, &job->trs, first, count);
+}
+
+void transforms_compute_range(const Transforms* transforms, float* models, float* normals, int first, int count) {
+    TrsArrays trs;
+    trs_arrays(transforms, &trs);
+    mat4_from_trs_batch(models, normals, &trs, first, count);
+}
+
+void transforms_compute(const Transforms* transforms, float* models, float* normals) {
+    int tasks = (int)(((long long)transforms->count + TRANSFORM_TASK_OBJECTS - 1) / TRANSFORM_TASK_OBJECTS);
+    if (tasks <= 1 || parallel_thread_count() <= 1) {
+        transforms_compute_range(transforms, models, normals, 0, transforms->count);
+        return;
+    }
+
+    ComputeJob job;
+    trs_arrays(transforms, &job.trs);
+    job.models = models;
+    job.normals = normals;
+    job.count = transforms->count;
+    parallel_for(tasks, compute_task, &job);
+}
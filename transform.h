@@ -0,0 +1,46 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "math3d.h"
+
+//-------------------------------------------------------------//
+//                    Object transforms (SoA)                   //
+//-------------------------------------------------------------//
+// Position, rotation and scale of many objects, one float array per
+// component so the batch kernel loads four objects per instruction.
+// transforms_compute turns all of them into model and normal matrices
+// in one pass, split across the thread pool when there are enough.
+
+typedef struct {
+    float* position[3]; // x, y, z
+    float* rotation[4]; // unit quaternion x, y, z, w
+    float* scale[3];
+    int count;
+    int capacity;
+} Transforms;
+
+void transforms_init(Transforms* transforms);
+void transforms_free(Transforms* transforms);
+
+// Makes room for at least `capacity` objects. Returns 0 when out of memory.
+int transforms_reserve(Transforms* transforms, int capacity);
+
+// Appends one object and returns its index, or -1 when out of memory
+int transforms_push(Transforms* transforms, Vec3 position, Quat rotation, Vec3 scale);
+void transforms_set(Transforms* transforms, int index, Vec3 position, Quat rotation, Vec3 scale);
+
+// Replaces the contents of dst with the objects of src listed in
+// `indices`, in that order. Returns 0 when out of memory.
+int transforms_gather(Transforms* dst, const Transforms* src, const int* indices, int count);
+
+// World-space bounding sphere of every object, given the object-space
+// bounds they all share. Non-uniform scale uses the largest axis.
+void transforms_bounding_spheres(const Transforms* transforms, const Bounds* local, float* const center[3], float* radius);
+
+// Writes 16 floats per object to models and 9 to normals (may be NULL),
+// using the thread pool for large counts
+void transforms_compute(const Transforms* transforms, float* models, float* normals);
+// The same for objects [first, first + count), on the calling thread
+void transforms_compute_range(const Transforms* transforms, float* models, float* normals, int first, int count);
+
+#endif